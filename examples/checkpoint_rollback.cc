@@ -0,0 +1,413 @@
+/* checkpoint_rollback.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks the checkpoints. A network learning as it runs is checkpointed in full, then twice
+ * more with deltas, and run on. A delta taken right after another has to be empty. The
+ * checkpoints are loaded one after another into a network of the same topology but other
+ * initial weights, compacted into a single file loaded into another such network, and that
+ * file is loaded back into the original network too. All three have to end up in the same
+ * neuron and dendrite states and at the same iteration as the original had when the last
+ * delta was taken. Then a network of IncrementalNeuron and one of Neuron computing the same
+ * sums are checkpointed likewise, run on, and rolled back, while another such pair has only
+ * the delta loaded. Run on with all the neurons fired, each incremental network has to end up
+ * in the states of its plain one. The weights and states are multiples of powers of two, so
+ * that the sums come out exact in any order.
+ *
+ * Usage: checkpoint_rollback [neurons [iterations [file prefix]]]
+ */
+
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+#include "IncrementalNeuron.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state -= 0.01 * neuron_state * input;
+
+      return fabs (input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return neuron_state * state; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+// Functors of the incremental and plain networks.
+
+struct SumState
+{
+    double sum;
+    double value;
+};
+
+static double value_of (const double & state) { return state; }
+static double value_of (const SumState & state) { return state.value; }
+static double quantize (double x) { return floor (x * 1024.0 + 0.5) / 1024.0; }
+
+template <class State> class QuantizedDendriteFunctor : public DendriteFunctor<State, double, double>
+{
+  public:
+
+    typedef DendriteFunctor<State, double, double> Base;
+    typedef typename Base::NeuronStateType         NeuronStateType;
+    typedef typename Base::DendriteStateType       DendriteStateType;
+    typedef typename Base::SignalType              SignalType;
+
+    QuantizedDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = floor (drand48 () * 129.0) / 64.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0; }
+
+  private:
+
+    SignalType input;
+};
+
+template <class State> class ValueSynapseFunctor : public SynapseFunctor<State, double>
+{
+  public:
+
+    virtual bool process_output (const State & neuron_state) { return true; }
+    virtual bool process_feedback (const State & neuron_state, double signal) { return false; }
+    virtual double propagate (const State & neuron_state) const { return value_of (neuron_state); }
+    virtual double backpropagate (const State & neuron_state) const { return 0.0; }
+};
+
+class PlainFunctor : public NeuronFunctor<QuantizedDendriteFunctor<double>, double, ValueSynapseFunctor<double> >
+{
+  public:
+
+    PlainFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double v = quantize (tanh (sum + 0.1));
+      bool changed = v != neuron_state;
+
+      neuron_state = v;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double sum;
+};
+
+class SumFunctor : public IncrementalNeuronFunctor<QuantizedDendriteFunctor<SumState>, SumState, ValueSynapseFunctor<SumState> >
+{
+  public:
+
+    SumFunctor () : delta (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      neuron_state.sum += delta;
+
+      double v = quantize (tanh (neuron_state.sum + 0.1));
+      bool changed = v != neuron_state.value;
+
+      neuron_state.value = v;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void update_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType previous, DendriteSignalType signal)
+    {
+      delta += signal - previous;
+    }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double delta;
+};
+
+typedef Neuron<PlainFunctor> PlainNeuron;
+typedef IncrementalNeuron<SumFunctor> SumNeuron;
+
+static const unsigned int degree = 4;
+
+// Synapse k of neuron i leads to dendrite k of neuron (i + k * 7919 + 1) mod n. The weights
+// come from drand48 ().
+
+static void build (NeuralNetwork & nn, size_t n, long int seed, NeuronFactoryBase & factory = TanhNeuron::factory)
+{
+  srand48 (seed);
+
+  nn.generate_random_core_neurons (factory, n, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i += 100) nn.fire (nn.neuron (i));
+}
+
+static void run (NeuralNetwork & nn, unsigned long int n_iterations)
+{
+  for (unsigned long int i = 0; i < n_iterations and nn.is_firing (); i++) nn.run ();
+}
+
+// States of all the neurons followed by those of all their dendrites.
+
+static std::vector<double> states (NeuralNetwork & nn)
+{
+  std::vector<double> s;
+
+  for (size_t i = 0; i < nn.neurons_count (); i++) s.push_back (static_cast<TanhNeuron *> (nn.neuron (i))->get_state ());
+
+  for (size_t i = 0; i < nn.neurons_count (); i++)
+  {
+    TanhNeuron::DendriteIterator d = static_cast<TanhNeuron *> (nn.neuron (i))->get_dendrites ();
+
+    for (unsigned int k = 0; k < degree; k++) s.push_back (d[k].get_state ());
+  }
+
+  return s;
+}
+
+static long int file_size (const std::string & filename)
+{
+  FILE * f = fopen (filename.c_str (), "rb");
+
+  if (not f) return -1;
+
+  fseek (f, 0, SEEK_END);
+
+  long int size = ftell (f);
+
+  fclose (f);
+
+  return size;
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 10000;
+  unsigned long int n_iterations = argc > 2 ? strtoul (argv[2], 0, 10) : 2;
+  std::string prefix = argc > 3 ? argv[3] : "checkpoint_rollback";
+
+  if (n_neurons == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [iterations [file prefix]]]\n";
+    return 1;
+  }
+
+  std::string full = prefix + ".0", first = prefix + ".1", second = prefix + ".2", empty = prefix + ".3";
+  std::string compacted = prefix + ".all";
+  const char * files[] = { full.c_str (), first.c_str (), second.c_str () };
+
+  NeuralNetwork original, replayed, restored;
+
+  build (original, n_neurons, 1);
+  build (replayed, n_neurons, 2);
+  build (restored, n_neurons, 3);
+
+  unsigned long int errors = 0;
+
+  run (original, n_iterations);
+  errors += not original.save_checkpoint (files[0], true);
+  run (original, n_iterations);
+  errors += not original.save_checkpoint (files[1]);
+  run (original, n_iterations);
+  errors += not original.save_checkpoint (files[2]);
+  errors += not original.save_checkpoint (empty.c_str ());
+
+  std::vector<double> saved = states (original);
+  unsigned long int saved_iteration = original.iterations ();
+
+  run (original, n_iterations);
+
+  // An empty delta is just the header, as is any checkpoint of a network with no neurons.
+
+  NeuralNetwork none;
+
+  errors += not none.save_checkpoint (compacted.c_str ()) or file_size (empty) != file_size (compacted);
+
+  for (size_t i = 0; i < 3; i++) errors += not replayed.load_checkpoint (files[i]);
+
+  errors += not NeuralNetwork::compact_checkpoints (files, 3, compacted.c_str ());
+  errors += not restored.load_checkpoint (compacted.c_str ());
+  errors += not original.load_checkpoint (compacted.c_str ());
+
+  NeuralNetwork * loaded[] = { &replayed, &restored, &original };
+
+  for (size_t i = 0; i < 3; i++)
+  {
+    std::vector<double> s = states (*loaded[i]);
+
+    errors += loaded[i]->iterations () != saved_iteration;
+
+    for (size_t k = 0; k < s.size (); k++) errors += s[k] != saved[k];
+  }
+
+  long int sizes[] = { file_size (files[0]), file_size (files[1]), file_size (files[2]), file_size (compacted) };
+
+  // Rolling back an incremental and a plain network to a full checkpoint and a delta, and
+  // replaying just the delta onto another pair run up to the full checkpoint by themselves.
+  // Neurons left as they were in the latter have to read the restored ones again.
+
+  NeuralNetwork incremental, replayed_incremental, plain, replayed_plain;
+
+  build (incremental, n_neurons, 1, SumNeuron::factory);
+  build (replayed_incremental, n_neurons, 1, SumNeuron::factory);
+  build (plain, n_neurons, 1, PlainNeuron::factory);
+  build (replayed_plain, n_neurons, 1, PlainNeuron::factory);
+
+  NeuralNetwork * rolled_back[] = { &incremental, &replayed_incremental, &plain, &replayed_plain };
+
+  for (size_t k = 0; k < 4; k++) run (*rolled_back[k], 2 * n_iterations);
+
+  errors += not incremental.save_checkpoint (files[0], true) or not plain.save_checkpoint (compacted.c_str (), true);
+
+  run (incremental, 2 * n_iterations);
+  run (plain, 2 * n_iterations);
+
+  errors += not incremental.save_checkpoint (files[1]) or not plain.save_checkpoint (files[2]);
+
+  run (incremental, 2 * n_iterations);
+  run (plain, 2 * n_iterations);
+
+  errors += not incremental.load_checkpoint (files[0]) or not incremental.load_checkpoint (files[1]);
+  errors += not plain.load_checkpoint (compacted.c_str ()) or not plain.load_checkpoint (files[2]);
+  errors += not replayed_incremental.load_checkpoint (files[1]) or not replayed_plain.load_checkpoint (files[2]);
+
+  for (size_t k = 0; k < 4; k++)
+  {
+    for (size_t i = 0; i < n_neurons; i++) rolled_back[k]->fire (rolled_back[k]->neuron (i));
+
+    run (*rolled_back[k], 4 * n_iterations);
+  }
+
+  for (size_t k = 0; k < 2; k++)
+  {
+    errors += rolled_back[k]->iterations () != rolled_back[k + 2]->iterations ();
+
+    for (size_t i = 0; i < n_neurons; i++)
+      errors += static_cast<SumNeuron *> (rolled_back[k]->neuron (i))->get_state ().value !=
+                static_cast<PlainNeuron *> (rolled_back[k + 2]->neuron (i))->get_state ();
+  }
+
+  std::cout << saved_iteration << " iterations, checkpoints of " << sizes[0] << ", " << sizes[1] << " and " << sizes[2]
+            << " bytes compacted into " << sizes[3] << ", "
+            << errors << " differences\n";
+
+  remove (full.c_str ());
+  remove (first.c_str ());
+  remove (second.c_str ());
+  remove (empty.c_str ());
+  remove (compacted.c_str ());
+
+  return errors != 0;
+}
@@ -0,0 +1,313 @@
+/* cycle_detection.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks NeuralNetwork::run_until () and run_n (). Small networks of sign neurons which keep
+ * firing whether their states change or not are bound to end in a steady state or a limit
+ * cycle. Each is run with run_until () and cycle detection enabled, and the same network is
+ * run with the plain run (), keeping the states of the neurons and the neurons queued after
+ * the last iterations to find the cycle by comparing them. Both have to stop at the same
+ * iteration with the same period and states. Networks of tanh neurons with no loops have to quiesce, after as many iterations
+ * of run_n () as of run (), and a RunCondition has to stop run_until () right when met.
+ *
+ * Usage: cycle_detection [networks [neurons [window]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include "libnn.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+// Fires every time it is recomputed, so the network never quiesces. If recomputed is given,
+// the neurons recomputed are listed there by the address of their state.
+
+class SignFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    SignFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = sum > 0.0 ? 1.0 : -1.0;
+
+      if (recomputed) recomputed->push_back (&neuron_state);
+
+      return true;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+    static std::vector<const double *> * recomputed;
+
+  private:
+
+    double sum;
+};
+
+std::vector<const double *> * SignFunctor::recomputed = 0;
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double sum;
+};
+
+typedef Neuron<SignFunctor> SignNeuron;
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+static const unsigned int degree = 3;
+static const unsigned long int max_iterations = 1000;
+
+// Synapse k of neuron i leads to dendrite k of neuron (i + k * 7919 + 1) mod n, or with no
+// loops, of neuron i + k + 1 if there is one. The weights come from drand48 (), hence the
+// same seed.
+
+static void build (NeuralNetwork & nn, NeuronFactoryBase & factory, size_t n, long int seed, bool loops)
+{
+  srand48 (seed);
+
+  nn.generate_random_core_neurons (factory, n, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, loops ? (i + k * 7919 + 1) % n : i + k + 1, k };
+
+      if (e.target < n) edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i++) nn.fire (nn.neuron (i));
+}
+
+template <class NeuronType> static void get_states (NeuralNetwork & nn, std::vector<double> & states)
+{
+  states.resize (nn.neurons_count ());
+
+  for (size_t i = 0; i < states.size (); i++) states[i] = static_cast<NeuronType *> (nn.neuron (i))->get_state ();
+}
+
+// State of the network after an iteration: the states of its neurons and which of them are
+// queued, known once they are recomputed in the next iteration.
+
+struct Snapshot
+{
+    std::vector<double> states;
+    std::vector<const double *> queued;
+    unsigned long int iteration;
+};
+
+// Run with run () until the network comes back to the state it had after one of the last
+// window iterations, returning the period, or 0 if it doesn't within max_iterations. The
+// network is then one iteration ahead; its state when the cycle was found is left in found.
+
+static unsigned long int find_cycle (NeuralNetwork & nn, size_t window, Snapshot & found)
+{
+  std::vector<Snapshot> last (window);
+  std::vector<const double *> recomputed;
+
+  SignFunctor::recomputed = &recomputed;
+
+  nn.run ();
+
+  for (unsigned long int i = 0; i < max_iterations; i++)
+  {
+    found.iteration = nn.iterations ();
+    get_states<SignNeuron> (nn, found.states);
+
+    recomputed.clear ();
+    nn.run ();
+
+    found.queued = recomputed;
+    std::sort (found.queued.begin (), found.queued.end ());
+
+    for (size_t k = 0; k < window and k < i; k++)
+      if (last[k].states == found.states and last[k].queued == found.queued)
+      {
+        SignFunctor::recomputed = 0;
+        return found.iteration - last[k].iteration;
+      }
+
+    last[i % window] = found;
+  }
+
+  SignFunctor::recomputed = 0;
+
+  return 0;
+}
+
+class IterationReached : public RunCondition
+{
+  public:
+
+    IterationReached (unsigned long int i) : iteration (i) {}
+
+    virtual bool operator () (const NeuralNetwork & nn) { return nn.iterations () >= iteration; }
+
+  private:
+
+    unsigned long int iteration;
+};
+
+int main (int argc, char** argv)
+{
+  unsigned long int n_networks = argc > 1 ? strtoul (argv[1], 0, 10) : 40;
+  size_t n_neurons = argc > 2 ? strtoul (argv[2], 0, 10) : 16;
+  size_t window = argc > 3 ? strtoul (argv[3], 0, 10) : 64;
+
+  if (n_networks == 0 or n_neurons < 2 or window == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [networks [neurons [window]]]\n";
+    return 1;
+  }
+
+  unsigned long int errors = 0, steady = 0, cycles = 0, longest = 0;
+
+  for (unsigned long int seed = 1; seed <= n_networks; seed++)
+  {
+    NeuralNetwork detecting, comparing;
+
+    build (detecting, SignNeuron::factory, n_neurons, seed, true);
+    build (comparing, SignNeuron::factory, n_neurons, seed, true);
+
+    detecting.set_cycle_detection (window);
+
+    RunStatus status = detecting.run_until (max_iterations);
+    Snapshot found;
+    unsigned long int period = find_cycle (comparing, window, found);
+
+    if (period == 0)
+      errors += status != RUN_MAX_ITERATIONS;
+    else
+      errors += status != RUN_CYCLE or detecting.cycle_period () != period;
+
+    std::vector<double> states;
+
+    get_states<SignNeuron> (detecting, states);
+
+    errors += detecting.iterations () != found.iteration or states != found.states;
+
+    steady += period == 1;
+    cycles += period > 1;
+    longest = std::max (longest, period);
+  }
+
+  // Networks with no loops quiesce.
+
+  for (unsigned long int seed = 1; seed <= n_networks; seed++)
+  {
+    NeuralNetwork detecting, comparing;
+
+    build (detecting, TanhNeuron::factory, n_neurons, seed, false);
+    build (comparing, TanhNeuron::factory, n_neurons, seed, false);
+
+    detecting.set_cycle_detection (window);
+
+    unsigned long int n = detecting.run_n (max_iterations);
+
+    while (comparing.is_firing () and comparing.iterations () < max_iterations) comparing.run ();
+
+    errors += detecting.is_firing () or n != comparing.iterations ();
+
+    std::vector<double> a, b;
+
+    get_states<TanhNeuron> (detecting, a);
+    get_states<TanhNeuron> (comparing, b);
+
+    errors += a != b;
+  }
+
+  // The condition is checked after every iteration.
+
+  NeuralNetwork conditioned;
+  IterationReached third (3);
+
+  build (conditioned, TanhNeuron::factory, n_neurons, 1, true);
+
+  errors += conditioned.run_until (max_iterations, 0.0, &third) != RUN_CONDITION or conditioned.iterations () != 3;
+
+  std::cout << n_networks << " networks, " << steady << " steady states, " << cycles << " limit cycles up to "
+            << longest << " iterations long, " << errors << " differences\n";
+
+  return errors != 0;
+}
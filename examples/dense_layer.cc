@@ -0,0 +1,242 @@
+/* dense_layer.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks DenseLayer against free-form neurons. Two networks compute the same two layer
+ * perceptron with the plain run (): one as a stack of two DenseLayers built by LayerBuilder,
+ * the other as a neuron per output with a dendrite per weight. Both are given the same
+ * input states a few times over and the outputs of the layers have to match those of the
+ * neurons. The layers add up the weighted inputs in a different order than the neurons do,
+ * so the states are compared up to the rounding of the sums.
+ *
+ * Usage: dense_layer [inputs [hidden [outputs [rounds]]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+#include "DenseLayer.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = 0.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return 0.0; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum);
+      bool changed = s != neuron_state;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double sum;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+typedef DenseLayer<TanhFunctor> TanhLayer;
+
+static double weight (unsigned int layer, size_t input, size_t output)
+{
+  return 0.5 * sin (layer * 1.7 + input * 0.37 + output * 2.3);
+}
+
+static double input_state (unsigned int round, size_t input)
+{
+  return cos (round * 0.9 + input * 0.13);
+}
+
+static size_t max_iterations = 10;
+
+static void run (NeuralNetwork & nn)
+{
+  for (size_t i = 0; i < max_iterations and nn.is_firing (); i++) nn.run ();
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_inputs = argc > 1 ? strtoul (argv[1], 0, 10) : 256;
+  size_t n_hidden = argc > 2 ? strtoul (argv[2], 0, 10) : 128;
+  size_t n_outputs = argc > 3 ? strtoul (argv[3], 0, 10) : 10;
+  unsigned int n_rounds = argc > 4 ? strtoul (argv[4], 0, 10) : 4;
+
+  if (n_inputs == 0 or n_hidden == 0 or n_outputs == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [inputs [hidden [outputs [rounds]]]]\n";
+    return 1;
+  }
+
+  // The layered network: the inputs feed the first layer through their synapse 0.
+
+  NeuralNetwork layered;
+  LayerBuilder<TanhFunctor> builder (layered);
+  std::vector<NeuronVector::size_type> inputs (n_inputs);
+
+  for (size_t i = 0; i < n_inputs; i++)
+  {
+    inputs[i] = layered.neurons_count ();
+    layered.create_neuron (TanhNeuron::factory, 1, 1);
+  }
+
+  TanhLayer * hidden_layer = builder.add_input_layer (&inputs[0], n_inputs, 0, n_hidden);
+  TanhLayer * output_layer = hidden_layer ? builder.add_layer (n_outputs) : 0;
+
+  if (output_layer == 0)
+  {
+    std::cerr << "Building the layers failed\n";
+    return 1;
+  }
+
+  for (size_t i = 0; i < n_inputs; i++)
+    for (size_t j = 0; j < n_hidden; j++) hidden_layer->weight (i, j) = weight (0, i, j);
+
+  for (size_t j = 0; j < n_hidden; j++)
+    for (size_t k = 0; k < n_outputs; k++) output_layer->weight (j, k) = weight (1, j, k);
+
+  // The same perceptron of free-form neurons: inputs, then hidden, then output neurons.
+
+  NeuralNetwork neurons;
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n_inputs; i++) neurons.create_neuron (TanhNeuron::factory, 1, n_hidden);
+  for (size_t j = 0; j < n_hidden; j++) neurons.create_neuron (TanhNeuron::factory, n_inputs, n_outputs);
+  for (size_t k = 0; k < n_outputs; k++) neurons.create_neuron (TanhNeuron::factory, n_hidden, 1);
+
+  for (size_t i = 0; i < n_inputs; i++)
+  {
+    for (size_t j = 0; j < n_hidden; j++)
+    {
+      Edge e = { i, j, n_inputs + j, i };
+
+      edges.push_back (e);
+    }
+  }
+
+  for (size_t j = 0; j < n_hidden; j++)
+  {
+    for (size_t k = 0; k < n_outputs; k++)
+    {
+      Edge e = { n_inputs + j, k, n_inputs + n_hidden + k, j };
+
+      edges.push_back (e);
+    }
+  }
+
+  if (not neurons.connect (&edges[0], edges.size ()))
+  {
+    std::cerr << "Connecting the neurons failed\n";
+    return 1;
+  }
+
+  for (size_t j = 0; j < n_hidden; j++)
+  {
+    TanhNeuron::DendriteIterator d = static_cast<TanhNeuron *> (neurons.neuron (n_inputs + j))->get_dendrites ();
+
+    for (size_t i = 0; i < n_inputs; i++) d[i].get_state () = weight (0, i, j);
+  }
+
+  for (size_t k = 0; k < n_outputs; k++)
+  {
+    TanhNeuron::DendriteIterator d = static_cast<TanhNeuron *> (neurons.neuron (n_inputs + n_hidden + k))->get_dendrites ();
+
+    for (size_t j = 0; j < n_hidden; j++) d[j].get_state () = weight (1, j, k);
+  }
+
+  // Each round sets the inputs' states and queues what they feed.
+
+  double max_difference = 0.0;
+  unsigned long int errors = 0;
+
+  for (unsigned int r = 0; r < n_rounds; r++)
+  {
+    for (size_t i = 0; i < n_inputs; i++)
+    {
+      static_cast<TanhNeuron *> (layered.neuron (inputs[i]))->get_state () = input_state (r, i);
+      static_cast<TanhNeuron *> (neurons.neuron (i))->get_state () = input_state (r, i);
+    }
+
+    layered.fire (hidden_layer);
+
+    for (size_t j = 0; j < n_hidden; j++) neurons.fire (neurons.neuron (n_inputs + j));
+
+    run (layered);
+    run (neurons);
+
+    if (layered.is_firing () or neurons.is_firing () or layered.iterations () != neurons.iterations ()) errors++;
+
+    for (size_t j = 0; j < n_hidden; j++)
+      max_difference = std::max (max_difference, fabs (hidden_layer->get_state (j) -
+                                                       static_cast<TanhNeuron *> (neurons.neuron (n_inputs + j))->get_state ()));
+
+    for (size_t k = 0; k < n_outputs; k++)
+      max_difference = std::max (max_difference, fabs (output_layer->get_state (k) -
+                                                       static_cast<TanhNeuron *> (neurons.neuron (n_inputs + n_hidden + k))->get_state ()));
+  }
+
+  if (max_difference > 1e-12) errors++;
+
+  std::cout << n_rounds << " rounds, " << layered.iterations () << " iterations, largest difference " << max_difference << ", "
+            << errors << " errors\n";
+
+  return errors != 0;
+}
@@ -0,0 +1,238 @@
+/* ensemble.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks Ensemble against the plain run (). Each replica of the ensemble starts from a
+ * different set of fired neurons and a network of its own is run with run () from the same
+ * ones. Halfway through, every replica is forked and the fork has the state of one neuron
+ * changed, the neurons it feeds being fired, and so has yet another network. All the
+ * replicas, forks and originals, have to end up in the states of their networks.
+ * The network has two halves, each feeding the other, and only neurons of the half to be
+ * computed next are fired, so the frontier never holds a neuron together with one feeding it.
+ *
+ * Usage: ensemble [neurons [degree [replicas [iterations]]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+#include "Ensemble.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return 0.0; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double sum;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+static void build (NeuralNetwork & nn, size_t half, unsigned int degree)
+{
+  srand48 (1);
+
+  nn.generate_random_core_neurons (TanhNeuron::factory, 2 * half, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < 2 * half; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e;
+
+      e.source = i;
+      e.synapse = k;
+      e.target = (i < half ? half : 0) + (i % half + k * 7919) % half;
+      e.dendrite = k;
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+}
+
+// Replica r starts with every (r + 2)-th neuron of the first half fired. Its fork gets the
+// state of the neuron given by changed_neuron () changed to 0.5. That one is in the second
+// half, since the number of iterations before the fork is even and the first half is to be
+// computed next.
+
+static size_t changed_neuron (size_t half, size_t r)
+{
+  return half + (r * 7 + 1) % half;
+}
+
+static void run (NeuralNetwork & nn, unsigned long int n)
+{
+  for (unsigned long int i = 0; i < n and nn.is_firing (); i++) nn.run ();
+}
+
+template <class Replica> static unsigned long int compare (NeuralNetwork & nn, const Replica & replica)
+{
+  unsigned long int differences = nn.iterations () != replica.iterations ();
+
+  for (NeuronVector::size_type i = 0; i < nn.neurons_count (); i++)
+    differences += static_cast<TanhNeuron *> (nn.neuron (i))->get_state () != replica.state (i);
+
+  return differences;
+}
+
+int main (int argc, char** argv)
+{
+  size_t half = (argc > 1 ? strtoul (argv[1], 0, 10) : 20000) / 2;
+  unsigned int degree = argc > 2 ? strtoul (argv[2], 0, 10) : 8;
+  size_t n_replicas = argc > 3 ? strtoul (argv[3], 0, 10) : 4;
+  unsigned long int n_iterations = argc > 4 ? strtoul (argv[4], 0, 10) : 20;
+  unsigned long int split = n_iterations / 4 * 2;
+
+  if (half == 0 or degree == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [degree [replicas [iterations]]]]\n";
+    return 1;
+  }
+
+  NeuralNetwork prototype;
+
+  build (prototype, half, degree);
+
+  Ensemble<TanhNeuron> ensemble (prototype, n_replicas);
+
+  if (not ensemble.is_valid ())
+  {
+    std::cerr << "The ensemble can't run the network\n";
+    return 1;
+  }
+
+  std::vector<NeuralNetwork *> networks, fork_networks;
+
+  for (size_t r = 0; r < n_replicas; r++)
+  {
+    networks.push_back (new NeuralNetwork);
+    fork_networks.push_back (new NeuralNetwork);
+
+    build (*networks[r], half, degree);
+    build (*fork_networks[r], half, degree);
+
+    for (size_t i = 0; i < half; i += r + 2)
+    {
+      ensemble.replica (r).fire (i);
+      networks[r]->fire (networks[r]->neuron (i));
+      fork_networks[r]->fire (fork_networks[r]->neuron (i));
+    }
+  }
+
+  ensemble.run_n (split);
+
+  for (size_t r = 0; r < n_replicas; r++)
+  {
+    Ensemble<TanhNeuron>::Replica & fork = ensemble.replica (ensemble.fork (r));
+    NeuralNetwork & nn = *fork_networks[r];
+    NeuronBase * n = nn.neuron (changed_neuron (half, r));
+
+    run (*networks[r], split);
+    run (nn, split);
+
+    fork.set_state (changed_neuron (half, r), 0.5);
+    static_cast<TanhNeuron *> (n)->get_state () = 0.5;
+
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      size_t target = (changed_neuron (half, r) % half + k * 7919) % half;
+
+      fork.fire (target);
+      nn.fire (nn.neuron (target));
+    }
+  }
+
+  ensemble.run_n (n_iterations - split);
+
+  unsigned long int errors = 0;
+  size_t fork_bytes = 0;
+
+  for (size_t r = 0; r < n_replicas; r++)
+  {
+    run (*networks[r], n_iterations - split);
+    run (*fork_networks[r], n_iterations - split);
+
+    errors += compare (*networks[r], ensemble.replica (r)) + compare (*fork_networks[r], ensemble.replica (n_replicas + r));
+    fork_bytes += ensemble.replica (n_replicas + r).private_size ();
+
+    delete networks[r];
+    delete fork_networks[r];
+  }
+
+  std::cout << 2 * n_replicas << " replicas of " << 2 * half << " neurons, " << n_iterations << " iterations, forks owning "
+            << fork_bytes << " bytes, " << errors << " differences\n";
+
+  return errors != 0;
+}
@@ -0,0 +1,253 @@
+/* fixed_neuron.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks FixedNeuron against Neuron. Two networks of the same topology and initial weights,
+ * one of FixedNeuron<F, 4, 4> and one of Neuron<F> with four dendrites and synapses each, are
+ * run forward and backward with the plain run (). Halfway through, the same connections are
+ * moved in both with connect (), so that the connectors have to be rewired from both ends.
+ * All the neuron and dendrite states have to come out the same, and both ends of every
+ * connection have to lead to each other. The FixedNeuron factory also
+ * has to refuse neurons of any other arity.
+ *
+ * Usage: fixed_neuron [neurons [iterations]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state -= 0.01 * neuron_state * input;
+
+      return fabs (input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return neuron_state * state; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+static const unsigned int degree = 4;
+
+typedef Neuron<TanhFunctor> FreeNeuron;
+typedef FixedNeuron<TanhFunctor, degree, degree> FourNeuron;
+
+// Synapse k of neuron i leads to dendrite k of neuron (i + k * 7919 + 1) mod n. The weights
+// come from drand48 (), hence the same seed.
+
+static void build (NeuralNetwork & nn, NeuronFactoryBase & factory, size_t n)
+{
+  srand48 (1);
+
+  for (size_t i = 0; i < n; i++) nn.create_neuron (factory, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i += 5) nn.fire (nn.neuron (i));
+}
+
+// Swap the targets of synapses 0 and 1 of every seventh neuron, firing the neurons whose
+// inputs changed.
+
+static void rewire (NeuralNetwork & nn)
+{
+  for (size_t i = 0; i < nn.neurons_count (); i += 7)
+  {
+    NeuronBase * n = nn.neuron (i);
+    NeuronBase * a = const_cast<NeuronBase *> (n->synapse_target (0));
+    NeuronBase * b = const_cast<NeuronBase *> (n->synapse_target (1));
+    Connector::size_type da = n->synapse_dendrite (0);
+    Connector::size_type db = n->synapse_dendrite (1);
+
+    if (a == 0 or b == 0) continue;
+
+    nn.connect (n, 0, b, db);
+    nn.connect (n, 1, a, da);
+    nn.fire (a);
+    nn.fire (b);
+  }
+}
+
+// Number of synapses of the neuron whose dendrite on the other end doesn't lead back to them.
+
+static unsigned long int broken_ends (const NeuronBase * n)
+{
+  unsigned long int broken = 0;
+
+  for (Connector::size_type k = 0; k < n->n_synapses (); k++)
+  {
+    const NeuronBase * t = n->synapse_target (k);
+
+    if (t) broken += t->dendrite_source (n->synapse_dendrite (k)) != n or t->dendrite_synapse (n->synapse_dendrite (k)) != k;
+  }
+
+  return broken;
+}
+
+template <class NeuronType> static double dendrite_state (NeuralNetwork & nn, size_t i, unsigned int k)
+{
+  return static_cast<NeuronType *> (nn.neuron (i))->get_dendrites ()[k].get_state ();
+}
+
+template <class NeuronType> static double neuron_state (NeuralNetwork & nn, size_t i)
+{
+  return static_cast<NeuronType *> (nn.neuron (i))->get_state ();
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 10000;
+  unsigned long int n_iterations = argc > 2 ? strtoul (argv[2], 0, 10) : 30;
+
+  if (n_neurons < 2)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [iterations]]\n";
+    return 1;
+  }
+
+  NeuralNetwork free_form, fixed;
+
+  build (free_form, FreeNeuron::factory, n_neurons);
+  build (fixed, FourNeuron::factory, n_neurons);
+
+  unsigned long int errors = fixed.neurons_count () != n_neurons;
+
+  // Neurons of any other arity are refused.
+
+  fixed.create_neuron (FourNeuron::factory, degree + 1, degree);
+  fixed.create_neuron (FourNeuron::factory, degree, 0);
+
+  errors += fixed.neurons_count () != n_neurons;
+
+  for (unsigned long int i = 0; i < n_iterations and (free_form.is_firing () or fixed.is_firing ()); i++)
+  {
+    if (i == n_iterations / 2)
+    {
+      rewire (free_form);
+      rewire (fixed);
+    }
+
+    free_form.run ();
+    fixed.run ();
+  }
+
+  errors += free_form.iterations () != fixed.iterations ();
+
+  for (size_t i = 0; i < n_neurons; i++)
+  {
+    NeuronBase * a = free_form.neuron (i);
+    NeuronBase * b = fixed.neuron (i);
+
+    errors += neuron_state<FreeNeuron> (free_form, i) != neuron_state<FourNeuron> (fixed, i);
+    errors += broken_ends (a) + broken_ends (b);
+
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      errors += dendrite_state<FreeNeuron> (free_form, i, k) != dendrite_state<FourNeuron> (fixed, i, k);
+
+      const NeuronBase * ta = a->synapse_target (k);
+      const NeuronBase * tb = b->synapse_target (k);
+
+      if (ta == 0 or tb == 0)
+        errors += ta != tb;
+      else
+        errors += ta->id () != tb->id () or a->synapse_dendrite (k) != b->synapse_dendrite (k);
+    }
+  }
+
+  std::cout << free_form.iterations () << " iterations, " << free_form.size () / n_neurons << " and "
+            << fixed.size () / n_neurons << " bytes per neuron, " << errors << " differences\n";
+
+  return errors != 0;
+}
@@ -0,0 +1,224 @@
+/* large_network.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Large scale stress benchmark. Builds a network of the given number of neurons, each of them
+ * with the given number of dendrites and synapses, connects it with the bulk connect () and
+ * runs it for the given number of iterations, checking on the way that the neuron ids and
+ * the counts hold up. Synapse k of neuron i leads to dendrite k of neuron (a_k * i + k) mod n,
+ * a_k being coprime with n, so that every dendrite gets exactly one connection whatever the
+ * size of the network, without any bookkeeping.
+ *
+ * Usage: large_network [neurons [degree [iterations]]]
+ *
+ * Networks of more than 4G neurons need 64 bit ids (configure --enable-64bit-ids).
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <numeric>
+#include "libnn.h"
+
+class SumDendriteFunctor : public DendriteFunctor<float, float, float>
+{
+  public:
+    SumDendriteFunctor () : input (0.0f) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = (float)(drand48 () * 2.0 - 1.0); }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0f; }
+
+  private:
+
+    SignalType input;
+};
+
+class SumSynapseFunctor : public SynapseFunctor<float, float>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return 0.0f; }
+};
+
+class SumFunctor : public NeuronFunctor<SumDendriteFunctor, float, SumSynapseFunctor>
+{
+  public:
+
+    SumFunctor () : sum (0.0f) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      float s = tanhf (sum + 0.1f);
+      bool changed = fabsf (s - neuron_state) > 1e-3f;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    float sum;
+};
+
+typedef Neuron<SumFunctor> SumNeuron;
+
+static double seconds_since (std::chrono::steady_clock::time_point t)
+{
+  return std::chrono::duration<double> (std::chrono::steady_clock::now () - t).count ();
+}
+
+int main (int argc, char** argv)
+{
+  unsigned long int n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 1000000;
+  unsigned int degree = argc > 2 ? strtoul (argv[2], 0, 10) : 4;
+  unsigned long int n_iterations = argc > 3 ? strtoul (argv[3], 0, 10) : 20;
+
+  if (n_neurons < 2 or degree == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [degree [iterations]]]\n";
+    return 1;
+  }
+
+  if (n_neurons - 1 > (unsigned long int)(nn_id_t)-1)
+  {
+    std::cerr << "Neuron ids are " << 8 * sizeof (nn_id_t) << " bit; configure with --enable-64bit-ids for "
+              << n_neurons << " neurons.\n";
+    return 1;
+  }
+
+  srand48 (1);
+
+  NeuralNetwork nn;
+  std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now ();
+
+  nn.generate_random_core_neurons (SumNeuron::factory, n_neurons, degree, degree, degree, degree);
+
+  std::cout << "Created " << nn.neurons_count () << " neurons in " << seconds_since (t) << " s\n";
+
+  // Multipliers coprime with the number of neurons make each synapse index a permutation.
+
+  std::vector<unsigned long int> multipliers (degree);
+
+  for (unsigned int k = 0; k < degree; k++)
+  {
+    unsigned long int a = (2654435761UL * (k + 1)) % n_neurons;
+
+    while (a == 0 or std::gcd (a, n_neurons) != 1) a = (a + 1) % n_neurons;
+
+    multipliers[k] = a;
+  }
+
+  t = std::chrono::steady_clock::now ();
+
+  const size_t chunk = 1 << 20;
+  std::vector<Edge> edges;
+  unsigned long int n_edges = 0;
+
+  edges.reserve (chunk);
+
+  for (unsigned long int i = 0; i < n_neurons; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e;
+
+      e.source = i;
+      e.synapse = k;
+      e.target = (unsigned long int)(((unsigned __int128)multipliers[k] * i + k) % n_neurons);
+      e.dendrite = k;
+
+      edges.push_back (e);
+    }
+
+    if (edges.size () >= chunk or i == n_neurons - 1)
+    {
+      if (not nn.connect (&edges[0], edges.size ()))
+      {
+        std::cerr << "Connecting failed at neuron " << i << std::endl;
+        return 1;
+      }
+
+      n_edges += edges.size ();
+      edges.clear ();
+    }
+  }
+
+  std::cout << "Made " << n_edges << " connections in " << seconds_since (t) << " s\n";
+
+  // Checks: the ids must be consecutive and every synapse must be connected.
+
+  unsigned long int errors = 0;
+
+  if (nn.neurons_count () != n_neurons) errors++;
+  if ((unsigned long int)(nn.neuron (n_neurons - 1)->id () - nn.neuron (0)->id ()) != n_neurons - 1) errors++;
+
+  for (unsigned long int i = 0; i < n_neurons; i++)
+    for (unsigned int k = 0; k < degree; k++)
+      if (nn.neuron (i)->synapse_target (k) == 0) errors++;
+
+  MemoryReport report = nn.memory_report ();
+
+  std::cout << "Memory: " << report.total () << " bytes, " << (double)report.total () / n_neurons << " per neuron, "
+            << 8 * sizeof (nn_id_t) << " bit ids\n";
+
+  for (unsigned long int i = 0; i < n_neurons; i += 100) nn.fire (nn.neuron (i));
+
+  t = std::chrono::steady_clock::now ();
+
+  unsigned long int recomputed = 0;
+
+  for (unsigned long int i = 0; i < n_iterations and nn.is_firing (); i++)
+  {
+    recomputed += nn.neurons_firing_count ();
+    nn.run ();
+  }
+
+  double elapsed = seconds_since (t);
+
+  std::cout << nn.iterations () << " iterations, " << recomputed << " neurons recomputed in " << elapsed << " s ("
+            << recomputed / elapsed << " neurons/s, " << recomputed * degree / elapsed << " edges/s)\n";
+
+  if (errors)
+  {
+    std::cerr << errors << " errors found\n";
+    return 1;
+  }
+
+  return 0;
+}
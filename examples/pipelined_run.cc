@@ -0,0 +1,185 @@
+/* pipelined_run.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks the pipelined mode against the sequential one. Two networks of the same topology
+ * and initial weights are run forward and backward, one with run () in the pipelined mode and
+ * one with run () in the sequential mode. After every iteration both have to queue the same
+ * neurons for recomputation and backpropagation, and in the end all the neuron and dendrite
+ * states have to come out the same.
+ *
+ * Usage: pipelined_run [neurons [degree [iterations]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state -= 0.01 * neuron_state * input;
+
+      return fabs (input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return neuron_state * state; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+// Synapse k of neuron i leads to dendrite k of neuron (i + k * 7919 + 1) mod n, so every
+// dendrite is connected once. The weights come from drand48 (), hence the same seed.
+
+static void build (NeuralNetwork & nn, size_t n, unsigned int degree)
+{
+  srand48 (1);
+
+  nn.generate_random_core_neurons (TanhNeuron::factory, n, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i += 5) nn.fire (nn.neuron (i));
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 10000;
+  unsigned int degree = argc > 2 ? strtoul (argv[2], 0, 10) : 4;
+  unsigned long int n_iterations = argc > 3 ? strtoul (argv[3], 0, 10) : 30;
+
+  if (n_neurons == 0 or degree == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [degree [iterations]]]\n";
+    return 1;
+  }
+
+  NeuralNetwork sequential, pipelined;
+
+  build (sequential, n_neurons, degree);
+  build (pipelined, n_neurons, degree);
+
+  pipelined.set_pipelined (true);
+
+  unsigned long int errors = 0, backpropagating = 0;
+
+  for (unsigned long int i = 0; i < n_iterations and (sequential.is_firing () or pipelined.is_firing ()); i++)
+  {
+    sequential.run ();
+    pipelined.run ();
+
+    errors += sequential.neurons_firing_count () != pipelined.neurons_firing_count ();
+    errors += sequential.neurons_backpropagating_count () != pipelined.neurons_backpropagating_count ();
+
+    backpropagating += pipelined.neurons_backpropagating_count ();
+  }
+
+  errors += sequential.iterations () != pipelined.iterations ();
+
+  for (size_t i = 0; i < n_neurons; i++)
+  {
+    TanhNeuron * a = static_cast<TanhNeuron *> (sequential.neuron (i));
+    TanhNeuron * b = static_cast<TanhNeuron *> (pipelined.neuron (i));
+    TanhNeuron::DendriteIterator da = a->get_dendrites ();
+    TanhNeuron::DendriteIterator db = b->get_dendrites ();
+
+    errors += a->get_state () != b->get_state ();
+
+    for (unsigned int k = 0; k < degree; k++) errors += da[k].get_state () != db[k].get_state ();
+  }
+
+  std::cout << sequential.iterations () << " iterations, " << backpropagating << " neurons backpropagated, "
+            << errors << " differences\n";
+
+  return errors != 0;
+}
@@ -169,7 +169,7 @@ int main (int argc, char** argv)
 
   std::cout << "Completed.\n\n";
 
-  unsigned int nsize = nn.size ();
+  unsigned long int nsize = nn.size ();
 
   std::cout << "SizeOf (Neuron)        = " << sizeof (TestNeuron) << std::endl <<
                "SizeOf (Dendrite)      = " << sizeof (TestDendrite) << std::endl <<
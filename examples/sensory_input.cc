@@ -0,0 +1,260 @@
+/* sensory_input.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks SensoryInput and SensoryNeuron. A producer thread publishes a sequence of frames
+ * into a small ring while another thread runs the network, which skips the frames it doesn't
+ * manage to consume in time. After every run () the frame the network used is recorded: it
+ * has to be one whole frame, never older than the previous one. The recorded frames are then
+ * published into a second network of the same topology and initial weights, one before each
+ * run (), and all the neuron and dendrite states have to come out the same.
+ *
+ * Slot 0 of each frame holds its sequence number, the other slots change every few frames.
+ * Once the last frame is used, the network is run for at most the given number of iterations
+ * more.
+ *
+ * Usage: sensory_input [neurons [inputs [frames [iterations]]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include "libnn.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state -= 0.01 * neuron_state * input;
+
+      return fabs (input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return neuron_state * state; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+typedef Neuron<TanhFunctor> CoreNeuron;
+typedef SensoryInput<StateSynapseFunctor> Input;
+
+static const unsigned int degree = 4;
+static const size_t ring_frames = 3;
+
+// Value of slot i in frame s out of n.
+
+static double frame_value (unsigned long int s, size_t i, unsigned long int n)
+{
+  return i == 0 ? (double)s / n : cos ((double)((s + i) / 4) * 1.3 + i);
+}
+
+static void fill_frame (double * frame, unsigned long int s, size_t n_inputs, unsigned long int n)
+{
+  for (size_t i = 0; i < n_inputs; i++) frame[i] = frame_value (s, i, n);
+}
+
+static void produce (Input * input, size_t n_inputs, unsigned long int n_frames)
+{
+  for (unsigned long int s = 1; s <= n_frames; s++)
+  {
+    double * frame;
+
+    while ((frame = input->frame_to_write ()) == 0) std::this_thread::yield ();
+
+    fill_frame (frame, s, n_inputs, n_frames);
+    input->publish ();
+  }
+}
+
+// Core neurons come first. Synapse k of core neuron i leads to dendrite k of core neuron
+// (i + k * 7919 + 1) mod n, and the only synapse of sensory neuron j to the extra dendrite of
+// core neuron j * n / inputs. The weights come from drand48 (), hence the same seed.
+
+static void build (NeuralNetwork & nn, Input & input, size_t n)
+{
+  srand48 (1);
+
+  nn.generate_random_core_neurons (CoreNeuron::factory, n, degree + 1, degree + 1, degree, degree);
+  nn.generate_random_sensory_neurons (input, 1, 1);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  for (size_t j = 0; j < input.n_inputs (); j++)
+  {
+    Edge e = { n + j, 0, j * n / input.n_inputs (), degree };
+
+    edges.push_back (e);
+  }
+
+  nn.connect (&edges[0], edges.size ());
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 10000;
+  size_t n_inputs = argc > 2 ? strtoul (argv[2], 0, 10) : 100;
+  unsigned long int n_frames = argc > 3 ? strtoul (argv[3], 0, 10) : 200;
+  unsigned long int n_iterations = argc > 4 ? strtoul (argv[4], 0, 10) : 30;
+
+  if (n_neurons == 0 or n_inputs == 0 or n_inputs > n_neurons or n_frames == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [inputs [frames [iterations]]]]\n";
+    return 1;
+  }
+
+  std::vector<double> running_buffer (ring_frames * n_inputs), replayed_buffer (ring_frames * n_inputs);
+
+  fill_frame (&running_buffer[0], 0, n_inputs, n_frames);
+  fill_frame (&replayed_buffer[0], 0, n_inputs, n_frames);
+
+  Input running_input (&running_buffer[0], n_inputs, ring_frames);
+  Input replayed_input (&replayed_buffer[0], n_inputs, ring_frames);
+  NeuralNetwork running, replayed;
+
+  build (running, running_input, n_neurons);
+  build (replayed, replayed_input, n_neurons);
+
+  unsigned long int errors = 0;
+  std::vector<unsigned long int> used; // frame used by each iteration of the running network
+  std::thread producer (produce, &running_input, n_inputs, n_frames);
+
+  unsigned long int more = 0; // iterations run since the last frame was used
+
+  while (used.empty () or used.back () != n_frames or (more < n_iterations and running.is_firing ()))
+  {
+    running.run ();
+
+    const double * frame = running_input.current ();
+    unsigned long int s = lround (frame[0] * n_frames);
+
+    for (size_t i = 0; i < n_inputs; i++) errors += frame[i] != frame_value (s, i, n_frames);
+
+    errors += not used.empty () and s < used.back ();
+
+    more += s == n_frames and not used.empty () and used.back () == n_frames;
+    used.push_back (s);
+
+    if (not running.is_firing ()) std::this_thread::yield ();
+  }
+
+  producer.join ();
+
+  unsigned long int skipped = n_frames;
+
+  for (size_t t = 0; t < used.size (); t++)
+  {
+    if (t == 0 or used[t] != used[t - 1])
+    {
+      fill_frame (replayed_input.frame_to_write (), used[t], n_inputs, n_frames);
+      replayed_input.publish ();
+      skipped--;
+    }
+
+    replayed.run ();
+  }
+
+  errors += running.iterations () != replayed.iterations ();
+
+  for (size_t i = 0; i < n_neurons; i++)
+  {
+    CoreNeuron * a = static_cast<CoreNeuron *> (running.neuron (i));
+    CoreNeuron * b = static_cast<CoreNeuron *> (replayed.neuron (i));
+    CoreNeuron::DendriteIterator da = a->get_dendrites ();
+    CoreNeuron::DendriteIterator db = b->get_dendrites ();
+
+    errors += a->get_state () != b->get_state ();
+
+    for (unsigned int k = 0; k <= degree; k++) errors += da[k].get_state () != db[k].get_state ();
+  }
+
+  std::cout << running.iterations () << " iterations, " << n_frames << " frames published, " << skipped
+            << " skipped, " << errors << " differences\n";
+
+  return errors != 0;
+}
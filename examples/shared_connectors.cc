@@ -0,0 +1,207 @@
+/* shared_connectors.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks the connectors sharing one static functor (SharedNeuronFunctor) against those
+ * embedding their own copy. The same dendrite and synapse functors, which keep everything in
+ * the dendrite state, are used by two neuron types differing only in the base of their
+ * neuron functor. Two networks of the same topology and initial weights, one of each type,
+ * are run forward and backward with the plain run (), and all the neuron and dendrite states
+ * have to come out the same.
+ *
+ * Usage: shared_connectors [neurons [degree [iterations]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+
+// The input is kept next to the weight, since a shared functor can't keep it.
+
+struct WeightedInput
+{
+    double weight;
+    double input;
+};
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, WeightedInput>
+{
+  public:
+
+    virtual void init_state (DendriteStateType & state) const
+    {
+      state.weight = drand48 () * 2.0 - 1.0;
+      state.input = 0.0;
+    }
+
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      state.input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state.weight -= 0.01 * neuron_state * state.input;
+
+      return fabs (state.input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const
+    {
+      return state.input * state.weight;
+    }
+
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const
+    {
+      return neuron_state * state.weight;
+    }
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+// The neuron functor, on top of either NeuronFunctor or SharedNeuronFunctor.
+
+template <class Base> class TanhFunctor : public Base
+{
+  public:
+
+    typedef typename Base::NeuronStateType    NeuronStateType;
+    typedef typename Base::DendriteStateType  DendriteStateType;
+    typedef typename Base::DendriteSignalType DendriteSignalType;
+    typedef typename Base::SynapseSignalType  SynapseSignalType;
+    typedef typename Base::size_type          size_type;
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+typedef Neuron<TanhFunctor<NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor> > > OwnNeuron;
+typedef Neuron<TanhFunctor<SharedNeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor> > > SharedNeuron;
+
+// Synapse k of neuron i leads to dendrite k of neuron (i + k * 7919 + 1) mod n, so every
+// dendrite is connected once. The weights come from drand48 (), hence the same seed.
+
+static void build (NeuralNetwork & nn, NeuronFactoryBase & factory, size_t n, unsigned int degree)
+{
+  srand48 (1);
+
+  nn.generate_random_core_neurons (factory, n, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i += 5) nn.fire (nn.neuron (i));
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 10000;
+  unsigned int degree = argc > 2 ? strtoul (argv[2], 0, 10) : 6;
+  unsigned long int n_iterations = argc > 3 ? strtoul (argv[3], 0, 10) : 30;
+
+  if (n_neurons == 0 or degree == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [degree [iterations]]]\n";
+    return 1;
+  }
+
+  NeuralNetwork own, shared;
+
+  build (own, OwnNeuron::factory, n_neurons, degree);
+  build (shared, SharedNeuron::factory, n_neurons, degree);
+
+  unsigned long int backpropagating = 0;
+
+  for (unsigned long int i = 0; i < n_iterations and own.is_firing (); i++)
+  {
+    backpropagating += own.neurons_backpropagating_count ();
+    own.run ();
+  }
+
+  for (unsigned long int i = 0; i < n_iterations and shared.is_firing (); i++) shared.run ();
+
+  unsigned long int errors = own.iterations () != shared.iterations ();
+
+  for (size_t i = 0; i < n_neurons; i++)
+  {
+    OwnNeuron * a = static_cast<OwnNeuron *> (own.neuron (i));
+    SharedNeuron * b = static_cast<SharedNeuron *> (shared.neuron (i));
+    OwnNeuron::DendriteIterator da = a->get_dendrites ();
+    SharedNeuron::DendriteIterator db = b->get_dendrites ();
+
+    errors += a->get_state () != b->get_state ();
+
+    for (unsigned int k = 0; k < degree; k++)
+      errors += da[k].get_state ().weight != db[k].get_state ().weight or da[k].get_state ().input != db[k].get_state ().input;
+  }
+
+  std::cout << own.iterations () << " iterations, " << backpropagating << " neurons backpropagated, dendrites of "
+            << sizeof (OwnNeuron::DendriteType) << " and " << sizeof (SharedNeuron::DendriteType) << " bytes, " << errors
+            << " differences\n";
+
+  return errors != 0;
+}
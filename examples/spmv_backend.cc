@@ -0,0 +1,185 @@
+/* spmv_backend.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Runs the same weighted sum network three times: with the plain run (), through the
+ * in-memory SpmvBackend and through the out-of-core one with the dendrites released, and
+ * checks that all the neuron states come out the same. The network has two halves, each
+ * feeding the other, and only the first half is fired, so the frontier never holds a neuron
+ * together with one feeding it.
+ *
+ * Usage: spmv_backend [neurons [degree [iterations [block file]]]]
+ */
+
+
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+#include "SpmvBackend.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return 0.0; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double sum;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+// Synapse k of neuron i of one half leads to dendrite k of neuron (i + k * step) mod half of
+// the other, so every dendrite is connected once. The weights come from drand48 (), hence
+// the same seed for each copy.
+
+static void build (NeuralNetwork & nn, size_t half, unsigned int degree)
+{
+  srand48 (1);
+
+  nn.generate_random_core_neurons (TanhNeuron::factory, 2 * half, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < 2 * half; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e;
+
+      e.source = i;
+      e.synapse = k;
+      e.target = (i < half ? half : 0) + (i % half + k * 7919) % half;
+      e.dendrite = k;
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < half; i += 3) nn.fire (nn.neuron (i));
+}
+
+static unsigned long int compare (NeuralNetwork & a, NeuralNetwork & b)
+{
+  unsigned long int differences = a.iterations () != b.iterations ();
+
+  for (NeuronVector::size_type i = 0; i < a.neurons_count (); i++)
+    differences += static_cast<TanhNeuron *> (a.neuron (i))->get_state () != static_cast<TanhNeuron *> (b.neuron (i))->get_state ();
+
+  return differences;
+}
+
+int main (int argc, char** argv)
+{
+  size_t half = (argc > 1 ? strtoul (argv[1], 0, 10) : 20000) / 2;
+  unsigned int degree = argc > 2 ? strtoul (argv[2], 0, 10) : 8;
+  unsigned long int n_iterations = argc > 3 ? strtoul (argv[3], 0, 10) : 30;
+  const char * filename = argc > 4 ? argv[4] : "spmv_backend.blocks";
+
+  if (half == 0 or degree == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [degree [iterations [block file]]]]\n";
+    return 1;
+  }
+
+  NeuralNetwork reference, in_memory, out_of_core;
+
+  build (reference, half, degree);
+  build (in_memory, half, degree);
+  build (out_of_core, half, degree);
+
+  for (unsigned long int i = 0; i < n_iterations and reference.is_firing (); i++) reference.run ();
+
+  SpmvBackend<TanhNeuron> backend (in_memory);
+
+  backend.run_n (n_iterations);
+
+  SpmvPaging paging = { filename, 1024, 4 };
+  SpmvBackend<TanhNeuron> paged (out_of_core, nn_spmv_weight<double>, 0, &paging);
+
+  paged.release_dendrites ();
+  paged.run_n (n_iterations);
+
+  if (not backend.is_valid () or not paged.is_valid ())
+  {
+    std::cerr << "The backend can't run the network\n";
+    return 1;
+  }
+
+  unsigned long int errors = compare (reference, in_memory) + compare (reference, out_of_core);
+
+  std::cout << reference.iterations () << " iterations of " << 2 * half << " neurons, " << backend.n_weights () << " weights, "
+            << paged.blocks_read () << " blocks read, " << errors << " differences\n";
+
+  remove (filename);
+
+  return errors != 0;
+}
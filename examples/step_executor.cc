@@ -0,0 +1,252 @@
+/* step_executor.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks StepExecutor and NeuralNetwork::step (). A number of networks of the same size but
+ * different initial weights, every third one using the gather-apply-scatter engine and every
+ * third the pipelined mode, are submitted to an executor which advances them a small chunk of
+ * neurons at a time on a few threads. Each has to end up with the same status, iteration and
+ * states as its copy run with run (). One more network is submitted to run for good and
+ * cancelled once the others are done; after run () completes the iteration it may have been
+ * left in, it has to be in the same states as its copy run as many iterations. Last, a network
+ * switched to the gather-apply-scatter engine in the middle of an iteration has to finish the
+ * iteration as it began it, coming out the same as its copy switched after the iteration.
+ *
+ * Usage: step_executor [networks [neurons [iterations [threads [chunk]]]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <future>
+#include "libnn.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state -= 0.01 * neuron_state * input;
+
+      return fabs (input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return neuron_state * state; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+static const unsigned int degree = 4;
+
+// Synapse k of neuron i leads to dendrite k of neuron (i + k * 7919 + 1) mod n. The weights
+// come from drand48 (), hence the same seed for both copies of a network.
+
+static void build (NeuralNetwork & nn, size_t n, long int seed)
+{
+  srand48 (seed);
+
+  nn.generate_random_core_neurons (TanhNeuron::factory, n, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i += 5) nn.fire (nn.neuron (i));
+
+  nn.set_gather_apply_scatter (seed % 3 == 1);
+  nn.set_pipelined (seed % 3 == 2);
+}
+
+static RunStatus run (NeuralNetwork & nn, unsigned long int n_iterations)
+{
+  for (unsigned long int i = 0; i < n_iterations; i++)
+  {
+    nn.run ();
+
+    if (not nn.is_firing ()) return RUN_QUIESCENT;
+  }
+
+  return RUN_MAX_ITERATIONS;
+}
+
+static unsigned long int differences (NeuralNetwork & a, NeuralNetwork & b)
+{
+  unsigned long int errors = a.iterations () != b.iterations ();
+
+  for (size_t i = 0; i < a.neurons_count (); i++)
+  {
+    TanhNeuron * na = static_cast<TanhNeuron *> (a.neuron (i));
+    TanhNeuron * nb = static_cast<TanhNeuron *> (b.neuron (i));
+    TanhNeuron::DendriteIterator da = na->get_dendrites ();
+    TanhNeuron::DendriteIterator db = nb->get_dendrites ();
+
+    errors += na->get_state () != nb->get_state ();
+
+    for (unsigned int k = 0; k < degree; k++) errors += da[k].get_state () != db[k].get_state ();
+  }
+
+  return errors;
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_networks = argc > 1 ? strtoul (argv[1], 0, 10) : 9;
+  size_t n_neurons = argc > 2 ? strtoul (argv[2], 0, 10) : 5000;
+  unsigned long int n_iterations = argc > 3 ? strtoul (argv[3], 0, 10) : 20;
+  unsigned int n_threads = argc > 4 ? strtoul (argv[4], 0, 10) : 3;
+  size_t chunk = argc > 5 ? strtoul (argv[5], 0, 10) : 500;
+
+  if (n_networks == 0 or n_neurons == 0 or n_threads == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [networks [neurons [iterations [threads [chunk]]]]]\n";
+    return 1;
+  }
+
+  std::vector<NeuralNetwork> stepped (n_networks + 1), run_whole (n_networks + 1);
+  std::vector<std::future<RunStatus> > results;
+  StepExecutor executor (n_threads, chunk);
+
+  for (size_t i = 0; i <= n_networks; i++)
+  {
+    build (stepped[i], n_neurons, i + 1);
+    build (run_whole[i], n_neurons, i + 1);
+  }
+
+  for (size_t i = 0; i < n_networks; i++) results.push_back (stepped[i].step_async (executor, n_iterations));
+
+  std::future<RunStatus> endless = stepped[n_networks].step_async (executor, (unsigned long int)-1);
+
+  unsigned long int errors = 0, quiescent = 0;
+
+  for (size_t i = 0; i < n_networks; i++)
+  {
+    RunStatus status = results[i].get ();
+
+    errors += status != run (run_whole[i], n_iterations);
+    errors += differences (stepped[i], run_whole[i]);
+
+    quiescent += status == RUN_QUIESCENT;
+  }
+
+  executor.cancel (stepped[n_networks]);
+
+  RunStatus status = endless.get ();
+
+  errors += status != RUN_CANCELLED and status != RUN_QUIESCENT;
+  errors += executor.pending () != 0;
+
+  NeuralNetwork & cancelled = stepped[n_networks];
+
+  cancelled.run ();
+  run (run_whole[n_networks], cancelled.iterations ());
+
+  errors += differences (cancelled, run_whole[n_networks]);
+
+  NeuralNetwork switched, reference;
+
+  build (switched, n_neurons, 3);
+  build (reference, n_neurons, 3);
+
+  switched.step (chunk);
+  switched.set_gather_apply_scatter (true);
+  switched.run ();
+
+  reference.run ();
+  reference.set_gather_apply_scatter (true);
+
+  run (switched, n_iterations);
+  run (reference, n_iterations);
+
+  errors += differences (switched, reference);
+
+  std::cout << n_networks << " networks, " << quiescent << " quiescent, cancelled after " << cancelled.iterations ()
+            << " iterations, " << errors << " differences\n";
+
+  return errors != 0;
+}
@@ -0,0 +1,323 @@
+/* stimulus_injection.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks NeuralNetwork::inject () against fire () and the plain run ().
+ *
+ * First a few producer threads inject stimuli into one network while another thread runs it,
+ * each producer from its own small pool, and every stimulus has to come back to its pool.
+ * So do the stimuli injected into a network destroyed before taking them.
+ * Then the producers inject the same stimuli into two networks before they run: one is run
+ * with run (), the other through SpmvBackend, and both have to end up in the same states as
+ * a third network given the stimuli through get_state () and fire () directly.
+ *
+ * The network has two halves, each feeding the other. States are injected into the first
+ * half and recomputations into the second, so the frontier never holds a neuron together
+ * with one feeding it and the order in which the producers' stimuli arrive doesn't matter.
+ *
+ * Usage: stimulus_injection [neurons [producers [stimuli per producer [iterations]]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "libnn.h"
+#include "SpmvBackend.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return 0.0; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double sum;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+static const unsigned int degree = 4;
+
+static void build (NeuralNetwork & nn, size_t half)
+{
+  srand48 (1);
+
+  nn.generate_random_core_neurons (TanhNeuron::factory, 2 * half, degree, degree, degree, degree);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < 2 * half; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e;
+
+      e.source = i;
+      e.synapse = k;
+      e.target = (i < half ? half : 0) + (i % half + k * 7919) % half;
+      e.dendrite = k;
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+}
+
+// The j-th stimulus of producer p: even ones set the state of a neuron of the first half,
+// odd ones queue a neuron of the second half. Each producer has its own neurons.
+
+static size_t stimulus_neuron (size_t half, unsigned int n_producers, unsigned int p, size_t j)
+{
+  return (j % 2 ? half : 0) + (j / 2 * n_producers + p) % half;
+}
+
+static double stimulus_state (unsigned int p, size_t j)
+{
+  return sin ((double)(p * 7919 + j));
+}
+
+// Inject the producer's stimuli into the networks, waiting for the pool whenever all its
+// stimuli are in flight. Counts the producer in done at the end.
+
+static void produce (std::vector<NeuralNetwork *> networks, StimulusPool * pool, size_t half, unsigned int n_producers,
+                     unsigned int p, size_t n_stimuli, std::atomic<unsigned int> * done)
+{
+  for (size_t j = 0; j < n_stimuli; j++)
+  {
+    size_t i = stimulus_neuron (half, n_producers, p, j);
+
+    for (size_t k = 0; k < networks.size (); k++)
+    {
+      NeuralNetwork & nn = *networks[k];
+
+      while (not (j % 2 ? nn.inject (*pool, i) : nn.inject<TanhNeuron> (*pool, i, stimulus_state (p, j))))
+        std::this_thread::yield ();
+    }
+  }
+
+  done->fetch_add (1);
+}
+
+static size_t free_stimuli (StimulusPool & pool)
+{
+  std::vector<Stimulus *> taken;
+
+  for (Stimulus * s; (s = pool.get ()) != 0;) taken.push_back (s);
+  for (size_t i = 0; i < taken.size (); i++) pool.put (taken[i]);
+
+  return taken.size ();
+}
+
+static unsigned long int compare (NeuralNetwork & a, NeuralNetwork & b)
+{
+  unsigned long int differences = a.iterations () != b.iterations ();
+
+  for (NeuronVector::size_type i = 0; i < a.neurons_count (); i++)
+    differences += static_cast<TanhNeuron *> (a.neuron (i))->get_state () != static_cast<TanhNeuron *> (b.neuron (i))->get_state ();
+
+  return differences;
+}
+
+int main (int argc, char** argv)
+{
+  size_t half = (argc > 1 ? strtoul (argv[1], 0, 10) : 20000) / 2;
+  unsigned int n_producers = argc > 2 ? strtoul (argv[2], 0, 10) : 4;
+  size_t n_stimuli = argc > 3 ? strtoul (argv[3], 0, 10) : 2000;
+  unsigned long int n_iterations = argc > 4 ? strtoul (argv[4], 0, 10) : 20;
+
+  if (half == 0 or n_producers == 0 or n_stimuli / 2 * n_producers > half)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [producers [stimuli per producer [iterations]]]]\n"
+              << "Each half of the network must have a neuron for every other stimulus.\n";
+    return 1;
+  }
+
+  // The pools are declared first, so that they outlive the networks holding their stimuli.
+
+  std::vector<StimulusPool *> small_pools, pools;
+
+  for (unsigned int p = 0; p < n_producers; p++)
+  {
+    small_pools.push_back (new StimulusPool (16));
+    pools.push_back (new StimulusPool (2 * n_stimuli));
+  }
+
+  unsigned long int errors = 0;
+
+  {
+    // Concurrent injection from small pools, which only the running network refills.
+
+    NeuralNetwork running;
+    std::vector<std::thread> producers;
+    std::atomic<unsigned int> producers_done (0);
+
+    build (running, half);
+
+    for (unsigned int p = 0; p < n_producers; p++)
+      producers.push_back (std::thread (produce, std::vector<NeuralNetwork *> (1, &running), small_pools[p], half, n_producers, p,
+                                        n_stimuli, &producers_done));
+
+    while (producers_done.load () < n_producers) running.run ();
+
+    for (unsigned int p = 0; p < n_producers; p++) producers[p].join ();
+
+    // A stimulus is taken at the latest by the iteration after the next one. Then all of
+    // them have to be back in their pools.
+
+    running.run ();
+    running.run ();
+
+    for (unsigned int p = 0; p < n_producers; p++) errors += free_stimuli (*small_pools[p]) != small_pools[p]->size ();
+
+    std::cout << "Concurrent injection: " << n_producers * n_stimuli << " stimuli taken in " << running.iterations () << " iterations\n";
+  }
+
+  {
+    // Stimuli still queued when the network is destroyed go back to their pools.
+
+    size_t queued = 0;
+
+    {
+      NeuralNetwork abandoned;
+
+      build (abandoned, half);
+
+      for (unsigned int p = 0; p < n_producers; p++)
+        for (size_t j = 0; j < small_pools[p]->size (); j++) queued += abandoned.inject (*small_pools[p], j);
+    }
+
+    for (unsigned int p = 0; p < n_producers; p++) errors += free_stimuli (*small_pools[p]) != small_pools[p]->size ();
+
+    std::cout << "Destroyed with stimuli queued: " << queued << " stimuli given back\n";
+  }
+
+  {
+    // The same stimuli, injected before running, and given to the reference directly.
+
+    NeuralNetwork reference, injected, backend_injected;
+
+    build (reference, half);
+    build (injected, half);
+    build (backend_injected, half);
+
+    std::vector<NeuralNetwork *> networks;
+    std::vector<std::thread> producers;
+    std::atomic<unsigned int> producers_done (0);
+
+    networks.push_back (&injected);
+    networks.push_back (&backend_injected);
+
+    for (unsigned int p = 0; p < n_producers; p++)
+      producers.push_back (std::thread (produce, networks, pools[p], half, n_producers, p, n_stimuli, &producers_done));
+
+    for (unsigned int p = 0; p < n_producers; p++) producers[p].join ();
+
+    for (unsigned int p = 0; p < n_producers; p++)
+    {
+      for (size_t j = 0; j < n_stimuli; j++)
+      {
+        NeuronBase * n = reference.neuron (stimulus_neuron (half, n_producers, p, j));
+
+        if (j % 2)
+        {
+          reference.fire (n);
+          continue;
+        }
+
+        static_cast<TanhNeuron *> (n)->get_state () = stimulus_state (p, j);
+
+        for (Connector::size_type k = 0; k < n->n_synapses (); k++) reference.fire (const_cast<NeuronBase *> (n->synapse_target (k)));
+      }
+    }
+
+    for (unsigned long int i = 0; i < n_iterations and reference.is_firing (); i++) reference.run ();
+    for (unsigned long int i = 0; i < n_iterations and injected.is_firing (); i++) injected.run ();
+
+    SpmvBackend<TanhNeuron> backend (backend_injected);
+
+    backend.run_n (n_iterations);
+
+    errors += compare (reference, injected) + compare (reference, backend_injected);
+
+    for (unsigned int p = 0; p < n_producers; p++) errors += free_stimuli (*pools[p]) != pools[p]->size ();
+
+    std::cout << "Injected before running: " << reference.iterations () << " iterations, " << errors << " differences\n";
+  }
+
+  for (unsigned int p = 0; p < n_producers; p++)
+  {
+    delete small_pools[p];
+    delete pools[p];
+  }
+
+  return errors != 0;
+}
@@ -0,0 +1,318 @@
+/* terminal_sinks.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks TerminalNeuron, RecordSink and FrameSink. Half of the terminal neurons report to a
+ * small RecordSink and the other half to a FrameSink of a few frames, both drained by a
+ * consumer thread while another thread runs the network. A second network of the same
+ * topology and initial weights, whose terminal neurons report to sinks simply keeping
+ * everything, is run the same way. The records and frames the consumer got have to come in
+ * the same order and with the same values as those kept by the second network, and together
+ * with the ones dropped when the rings were full they have to add up to all of them.
+ *
+ * Usage: terminal_sinks [neurons [terminal neurons [iterations]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "libnn.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state -= 0.01 * neuron_state * input;
+
+      return fabs (input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return neuron_state * state; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+typedef Neuron<TanhFunctor> CoreNeuron;
+typedef TerminalNeuron<TanhFunctor> OutputNeuron;
+typedef OutputRecord<double> Record;
+
+static const unsigned int degree = 4;
+static const size_t ring_records = 64;
+static const size_t ring_frames = 4;
+
+// Sink keeping every record and every frame, as RecordSink and FrameSink would produce them
+// if their rings never filled up.
+
+class KeepingSink : public OutputSink<double>
+{
+  public:
+
+    KeepingSink () : iteration (0), changed (false) {}
+
+    virtual size_t add_slot ()
+    {
+      working.push_back (0.0);
+
+      return OutputSink<double>::add_slot ();
+    }
+
+    virtual void begin_iteration (unsigned long int i) { iteration = i; }
+
+    virtual void emit (size_t slot, nn_id_t neuron_id, const double & value)
+    {
+      Record r = { neuron_id, iteration, value };
+
+      records.push_back (r);
+      working[slot] = value;
+      changed = true;
+    }
+
+    virtual void end_iteration ()
+    {
+      if (not changed) return;
+
+      changed = false;
+      frames.insert (frames.end (), working.begin (), working.end ());
+      frame_iterations.push_back (iteration);
+    }
+
+    std::vector<Record> records;
+    std::vector<double> frames;
+    std::vector<unsigned long int> frame_iterations;
+
+  private:
+
+    std::vector<double> working;
+    unsigned long int iteration;
+    bool changed;
+};
+
+// Drains both sinks until told to stop and there is nothing more to be read.
+
+static void consume (RecordSink<double> * record_sink, FrameSink<double> * frame_sink, size_t n_slots,
+                     KeepingSink * got, std::atomic<bool> * stop)
+{
+  Record chunk[16];
+
+  for (;;)
+  {
+    bool stopping = stop->load ();
+    size_t k = record_sink->drain (chunk, 16);
+    unsigned long int i;
+    const double * frame = frame_sink->front (i);
+
+    got->records.insert (got->records.end (), chunk, chunk + k);
+
+    if (frame)
+    {
+      got->frames.insert (got->frames.end (), frame, frame + n_slots);
+      got->frame_iterations.push_back (i);
+      frame_sink->pop ();
+    }
+
+    if (k == 0 and frame == 0)
+    {
+      if (stopping) break;
+
+      std::this_thread::yield ();
+    }
+  }
+}
+
+// Number of the records got by the consumer which aren't found in the same order among
+// those kept.
+
+static unsigned long int missing_records (const std::vector<Record> & got, const std::vector<Record> & kept)
+{
+  size_t j = 0;
+
+  for (size_t i = 0; i < got.size (); i++)
+  {
+    while (j < kept.size () and (kept[j].neuron_id != got[i].neuron_id or kept[j].iteration != got[i].iteration or
+                                 kept[j].value != got[i].value)) j++;
+
+    if (j == kept.size ()) return got.size () - i;
+
+    j++;
+  }
+
+  return 0;
+}
+
+static unsigned long int missing_frames (const KeepingSink & got, const KeepingSink & kept, size_t n_slots)
+{
+  size_t j = 0;
+
+  for (size_t i = 0; i < got.frame_iterations.size (); i++)
+  {
+    while (j < kept.frame_iterations.size () and kept.frame_iterations[j] != got.frame_iterations[i]) j++;
+
+    if (j == kept.frame_iterations.size ()) return got.frame_iterations.size () - i;
+
+    for (size_t k = 0; k < n_slots; k++)
+      if (got.frames[i * n_slots + k] != kept.frames[j * n_slots + k]) return got.frame_iterations.size () - i;
+
+    j++;
+  }
+
+  return 0;
+}
+
+// Core neurons come first. Synapse k of core neuron i leads to dendrite k of core neuron
+// (i + k * 7919 + 1) mod n, and the extra synapse of core neuron j * n / terminals to the only
+// dendrite of terminal neuron j. The weights come from drand48 (), hence the same seed.
+
+static void build (NeuralNetwork & nn, OutputSink<double> & records, OutputSink<double> & frames, size_t n, size_t n_terminals)
+{
+  OutputNeuron::Factory record_factory (records), frame_factory (frames);
+
+  srand48 (1);
+
+  nn.generate_random_core_neurons (CoreNeuron::factory, n, degree, degree, degree + 1, degree + 1);
+  nn.generate_random_terminal_neurons (record_factory, records, n_terminals / 2, 1, 1);
+  nn.generate_random_terminal_neurons (frame_factory, frames, n_terminals - n_terminals / 2, 1, 1);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  for (size_t j = 0; j < n_terminals; j++)
+  {
+    Edge e = { j * n / n_terminals, degree, n + j, 0 };
+
+    edges.push_back (e);
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i += 5) nn.fire (nn.neuron (i));
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 10000;
+  size_t n_terminals = argc > 2 ? strtoul (argv[2], 0, 10) : 100;
+  unsigned long int n_iterations = argc > 3 ? strtoul (argv[3], 0, 10) : 30;
+
+  if (n_neurons == 0 or n_terminals < 2 or n_terminals > n_neurons)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [terminal neurons [iterations]]]\n";
+    return 1;
+  }
+
+  RecordSink<double> record_sink (ring_records);
+  FrameSink<double> frame_sink (ring_frames);
+  KeepingSink kept_records, kept_frames, got;
+  NeuralNetwork running, keeping;
+
+  build (running, record_sink, frame_sink, n_neurons, n_terminals);
+  build (keeping, kept_records, kept_frames, n_neurons, n_terminals);
+
+  std::atomic<bool> stop (false);
+  std::thread consumer (consume, &record_sink, &frame_sink, frame_sink.slots (), &got, &stop);
+
+  for (unsigned long int i = 0; i < n_iterations and running.is_firing (); i++) running.run ();
+
+  stop.store (true);
+  consumer.join ();
+
+  for (unsigned long int i = 0; i < n_iterations and keeping.is_firing (); i++) keeping.run ();
+
+  unsigned long int errors = running.iterations () != keeping.iterations ();
+
+  errors += missing_records (got.records, kept_records.records);
+  errors += got.records.size () + record_sink.dropped () != kept_records.records.size ();
+  errors += missing_frames (got, kept_frames, frame_sink.slots ());
+  errors += got.frame_iterations.size () + frame_sink.dropped () != kept_frames.frame_iterations.size ();
+
+  std::cout << running.iterations () << " iterations, " << got.records.size () << " records and "
+            << got.frame_iterations.size () << " frames read, " << record_sink.dropped () << " and "
+            << frame_sink.dropped () << " dropped, " << errors << " differences\n";
+
+  return errors != 0;
+}
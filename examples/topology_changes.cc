@@ -0,0 +1,319 @@
+/* topology_changes.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks NeuralNetwork::schedule_connect () and schedule_disconnect () against changing the
+ * topology directly. Two copies of a network are run with the plain run (). Between the
+ * iterations a batch of random changes is made to one of them right away, through connect ()
+ * and disconnect_synapse (), firing the neurons whose dendrites changed, while another thread
+ * schedules the same changes for the other copy, which applies them when its next iteration
+ * begins. Some changes add new synapses and dendrites (TopologyChange::NEW). Both copies have
+ * to go through the same states. The scheduling thread takes the changes from a pool just
+ * large enough for one batch, which has to refuse any more until the network gives all of
+ * them back.
+ *
+ * Usage: topology_changes [neurons [degree [iterations [changes per iteration]]]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include <thread>
+#include <vector>
+#include "libnn.h"
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = 0.25; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return 0.0; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return false; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return 0.0; }
+};
+
+class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (sum + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return false; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) {}
+
+  private:
+
+    double sum;
+};
+
+typedef Neuron<TanhFunctor> TanhNeuron;
+
+// Every neuron gets one dendrite and one synapse more than it needs initially, left free for
+// the changes. Synapse k of neuron i leads to dendrite k of neuron (i + k * step) mod n.
+
+static void build (NeuralNetwork & nn, size_t n, unsigned int degree)
+{
+  nn.generate_random_core_neurons (TanhNeuron::factory, n, degree + 1, degree + 1, degree + 1, degree + 1);
+
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      Edge e = { i, k, (i + k * 7919 + 1) % n, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < n; i++)
+  {
+    TanhNeuron::DendriteIterator d = static_cast<TanhNeuron *> (nn.neuron (i))->get_dendrites ();
+
+    for (unsigned int k = 0; k < degree; k++) d[k].get_state () = sin (i * 0.37 + k * 1.3);
+  }
+
+  for (size_t i = 0; i < n; i += 5) nn.fire (nn.neuron (i));
+}
+
+struct Change
+{
+    bool connect;
+    Edge edge; // synapse or dendrite TopologyChange::NEW to add one
+};
+
+// Linear congruential generator, so that the changes don't depend on the C library.
+
+static size_t next_random (unsigned long int & seed, size_t n)
+{
+  seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+
+  return (seed >> 33) % n;
+}
+
+static Connector::size_type free_synapse (const NeuronBase * n)
+{
+  for (Connector::size_type k = 0; k < n->n_synapses (); k++)
+    if (not n->is_synapse_connected (k)) return k;
+
+  return TopologyChange::NEW;
+}
+
+static Connector::size_type free_dendrite (const NeuronBase * n)
+{
+  for (Connector::size_type k = 0; k < n->n_dendrites (); k++)
+    if (not n->is_dendrite_connected (k)) return k;
+
+  return TopologyChange::NEW;
+}
+
+// Make the change to the network the way apply_topology_change () does it.
+
+static void apply (NeuralNetwork & nn, const Change & c)
+{
+  NeuronBase * source = nn.neuron (c.edge.source);
+
+  if (not c.connect)
+  {
+    NeuronBase * target = const_cast<NeuronBase *> (source->synapse_target (c.edge.synapse));
+
+    source->disconnect_synapse (c.edge.synapse);
+    nn.fire (target);
+
+    return;
+  }
+
+  NeuronBase * target = nn.neuron (c.edge.target);
+  Edge e = c.edge;
+
+  if (e.synapse == TopologyChange::NEW)
+  {
+    e.synapse = source->n_synapses ();
+    source->add_synapse ();
+  }
+
+  if (e.dendrite == TopologyChange::NEW)
+  {
+    e.dendrite = target->n_dendrites ();
+    target->add_dendrite ();
+  }
+
+  nn.connect (&e, 1);
+  nn.fire (target);
+}
+
+// Pick the changes against the network changed directly, making them on the way, so that
+// each one sees the effect of the previous ones.
+
+static std::vector<Change> make_changes (NeuralNetwork & nn, size_t n_changes, unsigned long int & seed)
+{
+  std::vector<Change> changes;
+
+  while (changes.size () < n_changes)
+  {
+    Change c;
+
+    c.edge.source = next_random (seed, nn.neurons_count ());
+    c.connect = next_random (seed, 2);
+
+    NeuronBase * source = nn.neuron (c.edge.source);
+
+    if (not c.connect)
+    {
+      c.edge.synapse = next_random (seed, source->n_synapses ());
+      c.edge.target = c.edge.dendrite = 0;
+
+      if (not source->is_synapse_connected (c.edge.synapse)) continue;
+    }
+    else
+    {
+      c.edge.target = next_random (seed, nn.neurons_count ());
+
+      NeuronBase * target = nn.neuron (c.edge.target);
+
+      c.edge.synapse = free_synapse (source);
+      c.edge.dendrite = next_random (seed, 4) ? free_dendrite (target) : TopologyChange::NEW;
+    }
+
+    apply (nn, c);
+    changes.push_back (c);
+  }
+
+  return changes;
+}
+
+// Schedule the changes, counting those the pool had no room for in refused.
+
+static void schedule (NeuralNetwork * nn, TopologyChangePool * pool, const std::vector<Change> * changes, size_t * refused)
+{
+  for (size_t i = 0; i < changes->size (); i++)
+  {
+    const Edge & e = (*changes)[i].edge;
+
+    if (not ((*changes)[i].connect ? nn->schedule_connect (*pool, e.source, e.synapse, e.target, e.dendrite)
+                                   : nn->schedule_disconnect (*pool, e.source, e.synapse))) (*refused)++;
+  }
+}
+
+static size_t free_changes (TopologyChangePool & pool)
+{
+  std::vector<TopologyChange *> taken;
+
+  for (TopologyChange * c; (c = pool.get ()) != 0;) taken.push_back (c);
+  for (size_t i = 0; i < taken.size (); i++) pool.put (taken[i]);
+
+  return taken.size ();
+}
+
+static unsigned long int compare (NeuralNetwork & a, NeuralNetwork & b)
+{
+  unsigned long int differences = a.iterations () != b.iterations () or a.neurons_firing_count () != b.neurons_firing_count ();
+
+  for (NeuronVector::size_type i = 0; i < a.neurons_count (); i++)
+  {
+    differences += static_cast<TanhNeuron *> (a.neuron (i))->get_state () != static_cast<TanhNeuron *> (b.neuron (i))->get_state ();
+    differences += a.neuron (i)->n_dendrites () != b.neuron (i)->n_dendrites ();
+    differences += a.neuron (i)->n_synapses () != b.neuron (i)->n_synapses ();
+  }
+
+  return differences;
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 10000;
+  unsigned int degree = argc > 2 ? strtoul (argv[2], 0, 10) : 4;
+  unsigned long int n_iterations = argc > 3 ? strtoul (argv[3], 0, 10) : 30;
+  size_t n_changes = argc > 4 ? strtoul (argv[4], 0, 10) : 50;
+
+  if (n_neurons < 2 or degree == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [degree [iterations [changes per iteration]]]]\n";
+    return 1;
+  }
+
+  // The pool is declared first, so that it outlives the network holding its changes.
+
+  TopologyChangePool pool (n_changes);
+  NeuralNetwork direct, scheduled;
+
+  build (direct, n_neurons, degree);
+  build (scheduled, n_neurons, degree);
+
+  unsigned long int seed = 1, errors = 0;
+
+  for (unsigned long int i = 0; i < n_iterations; i++)
+  {
+    std::vector<Change> changes = make_changes (direct, n_changes, seed);
+    size_t refused = 0;
+    std::thread scheduler (schedule, &scheduled, &pool, &changes, &refused);
+
+    scheduler.join ();
+
+    errors += refused != 0 or scheduled.schedule_disconnect (pool, 0, 0);
+
+    direct.run ();
+    scheduled.run ();
+
+    errors += compare (direct, scheduled) + (free_changes (pool) != pool.size ());
+  }
+
+  std::cout << n_iterations << " iterations with " << n_changes << " changes each, topology epoch " << scheduled.topology_epoch ()
+            << ", " << errors << " differences\n";
+
+  return errors != 0;
+}
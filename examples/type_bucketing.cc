@@ -0,0 +1,243 @@
+/* type_bucketing.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Checks type bucketing. The networks mix three neuron classes, taking turns. A recurrent
+ * network learning as it runs is run with type bucketing, once with the runners of all three
+ * classes registered and once without, and all the neuron and dendrite states have to come
+ * out the same. Since bucketing changes the order in which neurons read each other, it is
+ * checked against the plain run () on a layered network without backpropagation, where every
+ * iteration recomputes a single layer whose neurons don't read each other.
+ *
+ * Usage: type_bucketing [neurons [iterations]]
+ */
+
+
+#include <iostream>
+#include <stdlib.h>
+#include <math.h>
+#include "libnn.h"
+
+static bool backpropagating = true;
+
+class WeightDendriteFunctor : public DendriteFunctor<double, double, double>
+{
+  public:
+    WeightDendriteFunctor () : input (0.0) {}
+
+    virtual void init_state (DendriteStateType & state) const { state = drand48 () * 2.0 - 1.0; }
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      input = signal;
+
+      return true;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      state -= 0.01 * neuron_state * input;
+
+      return fabs (input) > 0.5;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return input * state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const { return neuron_state * state; }
+
+  private:
+
+    SignalType input;
+};
+
+class StateSynapseFunctor : public SynapseFunctor<double, double>
+{
+  public:
+
+    virtual bool process_output (const NeuronStateType & neuron_state) { return true; }
+    virtual bool process_feedback (const NeuronStateType & neuron_state, SignalType signal) { return signal != 0.0; }
+    virtual SignalType propagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state) const { return neuron_state; }
+};
+
+// Gain is in halves.
+
+template <int Gain> class TanhFunctor : public NeuronFunctor<WeightDendriteFunctor, double, StateSynapseFunctor>
+{
+  public:
+
+    TanhFunctor () : sum (0.0), feedback (0.0) {}
+
+    virtual bool propagate (NeuronStateType & neuron_state)
+    {
+      double s = tanh (Gain * sum / 2.0 + 0.1);
+      bool changed = fabs (s - neuron_state) > 1e-6;
+
+      neuron_state = s;
+
+      return changed;
+    }
+
+    virtual bool backpropagate (NeuronStateType & neuron_state)
+    {
+      neuron_state = tanh (neuron_state - 0.05 * feedback);
+
+      return fabs (feedback) > 0.5;
+    }
+
+    virtual bool should_backpropagate (NeuronStateType & neuron_state) { return backpropagating and fabs (neuron_state) > 0.6; }
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) { sum += signal; }
+    virtual void process_feedback (size_type synapse_idx, SynapseSignalType signal) { feedback += signal; }
+
+  private:
+
+    double sum;
+    double feedback;
+};
+
+static const unsigned int degree = 4;
+static const size_t layers = 8;
+
+typedef Neuron<TanhFunctor<2> > FreeNeuron;
+typedef FixedNeuron<TanhFunctor<2>, degree, degree> FourNeuron;
+typedef Neuron<TanhFunctor<1> > GentleNeuron;
+
+static NeuronFactoryBase * factories[] = { &FreeNeuron::factory, &FourNeuron::factory, &GentleNeuron::factory };
+
+// Neuron i is of class i mod 3. In the recurrent network synapse k of neuron i leads to
+// dendrite k of neuron (i + k * 7919 + 1) mod n, and every fifth neuron is fired. In the
+// layered one it leads to dendrite k of the neuron at the same offset in the next layer,
+// and the first layer is fired. The weights come from drand48 (), hence the same seed.
+
+static void build (NeuralNetwork & nn, size_t n, bool layered)
+{
+  srand48 (1);
+
+  for (size_t i = 0; i < n; i++) nn.create_neuron (*factories[i % 3], degree, degree);
+
+  size_t width = layered ? n / layers : n;
+  std::vector<Edge> edges;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t first = i - i % width;
+
+    if (first + width == n and layered) break;
+
+    for (unsigned int k = 0; k < degree; k++)
+    {
+      size_t next = layered ? first + width : 0;
+      Edge e = { i, k, next + (i - first + k * 7919 + 1) % width, k };
+
+      edges.push_back (e);
+    }
+  }
+
+  nn.connect (&edges[0], edges.size ());
+
+  for (size_t i = 0; i < (layered ? width : n); i += layered ? 1 : 5) nn.fire (nn.neuron (i));
+}
+
+static void register_runners (NeuralNetwork & nn)
+{
+  nn.set_type_bucketing (true);
+  nn.register_runners<FreeNeuron> ();
+  nn.register_runners<FourNeuron> ();
+  nn.register_runners<GentleNeuron> ();
+}
+
+static void run (NeuralNetwork & nn, unsigned long int n_iterations)
+{
+  for (unsigned long int i = 0; i < n_iterations and nn.is_firing (); i++) nn.run ();
+}
+
+template <class NeuronType> static unsigned long int differences (NeuralNetwork & a, NeuralNetwork & b, size_t i)
+{
+  NeuronType * x = static_cast<NeuronType *> (a.neuron (i));
+  NeuronType * y = static_cast<NeuronType *> (b.neuron (i));
+  unsigned long int errors = x->get_state () != y->get_state ();
+
+  for (unsigned int k = 0; k < degree; k++) errors += x->get_dendrites ()[k].get_state () != y->get_dendrites ()[k].get_state ();
+
+  return errors;
+}
+
+static unsigned long int differences (NeuralNetwork & a, NeuralNetwork & b)
+{
+  unsigned long int errors = a.iterations () != b.iterations () or a.neurons_count () != b.neurons_count ();
+
+  for (size_t i = 0; i < a.neurons_count () and i < b.neurons_count (); i++)
+  {
+    switch (i % 3)
+    {
+      case 0: errors += differences<FreeNeuron> (a, b, i); break;
+      case 1: errors += differences<FourNeuron> (a, b, i); break;
+      default: errors += differences<GentleNeuron> (a, b, i);
+    }
+  }
+
+  return errors;
+}
+
+int main (int argc, char** argv)
+{
+  size_t n_neurons = argc > 1 ? strtoul (argv[1], 0, 10) : 12000;
+  unsigned long int n_iterations = argc > 2 ? strtoul (argv[2], 0, 10) : 30;
+
+  if (n_neurons < 2 * layers)
+  {
+    std::cerr << "Usage: " << argv[0] << " [neurons [iterations]]\n";
+    return 1;
+  }
+
+  // The recurrent network, bucketed with and without the runners.
+
+  NeuralNetwork bucketed, registered;
+
+  build (bucketed, n_neurons, false);
+  build (registered, n_neurons, false);
+
+  bucketed.set_type_bucketing (true);
+  register_runners (registered);
+
+  run (bucketed, n_iterations);
+  run (registered, n_iterations);
+
+  unsigned long int errors = differences (bucketed, registered);
+  unsigned long int recurrent_iterations = registered.iterations ();
+
+  // The layered network, plain and bucketed with the runners.
+
+  size_t n_layered = n_neurons - n_neurons % layers;
+  NeuralNetwork plain, layered;
+
+  backpropagating = false;
+
+  build (plain, n_layered, true);
+  build (layered, n_layered, true);
+
+  register_runners (layered);
+
+  run (plain, n_iterations);
+  run (layered, n_iterations);
+
+  errors += differences (plain, layered);
+
+  std::cout << recurrent_iterations << " and " << layered.iterations () << " iterations, " << errors << " differences\n";
+
+  return errors != 0;
+}
@@ -22,6 +22,19 @@
 #define CONNECTION_H_
 
 #include <vector>
+#include <sys/types.h>
+#include "nn_config.h"
+#include "SmallVector.h"
+
+
+// Type of the neurons' ids, which number all the neurons ever created. 32 bit ids keep the
+// neurons and the output records small; networks of more than 4G neurons need 64 bit ones,
+// selected by configure --enable-64bit-ids, which defines NN_64BIT_IDS in nn_config.h.
+#ifdef NN_64BIT_IDS
+typedef __uint64_t nn_id_t;
+#else
+typedef __uint32_t nn_id_t;
+#endif
 
 
 class NeuronBase;
@@ -56,6 +69,7 @@ class Connector
 
     bool is_connected () const { return neuron != 0; }
     bool is_connected (const NeuronBase * n) const { return neuron == n; }
+    bool is_connected (const NeuronBase * n, size_type i) const { return neuron == n and nth == i; }
 
   private:
 
@@ -69,24 +83,25 @@ class Connector
  * Class providing limited container access to Neuron's synapses and dendrites.
  * Allows for iterating over the entire range of the container as well as random
  * access, but shields the container from all the other operations (such as deletion
- * or insertion).
+ * or insertion). The container must not be resized while the iterator is in use.
  */
 
 template <class ConnectorType> class ConnectorIterator
 {
   public:
 
-    typedef std::vector<ConnectorType>    Container;
-    typedef typename Container::size_type size_type;
-    typedef typename Container::iterator  iterator;
+    typedef size_t          size_type;
+    typedef ConnectorType * iterator;
 
-    ConnectorIterator (Container & c) : container (c) { itr = container.begin (); }
+    template <size_t N> ConnectorIterator (SmallVector<ConnectorType, N> & c) : items (c.begin ()),
+                                                                               n_items (c.size ()),
+                                                                               itr (c.begin ()) {}
 
     ConnectorType * first ()
     {
-      itr = container.begin ();
+      itr = items;
 
-      if (itr == container.end ()) return null ();
+      if (itr == items + n_items) return null ();
 
       return &(*itr);
     }
@@ -95,21 +110,22 @@ template <class ConnectorType> class ConnectorIterator
     {
       itr++;
 
-      if (itr == container.end ()) return null ();
+      if (itr == items + n_items) return null ();
 
       return &(*itr);
     }
 
-    ConnectorType & operator [] (size_type i) { return container[i]; }
+    ConnectorType & operator [] (size_type i) { return items[i]; }
 
-    size_type numof () { return container.size (); }
+    size_type numof () { return n_items; }
 
     ConnectorType * null () { return 0; }
 
   private:
 
-    Container & container;
-    iterator    itr;
+    iterator  items;
+    size_type n_items;
+    iterator  itr;
 };
 
 
@@ -0,0 +1,168 @@
+/* CowArray.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef COWARRAY_H_
+#define COWARRAY_H_
+
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+
+// Size of the pages CowArray shares between its copies. Rounded down so that a page holds
+// a power of two elements.
+#ifndef NN_COW_PAGE_SIZE
+#define NN_COW_PAGE_SIZE 4096
+#endif
+
+
+/*
+ * Fixed size array whose copies share the memory until written to, page by page. Copying
+ * the array copies only its page table. Elements are read through operator [] and written
+ * through write (), which first copies the page if any other array still shares it, so each
+ * copy pays only for the pages it changed.
+ * Copies of an array may be used by different threads, each copy by one thread at a time.
+ * Each page counts the arrays sharing it. A copy releases its reference with release
+ * semantics after its last access to the page and write () checks the count with acquire
+ * semantics, so a page found unshared is not read by any other copy any more.
+ */
+template <class T> class CowArray
+{
+  public:
+
+    typedef size_t size_type;
+
+    CowArray () : n_items (0) {}
+
+    CowArray (size_type n, const T & v) : n_items (n)
+    {
+      for (size_type i = 0; i < n; i += page_items)
+      {
+        pages.push_back (new_page ());
+        std::fill (pages.back ()->items, pages.back ()->items + page_items, v);
+      }
+    }
+
+    CowArray (const CowArray & a) : pages (a.pages), n_items (a.n_items) { share (); }
+
+    CowArray & operator = (const CowArray & a)
+    {
+      if (this != &a)
+      {
+        release ();
+        pages = a.pages;
+        n_items = a.n_items;
+        share ();
+      }
+
+      return *this;
+    }
+
+    ~CowArray () { release (); }
+
+    size_type size () const { return n_items; }
+
+    const T & operator [] (size_type i) const { return pages[i >> page_shift]->items[i & (page_items - 1)]; }
+
+    T & write (size_type i)
+    {
+      Page * & p = pages[i >> page_shift];
+
+      if (p->refs.load (std::memory_order_acquire) != 1)
+      {
+        Page * copy = new_page ();
+
+        std::copy (p->items, p->items + page_items, copy->items);
+        unref (p);
+        p = copy;
+      }
+
+      return p->items[i & (page_items - 1)];
+    }
+
+    size_type n_pages () const { return pages.size (); }
+
+    // Number of pages not shared with any other copy.
+    size_type private_pages () const
+    {
+      size_type n = 0;
+
+      for (size_type i = 0; i < pages.size (); i++) n += pages[i]->refs.load (std::memory_order_acquire) == 1;
+
+      return n;
+    }
+
+    static size_type page_bytes () { return page_items * sizeof (T); }
+
+  private:
+
+    struct Page
+    {
+        std::atomic<size_t> refs; // number of the arrays sharing the page
+        T * items;
+    };
+
+    static constexpr unsigned int shift_for (size_type n, unsigned int s = 0)
+    {
+      return n < ((size_type)2 << s) ? s : shift_for (n, s + 1);
+    }
+
+    static constexpr unsigned int page_shift = shift_for (NN_COW_PAGE_SIZE / sizeof (T) ? NN_COW_PAGE_SIZE / sizeof (T) : 1);
+    static constexpr size_type page_items = (size_type)1 << page_shift;
+
+    static Page * new_page ()
+    {
+      Page * p = new Page;
+
+      p->refs.store (1, std::memory_order_relaxed);
+      p->items = new T[page_items];
+
+      return p;
+    }
+
+    static void unref (Page * p)
+    {
+      if (p->refs.fetch_sub (1, std::memory_order_acq_rel) == 1)
+      {
+        delete [] p->items;
+        delete p;
+      }
+    }
+
+    void share ()
+    {
+      for (size_type i = 0; i < pages.size (); i++) pages[i]->refs.fetch_add (1, std::memory_order_relaxed);
+    }
+
+    void release ()
+    {
+      for (size_type i = 0; i < pages.size (); i++) unref (pages[i]);
+
+      pages.clear ();
+    }
+
+    std::vector<Page *> pages;
+    size_type n_items;
+};
+
+
+#endif /* COWARRAY_H_ */
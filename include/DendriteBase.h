@@ -47,7 +47,7 @@ template <class NeuronState, class Signal, class DendriteState> class DendriteFu
     virtual ~ DendriteFunctor () {}
 
     // Function to initialize the Dndrite's state within the Dendrite's constructor
-    virtual void init_state (NeuronStateType & state) const = 0;
+    virtual void init_state (DendriteStateType & state) const = 0;
 
     // Functor's main operation. Decides whether the dendrite should contribute to the recomputation
     // of the Neuron's state.
@@ -108,6 +108,14 @@ template <class Functor> class DendriteBase : public Connector
       return false;
     }
 
+    // Same as process_input (), with the signal of the source neuron already read.
+    virtual bool process_input_signal (const NeuronStateType & neuron_state, const SignalType & signal)
+    {
+      SignalType store = signal;
+
+      return functor.process_input (neuron_state, state, store);
+    }
+
     virtual bool process_feedback (const NeuronStateType & neuron_state)
     {
         return functor.process_feedback (neuron_state, state);
@@ -126,10 +134,95 @@ template <class Functor> class DendriteBase : public Connector
     virtual const DendriteStateType & get_state () const { return state; }
     virtual DendriteStateType & get_state () { return state; }
 
+    // Heap data of the functor, as reported by its size ().
+    unsigned long int functor_size () const { return const_cast<Functor &> (functor).size (); }
+
   private :
 
     Functor functor;
 
     DendriteStateType state;
 };
+
+
+
+/*
+ * Lightweight variant of DendriteBase. Instead of embedding its own copy of the functor
+ * every dendrite of a given type shares one static Functor instance, and there are no
+ * virtual methods, so the dendrite consists of the Connector and the DendriteStateType
+ * only. Since the functor is shared, any data the user needs to keep per dendrite (for
+ * instance the last computed result) must be declared as a part of DendriteStateType
+ * rather than as functor's fields. The functor may be called from several threads at once
+ * (pipelined backpropagation, StepExecutor, Ensemble), so it can't have fields at all, and
+ * the compiler checks that it adds none to DendriteFunctor.
+ * Used by neurons whose functor is derived from SharedNeuronFunctor template.
+ */
+
+template <class Functor> class SharedDendriteBase : public Connector
+{
+  public:
+
+    typedef typename Functor::NeuronStateType NeuronStateType;
+    typedef typename Functor::SignalType SignalType;
+    typedef typename Functor::DendriteStateType DendriteStateType;
+
+    static_assert (sizeof (Functor) == sizeof (DendriteFunctor<NeuronStateType, SignalType, DendriteStateType>),
+                   "shared dendrite functor keeping data");
+
+    SharedDendriteBase () : Connector () { functor.init_state (state); }
+    SharedDendriteBase (NeuronBase * n, size_type i) : Connector (n, i) { functor.init_state (state); }
+
+    bool process_input (const NeuronStateType & neuron_state)
+    {
+      if (is_connected ())
+      {
+        NeuronBase * source = get_neuron ();
+
+        SignalType store;
+
+        source->propagate (get_nth (), &store);
+
+        return functor.process_input (neuron_state, state, store);
+      }
+
+      return false;
+    }
+
+    bool process_input_signal (const NeuronStateType & neuron_state, const SignalType & signal)
+    {
+      SignalType store = signal;
+
+      return functor.process_input (neuron_state, state, store);
+    }
+
+    bool process_feedback (const NeuronStateType & neuron_state)
+    {
+        return functor.process_feedback (neuron_state, state);
+    }
+
+    SignalType propagate (const NeuronStateType & neuron_state) const
+    {
+      return functor.propagate (neuron_state, state);
+    }
+
+    void backpropagate (const NeuronStateType & neuron_state, SignalType * store) const
+    {
+      *store = functor.backpropagate (neuron_state, state);
+    }
+
+    const DendriteStateType & get_state () const { return state; }
+    DendriteStateType & get_state () { return state; }
+
+    // The shared functor doesn't belong to any particular dendrite.
+    unsigned long int functor_size () const { return 0; }
+
+    static Functor functor;
+
+  private :
+
+    DendriteStateType state;
+};
+
+template <class Functor> Functor SharedDendriteBase<Functor>::functor;
+
 #endif /* DENDRITE_H_ */
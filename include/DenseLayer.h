@@ -0,0 +1,420 @@
+/* DenseLayer.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef DENSELAYER_H_
+#define DENSELAYER_H_
+
+#include <new>
+#include <vector>
+#include <string.h>
+#include "libnn.h"
+
+
+// c (m x n) += a (m x k) * b (k x n), the matrices stored by rows, ld* being the distances
+// between their rows. Blocked kernel using the SIMD instructions of the target, defined
+// in the library for float and double.
+template <class T>
+void nn_gemm (size_t m, size_t n, size_t k, const T * a, size_t lda, const T * b, size_t ldb, T * c, size_t ldc);
+
+extern template void nn_gemm<float> (size_t, size_t, size_t, const float *, size_t, const float *, size_t, float *, size_t);
+extern template void nn_gemm<double> (size_t, size_t, size_t, const double *, size_t, const double *, size_t, double *, size_t);
+
+
+template <class NeuronFunctor> class DenseLayer;
+
+/*
+ * Propagator of DenseLayer. The recomputation computes the whole layer; the synapses
+ * of the outputs which fired are then visited.
+ */
+template <class NeuronFunctor> class DensePropagator : public PropagatorBase
+{
+  public:
+
+    DensePropagator (DenseLayer<NeuronFunctor> & l) : layer (l), cursor (0) {}
+    virtual ~DensePropagator () {}
+
+    virtual bool operator () () { return layer.forward (); }
+
+    virtual bool backpropagate () { return false; }
+    virtual bool should_backpropagate () { return false; }
+
+    virtual NeuronBase * first_synapse ()
+    {
+      cursor = 0;
+
+      return next_synapse ();
+    }
+
+    virtual NeuronBase * next_synapse ()
+    {
+      for (; cursor < layer.synapses.size (); cursor++)
+      {
+        size_t row = cursor % layer.n_outputs;
+        typename DenseLayer<NeuronFunctor>::SynapseType & s = layer.synapses[cursor];
+
+        if (layer.fired[row] and s.is_connected () and s.process_output (layer.states[row]))
+          return layer.synapses[cursor++].get_neuron ();
+      }
+
+      return 0;
+    }
+
+    virtual NeuronBase * first_dendrite () { return 0; }
+    virtual NeuronBase * next_dendrite () { return 0; }
+
+  private:
+
+    DenseLayer<NeuronFunctor> & layer;
+    size_t cursor;
+};
+
+
+
+/*
+ * Fully connected layer of neurons acting as a single node of the network. Dendrite i
+ * receives input i and the weights are kept in one contiguous matrix with a row for each
+ * input and a column for each output, so the whole layer is computed by a single matrix
+ * product instead of a virtual call per weight. Each output then goes through the same
+ * NeuronFunctor a free-form Neuron would use: the functor gets the output's weighted
+ * sum (plus bias) as the signal of dendrite 0 and its propagate () decides whether
+ * the output fires. Synapse s carries output s % n_outputs, so an output can be fanned out
+ * by adding synapses.
+ * The inputs' synapses must deliver DendriteSignalType, which has to be float or double.
+ * Layers don't take part in backpropagation; their weights are set through weight ()
+ * and bias ().
+ */
+template <class NeuronFunctor> class DenseLayer : public NeuronBase
+{
+  public:
+
+    friend class DensePropagator<NeuronFunctor>;
+
+    typedef typename NeuronFunctor::SynapseType         SynapseType;
+    typedef typename NeuronFunctor::NeuronStateType     NeuronState;
+    typedef typename NeuronFunctor::DendriteStateType   DendriteState;
+    typedef typename NeuronFunctor::DendriteSignalType  Scalar;
+    typedef typename SynapseType::SignalType            SynapseSignalType;
+    typedef DensePropagator<NeuronFunctor>              PropagatorType;
+
+    DenseLayer (unsigned int n_in, unsigned int n_out) : n_outputs (n_out ? n_out : 1),
+                                                         weights (n_in * n_outputs, Scalar ()),
+                                                         biases (n_outputs, Scalar ()),
+                                                         inputs (n_in, Scalar ()),
+                                                         sums (n_outputs, Scalar ()),
+                                                         states (n_outputs, NeuronState ()),
+                                                         fired (n_outputs, 0),
+                                                         dendrites (n_in),
+                                                         synapses (n_outputs)
+    {
+      set_type_tag (nn_type_tag<DenseLayer> ());
+    }
+
+    virtual ~DenseLayer () {}
+
+    size_t n_inputs () const { return dendrites.size (); }
+    size_t outputs () const { return n_outputs; }
+
+    Scalar & weight (size_t input, size_t output) { return weights[input * n_outputs + output]; }
+    Scalar & bias (size_t output) { return biases[output]; }
+    NeuronState & get_state (size_t output) { return states[output]; }
+
+    // Compute the layer from the current signals of its inputs. Returns true if any
+    // output fired.
+    bool forward ()
+    {
+      for (size_t i = 0; i < dendrites.size (); i++)
+      {
+        Connector & d = dendrites[i];
+
+        if (d.is_connected ()) d.get_neuron ()->propagate (d.get_nth (), &inputs[i]);
+        else inputs[i] = Scalar ();
+      }
+
+      sums = biases;
+
+      if (not inputs.empty ()) nn_gemm (1, n_outputs, inputs.size (), &inputs[0], inputs.size (), &weights[0], n_outputs, &sums[0], n_outputs);
+
+      bool any = false;
+
+      for (size_t j = 0; j < n_outputs; j++)
+      {
+        NeuronFunctor functor;
+
+        functor.process_input (0, DendriteState (), sums[j]);
+
+        fired[j] = functor.propagate (states[j]);
+        any = any or fired[j];
+      }
+
+      return any;
+    }
+
+    // Apply the layer to a batch of input vectors, stored by rows, outside of the network.
+    // Outputs' states are computed from out's initial values, the layer's own states are
+    // left intact.
+    void forward_batch (const Scalar * in, size_t batch, NeuronState * out)
+    {
+      std::vector<Scalar> z (batch * n_outputs);
+
+      for (size_t b = 0; b < batch; b++) std::copy (biases.begin (), biases.end (), z.begin () + b * n_outputs);
+
+      nn_gemm (batch, n_outputs, inputs.size (), in, inputs.size (), &weights[0], n_outputs, &z[0], n_outputs);
+
+      for (size_t k = 0; k < batch * n_outputs; k++)
+      {
+        NeuronFunctor functor;
+
+        functor.process_input (0, DendriteState (), z[k]);
+        functor.propagate (out[k]);
+      }
+    }
+
+    virtual Connector::size_type n_synapses () const { return synapses.size (); }
+    virtual Connector::size_type n_dendrites () const { return dendrites.size (); }
+
+    // The number of inputs is fixed by the weight matrix.
+    virtual void add_dendrite () {}
+    virtual void add_synapse () { synapses.push_back (SynapseType ()); }
+
+    unsigned long int size ()
+    {
+      return sizeof (DenseLayer) + dendrites.allocated () + synapses.allocated () +
+             (weights.capacity () + biases.capacity () + inputs.capacity () + sums.capacity ()) * sizeof (Scalar) +
+             states.capacity () * sizeof (NeuronState) + fired.capacity ();
+    }
+
+  protected:
+
+    void connect_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
+    {
+      nn_connect_synapse (this, synapses, nth_synapse, n, kth_dendrite);
+    }
+
+    void connect_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse)
+    {
+      nn_connect_dendrite (this, dendrites, kth_dendrite, n, nth_synapse);
+    }
+
+    void disconnect_synapse (Connector::size_type nth_synapse) { nn_disconnect_synapse (synapses, nth_synapse); }
+
+    void disconnect_dendrite (Connector::size_type kth_dendrite) { nn_disconnect_dendrite (dendrites, kth_dendrite); }
+
+    void set_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
+    {
+      synapses[nth_synapse].connect (n, kth_dendrite);
+    }
+
+    void set_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse)
+    {
+      dendrites[kth_dendrite].connect (n, nth_synapse);
+    }
+
+    bool is_synapse_connected (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < synapses.size () and synapses[nth_synapse].is_connected ();
+    }
+
+    bool is_dendrite_connected (Connector::size_type kth_dendrite) const
+    {
+      return kth_dendrite < dendrites.size () and dendrites[kth_dendrite].is_connected ();
+    }
+
+    const NeuronBase * synapse_target (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < synapses.size () ? synapses[nth_synapse].get_neuron () : 0;
+    }
+
+    virtual __uint64_t state_hash () const { return nn_hash_bytes (&states[0], states.size () * sizeof (NeuronState)); }
+
+    // The weights and biases are saved together with the outputs' states.
+    virtual size_t sizeof_state () const
+    {
+      return states.size () * sizeof (NeuronState) + (weights.size () + biases.size ()) * sizeof (Scalar);
+    }
+
+    virtual void save_state (void * buffer) const
+    {
+      char * p = (char *)buffer;
+
+      memcpy (p, &states[0], states.size () * sizeof (NeuronState));
+      p += states.size () * sizeof (NeuronState);
+      memcpy (p, weights.data (), weights.size () * sizeof (Scalar));
+      p += weights.size () * sizeof (Scalar);
+      memcpy (p, biases.data (), biases.size () * sizeof (Scalar));
+    }
+
+    virtual void load_state (const void * buffer)
+    {
+      const char * p = (const char *)buffer;
+
+      memcpy (&states[0], p, states.size () * sizeof (NeuronState));
+      p += states.size () * sizeof (NeuronState);
+      memcpy (weights.data (), p, weights.size () * sizeof (Scalar));
+      p += weights.size () * sizeof (Scalar);
+      memcpy (biases.data (), p, biases.size () * sizeof (Scalar));
+    }
+
+    virtual void report_memory (MemoryReport & report) const
+    {
+      report.neuron_objects += sizeof (DenseLayer);
+      report.connectors_heap += dendrites.allocated () + synapses.allocated ();
+      report.connectors_used += dendrites.size () * sizeof (Connector) + synapses.size () * sizeof (SynapseType);
+      report.states += sizeof_state ();
+      report.functors += (weights.capacity () + biases.capacity () + inputs.capacity () + sums.capacity ()) * sizeof (Scalar) +
+                         states.capacity () * sizeof (NeuronState) + fired.capacity ();
+      report.heap_blocks += 7 + dendrites.is_spilled () + synapses.is_spilled ();
+    }
+
+    virtual PropagatorBase & propagator (PropagatorBase * ptr) { return *new (ptr) PropagatorType (*this); }
+    virtual size_t sizeof_propagator () const { return sizeof (PropagatorType); }
+
+    virtual void propagate (Connector::size_type nth, void * store) const
+    {
+      synapses[nth].propagate (states[nth % n_outputs], (SynapseSignalType *)store);
+    }
+
+    virtual void backpropagate (Connector::size_type nth, void * store) const {}
+
+    virtual void report_connections () const
+    {
+      std::cerr << "Dense layer " << id () << ": " << dendrites.size () << " inputs, " << n_outputs << " outputs and "
+                << synapses.size () << " synapses\n";
+
+      for (size_t i = 0; i < dendrites.size (); i++)
+        if (dendrites[i].is_connected ())
+          std::cerr << "\tInput " << i << " connected to synapse " << dendrites[i].get_nth () << " of Neuron " << dendrites[i].get_neuron ()->id () << std::endl;
+
+      for (size_t i = 0; i < synapses.size (); i++)
+        if (synapses[i].is_connected ())
+          std::cerr << "\tSynapse " << i << " connected to dendrite " << synapses[i].get_nth () << " of Neuron " << synapses[i].get_neuron ()->id () << std::endl;
+
+      std::cerr << std::endl;
+    }
+
+  private:
+
+    size_t n_outputs;
+
+    std::vector<Scalar> weights; // n_inputs rows of n_outputs weights
+    std::vector<Scalar> biases;
+    std::vector<Scalar> inputs;  // signals of the inputs gathered by forward ()
+    std::vector<Scalar> sums;    // weighted sums of the outputs
+    std::vector<NeuronState> states;
+    std::vector<char> fired;
+
+    SmallVector<Connector> dendrites;
+    SmallVector<SynapseType> synapses;
+
+  public:
+
+    class NeuronFactory : public NeuronFactoryBase
+    {
+      public:
+
+        virtual NeuronBase * create () { return new DenseLayer (1, 1); }
+        virtual NeuronBase * create (unsigned int n_dendrites, unsigned int n_synapses) { return new DenseLayer (n_dendrites, n_synapses); }
+    };
+
+    static NeuronFactory factory;
+};
+
+template <class NeuronFunctor>
+typename DenseLayer<NeuronFunctor>::NeuronFactory DenseLayer<NeuronFunctor>::factory;
+
+
+
+/*
+ * Builds a stack of fully connected layers within the network. The first layer is fed
+ * by existing neurons of the network, each of the following ones by all the outputs of the
+ * previous layer. The layers are ordinary nodes of the network, so free-form neurons can be
+ * connected to their outputs after adding synapses to them.
+ */
+template <class NeuronFunctor> class LayerBuilder
+{
+  public:
+
+    typedef DenseLayer<NeuronFunctor> LayerType;
+
+    LayerBuilder (NeuralNetwork & nn) : network (nn) {}
+
+    // Add the first layer, input i of which is the given synapse of neuron inputs[i]
+    // (indices within the network). Returns 0 if any of the synapses is already taken; the
+    // unconnected layer stays in the network then.
+    LayerType * add_input_layer (const NeuronVector::size_type * inputs, size_t n_inputs, Connector::size_type synapse,
+                                 size_t n_outputs)
+    {
+      std::vector<Edge> edges (n_inputs);
+      NeuronVector::size_type index = network.neurons_count ();
+
+      for (size_t i = 0; i < n_inputs; i++)
+      {
+        Edge e = { inputs[i], synapse, index, i };
+
+        edges[i] = e;
+      }
+
+      return add (n_inputs, n_outputs, edges);
+    }
+
+    // Add a layer fed by all the outputs of the last one.
+    LayerType * add_layer (size_t n_outputs)
+    {
+      if (layers.empty ()) return 0;
+
+      LayerType * previous = layer (layers.size () - 1);
+      NeuronVector::size_type index = network.neurons_count ();
+      std::vector<Edge> edges (previous->outputs ());
+
+      for (size_t i = 0; i < previous->outputs (); i++)
+      {
+        Edge e = { layers.back (), i, index, i };
+
+        edges[i] = e;
+      }
+
+      return add (previous->outputs (), n_outputs, edges);
+    }
+
+    size_t n_layers () const { return layers.size (); }
+    LayerType * layer (size_t i) const { return static_cast<LayerType *> (network.neuron (layers[i])); }
+    NeuronVector::size_type index (size_t i) const { return layers[i]; } // within the network
+
+  private:
+
+    LayerType * add (size_t n_inputs, size_t n_outputs, const std::vector<Edge> & edges)
+    {
+      NeuronVector::size_type index = network.neurons_count ();
+
+      network.create_neuron (LayerType::factory, n_inputs, n_outputs);
+
+      if (not edges.empty () and not network.connect (&edges[0], edges.size ())) return 0;
+
+      layers.push_back (index);
+
+      return layer (layers.size () - 1);
+    }
+
+    NeuralNetwork & network;
+    std::vector<NeuronVector::size_type> layers;
+};
+
+
+#endif /* DENSELAYER_H_ */
@@ -0,0 +1,268 @@
+/* Ensemble.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef ENSEMBLE_H_
+#define ENSEMBLE_H_
+
+#include <vector>
+#include "SpmvBackend.h"
+#include "CowArray.h"
+
+
+/*
+ * Type independent part of Ensemble: runs the replicas on a pool of threads, each thread
+ * taking the next replica not yet run as soon as it finishes the previous one.
+ */
+class EnsembleBase
+{
+  public:
+
+    EnsembleBase (unsigned int n) : n_threads (n) {}
+    virtual ~EnsembleBase () {}
+
+    virtual size_t size () const = 0;
+
+    // Run up to n iterations of every replica, stopping each one earlier if it quiesces.
+    // Replicas run in parallel, using n_threads threads (0 = as many as there are hardware
+    // threads). Returns the total number of iterations performed.
+    unsigned long int run_n (unsigned long int n);
+
+  protected:
+
+    virtual unsigned long int run_replica (size_t i, unsigned long int n) = 0;
+
+  private:
+
+    unsigned int n_threads;
+};
+
+
+/*
+ * Set of replicas of a network of weighted sum neurons, each with its own neuron states and
+ * frontier, sharing a single read-only copy of the topology and the weights. The network
+ * given is the prototype: its weights and connections are extracted once into the matrix of
+ * SpmvBackend (which places the same requirements on the neurons) and the replicas start
+ * from its neurons' states with empty frontiers. A replica takes the neurons' states, their
+ * signals, a flag bit per neuron and its frontier queues, so the memory used grows with the
+ * size of the state rather than that of the topology. Replicas can be forked cheaply for
+ * short trial runs, the copies sharing the unchanged parts of the state.
+ * Replicas are run exactly like SpmvBackend runs the network. Neuron and synapse functors
+ * are created afresh or shared (read-only) between the replicas respectively, so they must
+ * not keep any data. The prototype must not change while the ensemble exists.
+ */
+template <class NeuronType> class Ensemble : public EnsembleBase
+{
+  public:
+
+    typedef SpmvBackend<NeuronType>                   Topology;
+    typedef typename Topology::NeuronFunctor          NeuronFunctor;
+    typedef typename Topology::NeuronState            NeuronState;
+    typedef typename Topology::DendriteState          DendriteState;
+    typedef typename Topology::SynapseSignalType      SynapseSignalType;
+    typedef typename Topology::WeightFunction         WeightFunction;
+
+    /*
+     * State of one replica. The per-neuron data is kept in a CowArray, so a copy of a
+     * replica (see Ensemble::fork ()) shares it with the original until either of them
+     * changes it, page by page.
+     */
+    class Replica
+    {
+      public:
+
+        Replica (const Topology & t) : topology (&t), n_iterations (0)
+        {
+          size_t n = t.n_rows ();
+
+          cells = CowArray<Cell> (n, Cell ());
+          queued.assign (n, false);
+
+          for (size_t r = 0; r < n; r++) set_state (r, static_cast<NeuronType *> (t.neuron (r))->get_state ());
+        }
+
+        const NeuronState & state (size_t i) const { return cells[i].state; }
+
+        // Change the neuron's state, as seen by the neurons it is connected to from now on.
+        void set_state (size_t i, const NeuronState & s)
+        {
+          Cell & c = cells.write (i);
+
+          c.state = s;
+          c.signal = signal (i, s);
+        }
+
+        // Queue the i-th neuron of the network for recomputation in the next iteration.
+        void fire (size_t i)
+        {
+          if (queued[i]) return;
+
+          queued[i] = true;
+          current.push_back (i);
+        }
+
+        bool is_firing () const { return not current.empty (); }
+        size_t neurons_firing_count () const { return current.size (); }
+        unsigned long int iterations () const { return n_iterations; }
+
+        // Memory owned by this replica alone: the pages it doesn't share and its queues.
+        size_t private_size () const
+        {
+          return cells.private_pages () * CowArray<Cell>::page_bytes () + queued.capacity () / 8 +
+                 (current.capacity () + fired.capacity ()) * sizeof (size_t) + sums.capacity () * sizeof (double);
+        }
+
+        void run ()
+        {
+          size_t n = current.size ();
+
+          // All the sums are computed before any neuron changes, so that all of them see the
+          // previous iteration's signals.
+
+          sums.resize (n);
+
+          for (size_t i = 0; i < n; i++)
+          {
+            const size_t * columns;
+            size_t n_weights;
+            const double * weights = topology->row_weights (current[i], columns, n_weights);
+            double sum = 0.0;
+
+            for (size_t k = 0; k < n_weights; k++) sum += weights[k] * cells[columns[k]].signal;
+
+            sums[i] = sum;
+          }
+
+          fired.clear ();
+
+          for (size_t i = 0; i < n; i++)
+          {
+            size_t r = current[i];
+            Cell & c = cells.write (r);
+            NeuronFunctor functor;
+
+            queued[r] = false;
+
+            functor.process_input (0, DendriteState (), sums[i]);
+
+            if (functor.propagate (c.state)) fired.push_back (r);
+
+            c.signal = signal (r, c.state);
+          }
+
+          current.clear ();
+
+          for (std::vector<size_t>::iterator i = fired.begin (); i != fired.end (); i++)
+          {
+            size_t n_targets;
+            const size_t * t = topology->row_targets (*i, n_targets);
+
+            for (size_t k = 0; k < n_targets; k++) fire (t[k]);
+          }
+
+          n_iterations++;
+        }
+
+        unsigned long int run_n (unsigned long int n)
+        {
+          unsigned long int i = 0;
+
+          for (; i < n and is_firing (); i++) run ();
+
+          return i;
+        }
+
+      private:
+
+        struct Cell
+        {
+            Cell () : state (), signal (0.0) {}
+
+            NeuronState state;
+            double signal; // what the neuron's synapses deliver, updated at the end of each iteration
+        };
+
+        double signal (size_t r, const NeuronState & state) const
+        {
+          NeuronType * n = static_cast<NeuronType *> (topology->neuron (r));
+          SynapseSignalType s = SynapseSignalType ();
+
+          if (n->n_synapses ()) n->get_synapses ()[0].propagate (state, &s);
+
+          return s;
+        }
+
+        const Topology * topology;
+
+        CowArray<Cell> cells;
+        std::vector<bool> queued;    // true = the neuron is in the frontier, private to the replica
+        std::vector<size_t> current; // frontier of the next iteration
+        std::vector<size_t> fired;
+        std::vector<double> sums;
+        unsigned long int n_iterations;
+    };
+
+    Ensemble (NeuralNetwork & prototype, size_t n_replicas, WeightFunction w = nn_spmv_weight<DendriteState>,
+              unsigned int n_threads = 0) : EnsembleBase (n_threads), topology (prototype, w, 1)
+    {
+      if (not topology.is_valid ()) return;
+
+      replicas.reserve (n_replicas);
+
+      for (size_t i = 0; i < n_replicas; i++) replicas.push_back (Replica (topology));
+    }
+
+    virtual ~Ensemble () {}
+
+    // False if the prototype can't be run by SpmvBackend. The ensemble has no replicas then.
+    bool is_valid () const { return topology.is_valid (); }
+
+    virtual size_t size () const { return replicas.size (); }
+
+    Replica & replica (size_t i) { return replicas[i]; }
+    const Replica & replica (size_t i) const { return replicas[i]; }
+
+    // Add a copy of the i-th replica and return its index. The copy shares the neurons' data
+    // with the original (see Replica), so it takes time and memory proportional to the number
+    // of pages and to the frontier rather than to the network.
+    size_t fork (size_t i)
+    {
+      Replica copy (replicas[i]);
+
+      replicas.push_back (copy);
+
+      return replicas.size () - 1;
+    }
+
+    // Remove the i-th replica. The following ones move down by one.
+    void discard (size_t i) { replicas.erase (replicas.begin () + i); }
+
+  protected:
+
+    virtual unsigned long int run_replica (size_t i, unsigned long int n) { return replicas[i].run_n (n); }
+
+  private:
+
+    Topology topology;
+    std::vector<Replica> replicas;
+};
+
+
+#endif /* ENSEMBLE_H_ */
@@ -0,0 +1,359 @@
+/* FixedNeuron.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef FIXEDNEURON_H_
+#define FIXEDNEURON_H_
+
+#include <array>
+#include "Neuron.h"
+
+
+/*
+ * Propagator for neurons with the number of dendrites and synapses fixed at compile time.
+ * Does the same job as Propagator template, but iterates directly over the std::array
+ * of connectors, with loop bounds being compile time constants, so that the compiler can
+ * unroll the loops and inline the connectors' (non-virtual, if SharedNeuronFunctor is used)
+ * methods.
+ */
+template <class NeuronFunctor, size_t NDendrites, size_t NSynapses> class FixedPropagator : public PropagatorBase
+{
+  public:
+
+    typedef NeuronFunctor                            NeuronFunctorType;
+    typedef typename NeuronFunctor::DendriteType     DendriteType;
+    typedef typename NeuronFunctor::SynapseType      SynapseType;
+    typedef typename NeuronFunctor::NeuronStateType  NeuronState;
+    typedef typename NeuronFunctor::size_type        size_type;
+
+    typedef std::array<DendriteType, NDendrites>     Dendrites;
+    typedef std::array<SynapseType, NSynapses>       Synapses;
+
+    FixedPropagator (Dendrites & d, Synapses & s, NeuronState & ns) : dendrites (d),
+                                                                      synapses (s),
+                                                                      neuron_state (ns),
+                                                                      cursor (0) {}
+    virtual ~FixedPropagator () {}
+
+    virtual bool operator () ()
+    {
+      for (size_type i = 0; i < NDendrites; i++)
+      {
+        DendriteType & d = dendrites[i];
+
+        if (d.is_connected ())
+          if (d.process_input (neuron_state))
+            neuron_functor.process_input (i, d.get_state (), d.propagate (neuron_state));
+      }
+
+      return neuron_functor.propagate (neuron_state);
+    }
+
+    virtual bool recompute_inputs (const void * inputs)
+    {
+      const typename DendriteType::SignalType * f = (const typename DendriteType::SignalType *)inputs;
+
+      for (size_type i = 0; i < NDendrites; i++)
+      {
+        DendriteType & d = dendrites[i];
+
+        if (d.is_connected ())
+          if (d.process_input_signal (neuron_state, *f++))
+            neuron_functor.process_input (i, d.get_state (), d.propagate (neuron_state));
+      }
+
+      return neuron_functor.propagate (neuron_state);
+    }
+
+    virtual bool backpropagate ()
+    {
+      for (size_type i = 0; i < NSynapses; i++)
+      {
+        SynapseType & s = synapses[i];
+
+        if (s.is_connected ())
+          if (s.process_feedback (neuron_state))
+            neuron_functor.process_feedback (i, s.backpropagate (neuron_state));
+      }
+
+      return neuron_functor.backpropagate (neuron_state);
+    }
+
+    virtual bool backpropagate_feedback (const void * feedback)
+    {
+      const typename SynapseType::SignalType * f = (const typename SynapseType::SignalType *)feedback;
+
+      for (size_type i = 0; i < NSynapses; i++)
+      {
+        SynapseType & s = synapses[i];
+
+        if (s.is_connected ())
+          if (s.process_feedback_signal (neuron_state, *f++))
+            neuron_functor.process_feedback (i, s.backpropagate (neuron_state));
+      }
+
+      return neuron_functor.backpropagate (neuron_state);
+    }
+
+    virtual bool should_backpropagate ()
+    {
+      return neuron_functor.should_backpropagate (neuron_state);
+    }
+
+    virtual NeuronBase * first_synapse ()
+    {
+      cursor = 0;
+
+      return next_synapse ();
+    }
+
+    virtual NeuronBase * next_synapse ()
+    {
+      for (; cursor < NSynapses; cursor++)
+      {
+        SynapseType & s = synapses[cursor];
+
+        if (s.is_connected ())
+          if (s.process_output (neuron_state))
+            return synapses[cursor++].get_neuron ();
+      }
+
+      return 0;
+    }
+
+    virtual NeuronBase * first_dendrite ()
+    {
+      cursor = 0;
+
+      return next_dendrite ();
+    }
+
+    virtual NeuronBase * next_dendrite ()
+    {
+      for (; cursor < NDendrites; cursor++)
+      {
+        DendriteType & d = dendrites[cursor];
+
+        if (d.is_connected ())
+          if (d.process_feedback (neuron_state))
+            return dendrites[cursor++].get_neuron ();
+      }
+
+      return 0;
+    }
+
+  protected:
+
+    NeuronFunctor neuron_functor;
+
+    Dendrites & dendrites;
+    Synapses & synapses;
+    NeuronState & neuron_state;
+
+    size_type cursor; // Position of the next connector to be visited by next_synapse ()/next_dendrite ()
+};
+
+
+
+/*
+ * Neuron with the number of dendrites and synapses given as template parameters. Connectors
+ * are stored in std::array within the neuron object itself, so there is no container
+ * overhead or indirection whatsoever. Otherwise it behaves exactly like Neuron and can be
+ * mixed with other neuron types within the same NeuralNetwork. Since its arity is fixed
+ * add_dendrite () and add_synapse () do nothing, and the factory creates no neuron when
+ * asked for other numbers of dendrites and synapses, which NeuralNetwork::create_neuron ()
+ * skips.
+ */
+template <class NeuronFunctor, size_t NDendrites, size_t NSynapses> class FixedNeuron : public NeuronBase
+{
+  public:
+
+    typedef typename NeuronFunctor::DendriteType     DendriteType;
+    typedef typename NeuronFunctor::SynapseType      SynapseType;
+    typedef typename NeuronFunctor::NeuronStateType  NeuronState;
+
+    typedef typename DendriteType::SignalType        DendriteSignalType;
+    typedef typename SynapseType::SignalType         SynapseSignalType;
+    typedef typename DendriteType::DendriteStateType DendriteState;
+
+    typedef FixedPropagator<NeuronFunctor, NDendrites, NSynapses> PropagatorType;
+    typedef typename PropagatorType::Dendrites       Dendrites;
+    typedef typename PropagatorType::Synapses        Synapses;
+
+    FixedNeuron () : state (), dendrites (), synapses () { set_type_tag (nn_type_tag<FixedNeuron> ()); }
+    virtual ~FixedNeuron () {}
+
+    virtual Connector::size_type n_synapses () const { return NSynapses; }
+    virtual Connector::size_type n_dendrites () const { return NDendrites; }
+
+    virtual void add_dendrite () {}
+    virtual void add_synapse () {}
+
+    unsigned long int size () { return sizeof (FixedNeuron); }
+
+    Synapses & get_synapses () { return synapses; }
+    Dendrites & get_dendrites () { return dendrites; }
+    NeuronState & get_state () { return state; }
+
+
+  protected:
+
+    void connect_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
+    {
+      nn_connect_synapse (this, synapses, nth_synapse, n, kth_dendrite);
+    }
+
+    void connect_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse)
+    {
+      nn_connect_dendrite (this, dendrites, kth_dendrite, n, nth_synapse);
+    }
+
+    void disconnect_synapse (Connector::size_type nth_synapse) { nn_disconnect_synapse (synapses, nth_synapse); }
+    void disconnect_dendrite (Connector::size_type kth_dendrite) { nn_disconnect_dendrite (dendrites, kth_dendrite); }
+
+    void set_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
+    {
+      synapses[nth_synapse].connect (n, kth_dendrite);
+    }
+
+    void set_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse)
+    {
+      dendrites[kth_dendrite].connect (n, nth_synapse);
+    }
+
+    bool is_synapse_connected (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < NSynapses and synapses[nth_synapse].is_connected ();
+    }
+
+    bool is_dendrite_connected (Connector::size_type kth_dendrite) const
+    {
+      return kth_dendrite < NDendrites and dendrites[kth_dendrite].is_connected ();
+    }
+
+    const NeuronBase * synapse_target (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < NSynapses ? synapses[nth_synapse].get_neuron () : 0;
+    }
+
+    Connector::size_type synapse_dendrite (Connector::size_type nth_synapse) const { return synapses[nth_synapse].get_nth (); }
+
+    virtual size_t sizeof_feedback () const { return sizeof (SynapseSignalType); }
+
+    const NeuronBase * dendrite_source (Connector::size_type kth_dendrite) const
+    {
+      return kth_dendrite < NDendrites ? dendrites[kth_dendrite].get_neuron () : 0;
+    }
+
+    Connector::size_type dendrite_synapse (Connector::size_type kth_dendrite) const { return dendrites[kth_dendrite].get_nth (); }
+
+    virtual size_t sizeof_input () const { return sizeof (DendriteSignalType); }
+
+    virtual __uint64_t state_hash () const
+    {
+      __uint64_t h = nn_hash_bytes (&state, sizeof (NeuronState));
+
+      for (size_t i = 0; i < NDendrites; i++) h = nn_hash_bytes (&dendrites[i].get_state (), sizeof (DendriteState), h);
+
+      return h;
+    }
+
+    virtual void report_memory (MemoryReport & report) const
+    {
+      report.neuron_objects += sizeof (FixedNeuron);
+      report.connectors_used += sizeof (Dendrites) + sizeof (Synapses);
+      report.states += sizeof_state ();
+      report.heap_blocks++;
+
+      for (size_t i = 0; i < NDendrites; i++) report.functors += dendrites[i].functor_size ();
+      for (size_t i = 0; i < NSynapses; i++) report.functors += synapses[i].functor_size ();
+    }
+
+    virtual size_t sizeof_state () const { return sizeof (NeuronState) + NDendrites * sizeof (DendriteState); }
+
+    virtual void save_state (void * buffer) const
+    {
+      char * p = (char *)buffer;
+
+      memcpy (p, &state, sizeof (NeuronState));
+      p += sizeof (NeuronState);
+
+      for (size_t i = 0; i < NDendrites; i++, p += sizeof (DendriteState))
+        memcpy (p, &dendrites[i].get_state (), sizeof (DendriteState));
+    }
+
+    virtual void load_state (const void * buffer)
+    {
+      const char * p = (const char *)buffer;
+
+      memcpy (&state, p, sizeof (NeuronState));
+      p += sizeof (NeuronState);
+
+      for (size_t i = 0; i < NDendrites; i++, p += sizeof (DendriteState))
+        memcpy (&dendrites[i].get_state (), p, sizeof (DendriteState));
+    }
+
+    virtual PropagatorBase & propagator (PropagatorBase * ptr) { return propagator_factory.create (ptr, *this); }
+    virtual size_t sizeof_propagator () const { return propagator_factory.sizeof_propagator (); }
+    virtual void propagate (Connector::size_type nth, void * store) const { synapses[nth].propagate (state, (SynapseSignalType *)store); }
+    virtual void backpropagate (Connector::size_type nth, void * store) const { dendrites[nth].backpropagate (state, (DendriteSignalType *)store); }
+
+    virtual void backpropagate_dendrites (const size_t * offsets, char * store) const
+    {
+      for (size_t k = 0; k < NDendrites; k++)
+        if (offsets[k] != (size_t)-1) dendrites[k].backpropagate (state, (DendriteSignalType *)(store + offsets[k]));
+    }
+
+    virtual void report_connections () const { nn_report_connections (*this, dendrites, synapses); }
+
+  private:
+
+    NeuronState state;
+
+    Dendrites dendrites;
+
+    Synapses synapses;
+
+  public:
+
+    class NeuronFactory : public NeuronFactoryBase
+    {
+      public:
+
+        virtual NeuronBase * create () { return new FixedNeuron (); }
+        virtual NeuronBase * create (unsigned int n_dendrites, unsigned int n_synapses)
+        {
+          return n_dendrites == NDendrites and n_synapses == NSynapses ? new FixedNeuron () : 0;
+        }
+    };
+
+    static NeuronFactory factory;
+    static PropagatorFactory<PropagatorType, FixedNeuron> propagator_factory;
+};
+
+
+template <class NeuronFunctor, size_t NDendrites, size_t NSynapses>
+typename FixedNeuron<NeuronFunctor, NDendrites, NSynapses>::NeuronFactory FixedNeuron<NeuronFunctor, NDendrites, NSynapses>::factory;
+
+template <class NeuronFunctor, size_t NDendrites, size_t NSynapses>
+PropagatorFactory<typename FixedNeuron<NeuronFunctor, NDendrites, NSynapses>::PropagatorType, FixedNeuron<NeuronFunctor, NDendrites, NSynapses> >
+FixedNeuron<NeuronFunctor, NDendrites, NSynapses>::propagator_factory;
+
+
+#endif /* FIXEDNEURON_H_ */
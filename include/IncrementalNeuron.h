@@ -0,0 +1,311 @@
+/* IncrementalNeuron.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef INCREMENTALNEURON_H_
+#define INCREMENTALNEURON_H_
+
+#include <string.h>
+#include <new>
+#include "Neuron.h"
+
+
+/*
+ * Dendrite remembering the version of the source neuron it last read (see
+ * NeuronBase::version ()) together with the signal it passed to its neuron then, so that
+ * inputs which haven't changed since can be skipped and the changed ones passed on as
+ * the difference between the old and the new signal.
+ */
+template <class Functor> class VersionedDendriteBase : public DendriteBase<Functor>
+{
+  public:
+
+    typedef typename DendriteBase<Functor>::SignalType        SignalType;
+    typedef typename DendriteBase<Functor>::NeuronStateType   NeuronStateType;
+    typedef typename DendriteBase<Functor>::DendriteStateType DendriteStateType;
+
+    VersionedDendriteBase () : DendriteBase<Functor> (), seen_version (0), last_signal () {}
+    virtual ~VersionedDendriteBase () {}
+
+    // Connecting to another neuron forgets the version read from the previous one.
+    void connect (NeuronBase * n, Connector::size_type i)
+    {
+      Connector::connect (n, i);
+      seen_version = ~0u;
+    }
+
+    // Disconnecting leaves the signal last passed on to be withdrawn from the neuron by its
+    // next recomputation.
+    void disconnect ()
+    {
+      Connector::disconnect ();
+      seen_version = ~0u;
+    }
+
+    bool is_withdrawing () const { return not this->is_connected () and seen_version == ~0u; }
+
+    void withdraw ()
+    {
+      seen_version = 0;
+      last_signal = SignalType ();
+    }
+
+    // True if the source neuron may have changed since the dendrite last read it.
+    bool is_stale () const { return this->get_neuron ()->version () != seen_version; }
+
+    void mark_seen () { seen_version = this->get_neuron ()->version (); }
+
+    // Makes the next recomputation read the source neuron again, whatever its version.
+    void forget_seen () { seen_version = ~0u; }
+
+    // Feedback changing the dendrite's own state (its weight, say) changes the signal it
+    // passes on even if the source neuron stays the same, so the next recomputation has to
+    // read it again.
+    virtual bool process_feedback (const NeuronStateType & neuron_state)
+    {
+      DendriteStateType previous = this->get_state ();
+
+      bool r = DendriteBase<Functor>::process_feedback (neuron_state);
+
+      if (r or memcmp (&previous, &this->get_state (), sizeof (DendriteStateType)) != 0) seen_version = ~0u;
+
+      return r;
+    }
+
+    const SignalType & get_last_signal () const { return last_signal; }
+    void set_last_signal (const SignalType & s) { last_signal = s; }
+
+  private:
+
+    __uint32_t seen_version;
+    SignalType last_signal;
+};
+
+
+
+/*
+ * Neuron functor for neurons updating their state incrementally. Instead of being given
+ * every input by process_input () on each recomputation, the functor receives through
+ * update_input () only the inputs whose source neurons were recomputed or backpropagated
+ * through since the last time, together with the signal the same dendrite delivered
+ * previously (default constructed the first time), so that for instance a weighted sum
+ * kept in NeuronStateType can be adjusted by the difference. Since the functor is created
+ * anew for every recomputation, any accumulated values must be kept in NeuronStateType.
+ * A dendrite whose DendriteFunctor::process_input () returns false keeps contributing the
+ * signal it delivered previously. Disconnecting a dendrite makes the next recomputation
+ * pass update_input () a default constructed signal in place of the one it delivered.
+ * Functors derived from this template should be used with IncrementalNeuron.
+ */
+template <class DendriteFunctor, class NeuronState, class SynapseFunctor>
+class IncrementalNeuronFunctor : public NeuronFunctor<DendriteFunctor, NeuronState, SynapseFunctor>
+{
+  public:
+
+    typedef NeuronFunctor<DendriteFunctor, NeuronState, SynapseFunctor> Base;
+
+    typedef VersionedDendriteBase<DendriteFunctor>  DendriteType;
+    typedef typename Base::DendriteStateType        DendriteStateType;
+    typedef typename Base::DendriteSignalType       DendriteSignalType;
+    typedef typename Base::size_type                size_type;
+
+    IncrementalNeuronFunctor () {}
+    virtual ~IncrementalNeuronFunctor () {}
+
+    virtual void update_input (size_type dendrite_idx, const DendriteStateType & dstate,
+                               DendriteSignalType previous, DendriteSignalType signal) = 0;
+
+    virtual void process_input (size_type dendrite_idx, const DendriteStateType & dstate, DendriteSignalType signal) {}
+};
+
+
+
+/*
+ * Propagator of IncrementalNeuron. The recomputation costs in proportion to the number
+ * of changed inputs rather than to the number of dendrites, save for the comparison of
+ * the versions.
+ */
+template <class NeuronFunctor> class IncrementalPropagator : public Propagator<NeuronFunctor>
+{
+  public:
+
+    typedef Propagator<NeuronFunctor>                Base;
+    typedef typename Base::DendriteType              DendriteType;
+    typedef typename Base::NeuronState               NeuronState;
+    typedef typename Base::size_type                 size_type;
+    typedef typename DendriteType::SignalType        SignalType;
+
+    IncrementalPropagator (typename Base::Dendrites d, typename Base::Synapses s, NeuronState & ns) : Base (d, s, ns) {}
+    virtual ~IncrementalPropagator () {}
+
+    virtual bool operator () ()
+    {
+      size_type i = 0;
+
+      for (DendriteType * d = this->dendrites.first (); d != this->dendrites.null (); d = this->dendrites.next ())
+      {
+        if (d->is_connected () and d->is_stale ())
+        {
+          d->mark_seen ();
+
+          if (d->process_input (this->neuron_state))
+          {
+            SignalType signal = d->propagate (this->neuron_state);
+
+            this->neuron_functor.update_input (i, d->get_state (), d->get_last_signal (), signal);
+
+            d->set_last_signal (signal);
+          }
+        }
+        else if (d->is_withdrawing ())
+          withdraw (i, d);
+
+        i++;
+      }
+
+      return this->neuron_functor.propagate (this->neuron_state);
+    }
+
+    virtual bool recompute_inputs (const void * inputs)
+    {
+      const SignalType * f = (const SignalType *)inputs;
+      size_type i = 0;
+
+      for (DendriteType * d = this->dendrites.first (); d != this->dendrites.null (); d = this->dendrites.next ())
+      {
+        if (d->is_connected ())
+        {
+          const SignalType & input = *f++;
+
+          if (d->is_stale ())
+          {
+            d->mark_seen ();
+
+            if (d->process_input_signal (this->neuron_state, input))
+            {
+              SignalType signal = d->propagate (this->neuron_state);
+
+              this->neuron_functor.update_input (i, d->get_state (), d->get_last_signal (), signal);
+
+              d->set_last_signal (signal);
+            }
+          }
+        }
+        else if (d->is_withdrawing ())
+          withdraw (i, d);
+
+        i++;
+      }
+
+      return this->neuron_functor.propagate (this->neuron_state);
+    }
+
+  private:
+
+    void withdraw (size_type i, DendriteType * d)
+    {
+      this->neuron_functor.update_input (i, d->get_state (), d->get_last_signal (), SignalType ());
+      d->withdraw ();
+    }
+};
+
+
+
+/*
+ * Neuron recomputing its state incrementally. Behaves like the Neuron of the same
+ * functor, which has to be derived from IncrementalNeuronFunctor, except for skipping
+ * the dendrites whose source neurons haven't changed.
+ */
+template <class NeuronFunctor, size_t InlineConnectors = NN_CONNECTOR_INLINE_CAPACITY>
+class IncrementalNeuron : public Neuron<NeuronFunctor, InlineConnectors>
+{
+  public:
+
+    typedef IncrementalPropagator<NeuronFunctor> PropagatorType;
+
+    IncrementalNeuron () : Neuron<NeuronFunctor, InlineConnectors> () { this->set_type_tag (nn_type_tag<IncrementalNeuron> ()); }
+    IncrementalNeuron (unsigned int n_dendrites, unsigned int n_synapses) : Neuron<NeuronFunctor, InlineConnectors> (n_dendrites, n_synapses)
+    {
+      this->set_type_tag (nn_type_tag<IncrementalNeuron> ());
+    }
+    virtual ~IncrementalNeuron () {}
+
+  protected:
+
+    typedef Neuron<NeuronFunctor, InlineConnectors> Base;
+    typedef typename Base::DendriteType::SignalType SignalType;
+
+    // The state kept by the functor is only consistent with the signals the dendrites last
+    // delivered, so these are saved along with it. Loaded dendrites read their sources
+    // again on the next recomputation and pass on the difference from the loaded signals.
+    virtual size_t sizeof_state () const { return Base::sizeof_state () + this->n_dendrites () * sizeof (SignalType); }
+
+    virtual void save_state (void * buffer) const
+    {
+      char * p = (char *)buffer + Base::sizeof_state ();
+
+      Base::save_state (buffer);
+
+      for (Connector::size_type i = 0; i < this->n_dendrites (); i++, p += sizeof (SignalType))
+        memcpy (p, &this->dendrite (i).get_last_signal (), sizeof (SignalType));
+    }
+
+    virtual void load_state (const void * buffer)
+    {
+      const char * p = (const char *)buffer + Base::sizeof_state ();
+
+      Base::load_state (buffer);
+
+      for (Connector::size_type i = 0; i < this->n_dendrites (); i++, p += sizeof (SignalType))
+      {
+        typename Base::DendriteType & d = this->get_dendrites ()[i];
+        SignalType signal;
+
+        memcpy (&signal, p, sizeof (SignalType));
+        d.set_last_signal (signal);
+        d.forget_seen ();
+      }
+    }
+
+    virtual PropagatorBase & propagator (PropagatorBase * ptr)
+    {
+      return *new (ptr) PropagatorType (this->get_dendrites (), this->get_synapses (), this->get_state ());
+    }
+
+    virtual size_t sizeof_propagator () const { return sizeof (PropagatorType); }
+
+  public:
+
+    class NeuronFactory : public NeuronFactoryBase
+    {
+      public:
+
+        virtual NeuronBase * create () { return new IncrementalNeuron (); }
+        virtual NeuronBase * create (unsigned int n_dendrites, unsigned int n_synapses) { return new IncrementalNeuron (n_dendrites, n_synapses); }
+    };
+
+    static NeuronFactory factory;
+};
+
+
+template <class NeuronFunctor, size_t InlineConnectors>
+typename IncrementalNeuron<NeuronFunctor, InlineConnectors>::NeuronFactory IncrementalNeuron<NeuronFunctor, InlineConnectors>::factory;
+
+
+#endif /* INCREMENTALNEURON_H_ */
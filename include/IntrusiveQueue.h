@@ -0,0 +1,137 @@
+/* IntrusiveQueue.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef INTRUSIVEQUEUE_H_
+#define INTRUSIVEQUEUE_H_
+
+#include <atomic>
+
+
+/*
+ * Disposers of the objects still in an IntrusiveQueue when it is destroyed: deleting them,
+ * giving them back to where they came from with their release (), or leaving them alone
+ * for their owner to free.
+ */
+template <class T> struct IntrusiveDelete
+{
+    void operator () (T * t) const { delete t; }
+};
+
+template <class T> struct IntrusiveRelease
+{
+    void operator () (T * t) const { t->release (); }
+};
+
+template <class T> struct IntrusiveKeep
+{
+    void operator () (T * t) const {}
+};
+
+
+/*
+ * Lock-free multiple producer, single consumer queue (an intrusive linked list with a stub
+ * node) of objects of class T, which must be default constructible and have the member
+ * std::atomic<T *> next. Any number of threads may push, each push being a single atomic
+ * exchange; only the network's thread pops. A push interrupted between its two steps holds
+ * back the objects pushed after it until it completes, so pop () may return 0 while the
+ * queue is not empty. The objects still in the queue when it is destroyed are passed to
+ * Disposer.
+ */
+template <class T, class Disposer = IntrusiveDelete<T> > class IntrusiveQueue
+{
+  public:
+
+    IntrusiveQueue () : head (&stub), tail (&stub) {}
+
+    // Waits for the pushes still in flight, which hold back the objects after them.
+    ~IntrusiveQueue ()
+    {
+      Disposer dispose;
+
+      while (not is_empty ())
+        if (T * t = pop ()) dispose (t);
+    }
+
+    // Producer side, any thread. The queue holds the object until it is popped.
+    void push (T * t)
+    {
+      t->next.store (0, std::memory_order_relaxed);
+
+      T * prev = tail.exchange (t, std::memory_order_acq_rel);
+
+      prev->next.store (t, std::memory_order_release);
+    }
+
+    // Consumer side. Returns the oldest object, to be disposed of by the caller, or 0.
+    T * pop ()
+    {
+      T * h = head;
+      T * next = h->next.load (std::memory_order_acquire);
+
+      if (h == &stub)
+      {
+        if (next == 0) return 0;
+
+        head = h = next;
+        next = next->next.load (std::memory_order_acquire);
+      }
+
+      if (next)
+      {
+        head = next;
+        return h;
+      }
+
+      if (h != tail.load (std::memory_order_acquire)) return 0;
+
+      push (&stub);
+
+      next = h->next.load (std::memory_order_acquire);
+
+      if (next)
+      {
+        head = next;
+        return h;
+      }
+
+      return 0;
+    }
+
+    // Consumer side. The last object pushed so far, or 0 if all of them have been popped.
+    // Lets the consumer stop at a given object while the producers keep pushing.
+    T * last () const
+    {
+      T * t = tail.load (std::memory_order_acquire);
+
+      return t == &stub ? 0 : t;
+    }
+
+    // Consumer side.
+    bool is_empty () const { return head == &stub and tail.load (std::memory_order_acquire) == &stub; }
+
+  private:
+
+    T stub;
+    T * head;               // next object to be popped (consumer's end)
+    std::atomic<T *> tail;  // last object pushed (producers' end)
+};
+
+
+#endif /* INTRUSIVEQUEUE_H_ */
@@ -0,0 +1,127 @@
+/* MemoryReport.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef MEMORYREPORT_H_
+#define MEMORYREPORT_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <new>
+#include <memory>
+#include "nn_config.h"
+
+
+// Estimated bookkeeping overhead of the heap allocator per allocated block.
+#ifndef NN_MALLOC_OVERHEAD
+#define NN_MALLOC_OVERHEAD (2 * sizeof (size_t))
+#endif
+
+
+/*
+ * Breakdown of the memory used by a NeuralNetwork, in bytes (see
+ * NeuralNetwork::memory_report ()). The states and connectors_used figures tell how much
+ * of the neuron objects and connector storage is taken by the data proper; they are
+ * already included in the other figures and so are not added to the total.
+ */
+struct MemoryReport
+{
+    size_t n_neurons;
+    size_t neuron_objects;      // the neuron objects themselves, including inline connectors
+    size_t connectors_heap;     // connector arrays moved to the heap, including unused capacity
+    size_t connectors_used;     // connectors actually present, inline or on the heap
+    size_t states;              // neurons' and dendrites' states (NeuronBase::sizeof_state ())
+    size_t functors;            // heap data reported by the connectors' functors' size ()
+    size_t queues;              // capacity of the network's neuron lists, update queues and feedback index
+    size_t propagator_stores;   // buffers the propagators are constructed in
+    size_t heap_blocks;         // number of the heap blocks above
+    size_t heap_overhead;       // estimated allocator overhead of those blocks
+
+    // Live allocations made through CountingAllocator (configure --enable-count-allocations).
+    size_t counted_bytes;
+    size_t counted_blocks;
+
+    MemoryReport () : n_neurons (0), neuron_objects (0), connectors_heap (0), connectors_used (0), states (0),
+                      functors (0), queues (0), propagator_stores (0), heap_blocks (0), heap_overhead (0),
+                      counted_bytes (0), counted_blocks (0) {}
+
+    size_t total () const
+    {
+      return neuron_objects + connectors_heap + functors + queues + propagator_stores + heap_overhead;
+    }
+};
+
+
+// Process wide counters of the memory allocated through CountingAllocator.
+inline std::atomic<size_t> & nn_counted_bytes () { static std::atomic<size_t> n (0); return n; }
+inline std::atomic<size_t> & nn_counted_blocks () { static std::atomic<size_t> n (0); return n; }
+
+inline void * nn_counted_allocate (size_t n)
+{
+  void * p = ::operator new (n);
+
+  nn_counted_bytes ().fetch_add (n, std::memory_order_relaxed);
+  nn_counted_blocks ().fetch_add (1, std::memory_order_relaxed);
+
+  return p;
+}
+
+inline void nn_counted_deallocate (void * p, size_t n)
+{
+  nn_counted_bytes ().fetch_sub (n, std::memory_order_relaxed);
+  nn_counted_blocks ().fetch_sub (1, std::memory_order_relaxed);
+
+  ::operator delete (p);
+}
+
+
+/*
+ * Standard allocator keeping track of the memory allocated through it. When the library is
+ * configured with --enable-count-allocations (NN_COUNT_ALLOCATIONS in nn_config.h) it's used
+ * by NeuronVector and by SmallVector for the connectors moved to the heap, so that the
+ * counters show the memory actually taken by the containers. Otherwise the containers use
+ * the default allocator. The setting is installed with the headers, so the programs using
+ * the library get the same one.
+ */
+template <class T> class CountingAllocator
+{
+  public:
+
+    typedef T value_type;
+
+    CountingAllocator () {}
+    template <class U> CountingAllocator (const CountingAllocator<U> &) {}
+
+    T * allocate (size_t n) { return static_cast<T *> (nn_counted_allocate (n * sizeof (T))); }
+    void deallocate (T * p, size_t n) { nn_counted_deallocate (p, n * sizeof (T)); }
+
+    template <class U> bool operator == (const CountingAllocator<U> &) const { return true; }
+    template <class U> bool operator != (const CountingAllocator<U> &) const { return false; }
+};
+
+
+#ifdef NN_COUNT_ALLOCATIONS
+#define NN_ALLOCATOR(T) CountingAllocator<T>
+#else
+#define NN_ALLOCATOR(T) std::allocator<T>
+#endif
+
+
+#endif /* MEMORYREPORT_H_ */
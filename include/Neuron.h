@@ -23,6 +23,7 @@
 
 #include <sys/types.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vector>
 #include "DendriteBase.h"
 #include "SynapseBase.h"
@@ -64,7 +65,97 @@ class PropagatorFactoryBase
 };
 
 
-template <class PropagatorType> class PropagatorFactory : public PropagatorFactoryBase
+/*
+ * Connection bookkeeping of the neuron classes keeping their connectors in an indexable
+ * container (Neuron, FixedNeuron, DenseLayer, SensoryNeuron). A connection is made and
+ * broken from both of its ends, each neuron calling the one on the other end, so the two
+ * ends always agree. Indices out of the container's range are ignored.
+ */
+template <class Synapses>
+void nn_connect_synapse (NeuronBase * self, Synapses & synapses, Connector::size_type nth_synapse, NeuronBase * n,
+                         Connector::size_type kth_dendrite)
+{
+  if (n == 0 or nth_synapse >= synapses.size () or synapses[nth_synapse].is_connected (n, kth_dendrite)) return;
+
+  self->disconnect_synapse (nth_synapse);
+
+  synapses[nth_synapse].connect (n, kth_dendrite);
+
+  n->connect_dendrite (kth_dendrite, self, nth_synapse);
+}
+
+template <class Dendrites>
+void nn_connect_dendrite (NeuronBase * self, Dendrites & dendrites, Connector::size_type kth_dendrite, NeuronBase * n,
+                          Connector::size_type nth_synapse)
+{
+  if (n == 0 or kth_dendrite >= dendrites.size () or dendrites[kth_dendrite].is_connected (n, nth_synapse)) return;
+
+  self->disconnect_dendrite (kth_dendrite);
+
+  dendrites[kth_dendrite].connect (n, nth_synapse);
+
+  n->connect_synapse (nth_synapse, self, kth_dendrite);
+}
+
+template <class Synapses> void nn_disconnect_synapse (Synapses & synapses, Connector::size_type nth_synapse)
+{
+  if (nth_synapse >= synapses.size () or not synapses[nth_synapse].is_connected ()) return;
+
+  NeuronBase * n = synapses[nth_synapse].get_neuron ();
+  Connector::size_type dendrite = synapses[nth_synapse].get_nth ();
+
+  synapses[nth_synapse].disconnect ();
+
+  n->disconnect_dendrite (dendrite);
+}
+
+template <class Dendrites> void nn_disconnect_dendrite (Dendrites & dendrites, Connector::size_type kth_dendrite)
+{
+  if (kth_dendrite >= dendrites.size () or not dendrites[kth_dendrite].is_connected ()) return;
+
+  NeuronBase * n = dendrites[kth_dendrite].get_neuron ();
+  Connector::size_type synapse = dendrites[kth_dendrite].get_nth ();
+
+  dendrites[kth_dendrite].disconnect ();
+
+  n->disconnect_synapse (synapse);
+}
+
+// List the connections of a neuron on std::cerr, for NeuronBase::report_connections ().
+template <class Dendrites, class Synapses>
+void nn_report_connections (const NeuronBase & neuron, const Dendrites & dendrites, const Synapses & synapses)
+{
+  std::cerr << "Neuron " << neuron.id () << ": " << dendrites.size () << " dendrites and " << synapses.size () << " synapses\n";
+
+  for (size_t i = 0; i < dendrites.size (); i++)
+  {
+    if (dendrites[i].is_connected ())
+      std::cerr << "\tDendrite " << i << " connected to synapse " << dendrites[i].get_nth () << " of Neuron " << dendrites[i].get_neuron ()->id () << std::endl;
+    else
+      std::cerr << "\tDendrite " << i << " not connected" << std::endl;
+  }
+
+  for (size_t i = 0; i < synapses.size (); i++)
+  {
+    if (synapses[i].is_connected ())
+      std::cerr << "\tSynapse " << i << " connected to dendrite " << synapses[i].get_nth () << " of Neuron " << synapses[i].get_neuron ()->id () << std::endl;
+    else
+      std::cerr << "\tSynapse " << i << " not connected" << std::endl;
+  }
+
+  std::cerr << std::endl;
+}
+
+
+template <class NeuronFunctor, size_t InlineConnectors = NN_CONNECTOR_INLINE_CAPACITY> class Neuron;
+
+/*
+ * Propagator factory for the given neuron type. The propagator is constructed in place from
+ * the neuron's dendrites, synapses and state, so NeuronType has to provide get_dendrites (),
+ * get_synapses () and get_state () returning whatever PropagatorType's constructor expects.
+ */
+template <class PropagatorType, class NeuronType = Neuron<typename PropagatorType::NeuronFunctorType> >
+class PropagatorFactory : public PropagatorFactoryBase
 {
   public:
 
@@ -85,8 +176,11 @@ template <class PropagatorType> class PropagatorFactory : public PropagatorFacto
  * The implementation of a neuron unit. In fact, since this is only a template, it's just another base
  * class for user's implementation. Users can concretize this type by supplying template parameters
  * or extend it by means of derivation (and then supply the template parameters).
+ * InlineConnectors is the number of dendrites, and separately of synapses, kept within the
+ * neuron object itself, none by default (NN_CONNECTOR_INLINE_CAPACITY). Neuron classes whose
+ * instances almost all have up to a few connections of each kind can keep them inline.
  */
-template <class NeuronFunctor> class Neuron : public NeuronBase
+template <class NeuronFunctor, size_t InlineConnectors> class Neuron : public NeuronBase
 {
   public:
 
@@ -96,18 +190,24 @@ template <class NeuronFunctor> class Neuron : public NeuronBase
 
     typedef typename DendriteType::SignalType        DendriteSignalType;
     typedef typename SynapseType::SignalType         SynapseSignalType;
+    typedef typename DendriteType::DendriteStateType DendriteState;
+    typedef NeuronFunctor                            NeuronFunctorType;
+    typedef Propagator<NeuronFunctor>                PropagatorType;
 
-    typedef std::vector<DendriteType>                Dendrites;
-    typedef std::vector<SynapseType>                 Synapses;
+    typedef SmallVector<DendriteType, InlineConnectors> Dendrites;
+    typedef SmallVector<SynapseType, InlineConnectors>  Synapses;
     typedef ConnectorIterator<DendriteType>          DendriteIterator;
     typedef ConnectorIterator<SynapseType>           SynapseIterator;
 
     friend class NeuronFunctorFactory;
 
-    Neuron () : state (), dendrites (1), synapses (1) { }
+    Neuron () : state (), dendrites (1), synapses (1) { set_type_tag (nn_type_tag<Neuron> ()); }
     Neuron (unsigned int n_dendrites, unsigned int n_synapses) : state (),
                                                                  dendrites (n_dendrites),
-                                                                 synapses (n_synapses) { }
+                                                                 synapses (n_synapses)
+    {
+      set_type_tag (nn_type_tag<Neuron> ());
+    }
     virtual ~Neuron () {}
 
     virtual Connector::size_type n_synapses () const { return synapses.size (); }
@@ -116,35 +216,23 @@ template <class NeuronFunctor> class Neuron : public NeuronBase
     virtual void add_dendrite () { add_dendrite (DendriteType ()); }
     virtual void add_synapse () { add_synapse (SynapseType ()); }
 
-    void add_dendrite (DendriteType d)
-    {
-      typename Dendrites::size_type l = dendrites.size ();
-
-      if (l == 0) dendrites.reserve (64);
-      else if (l == dendrites.capacity ()) dendrites.reserve (l + (l >> 1));
-
-      dendrites.push_back (d);
-    }
-
-    void add_synapse (SynapseType s)
-    {
-      typename Synapses::size_type l = synapses.size ();
-
-      if (l == 0) synapses.reserve (64);
-      else if (l == synapses.capacity ()) synapses.reserve (l + (l >> 1));
-
-      synapses.push_back (s);
-    }
+    // Connectors are kept inline within the neuron until there are more of them than
+    // InlineConnectors, after which the container grows on the heap by half.
+    void add_dendrite (DendriteType d) { dendrites.push_back (d); }
+    void add_synapse (SynapseType s) { synapses.push_back (s); }
 
     unsigned long int size ()
     {
-      return sizeof (Neuron) +
-             dendrites.size () * sizeof (DendriteType) +
-             synapses.size ()  * sizeof (SynapseType);
+      return sizeof (Neuron) + dendrites.allocated () + synapses.allocated ();
     }
 
     SynapseIterator get_synapses () { return SynapseIterator (synapses); }
     DendriteIterator  get_dendrites () { return DendriteIterator (dendrites); }
+
+    // Free the dendrites, leaving the neuron without inputs. The synapses feeding it are left
+    // as they are. Used once an execution backend holds the dendrites' states on its own (see
+    // SpmvBackend::release_dendrites ()).
+    void release_dendrites () { dendrites.release (); }
     NeuronState & get_state () { return state; }
 
 
@@ -152,96 +240,115 @@ template <class NeuronFunctor> class Neuron : public NeuronBase
 
     void connect_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
     {
-        if (n == 0 or synapses[nth_synapse].get_neuron () == n) return;
-
-        disconnect_synapse (nth_synapse);
-
-        synapses[nth_synapse].connect (n, kth_dendrite);
-
-        n->connect_dendrite (kth_dendrite, this, nth_synapse);
+      nn_connect_synapse (this, synapses, nth_synapse, n, kth_dendrite);
     }
 
     void connect_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse)
     {
-      if (n == 0 or dendrites[kth_dendrite].get_neuron () == n) return;
+      nn_connect_dendrite (this, dendrites, kth_dendrite, n, nth_synapse);
+    }
+
+    virtual void disconnect_synapse (Connector::size_type nth_synapse) { nn_disconnect_synapse (synapses, nth_synapse); }
+    void disconnect_dendrite (Connector::size_type kth_dendrite) { nn_disconnect_dendrite (dendrites, kth_dendrite); }
 
-      disconnect_dendrite (kth_dendrite);
+    const DendriteType & dendrite (Connector::size_type kth_dendrite) const { return dendrites[kth_dendrite]; }
 
+    void set_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
+    {
+      synapses[nth_synapse].connect (n, kth_dendrite);
+    }
+
+    void set_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse)
+    {
       dendrites[kth_dendrite].connect (n, nth_synapse);
+    }
 
-      n->connect_synapse (nth_synapse, this, kth_dendrite);
+    bool is_synapse_connected (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < synapses.size () and synapses[nth_synapse].is_connected ();
     }
 
-    virtual void disconnect_synapse (Connector::size_type nth_synapse)
+    bool is_dendrite_connected (Connector::size_type kth_dendrite) const
     {
-      if (nth_synapse > synapses.size ()) return;
+      return kth_dendrite < dendrites.size () and dendrites[kth_dendrite].is_connected ();
+    }
 
-      SynapseType & s = synapses[nth_synapse];
+    const NeuronBase * synapse_target (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < synapses.size () ? synapses[nth_synapse].get_neuron () : 0;
+    }
 
-      if (s.is_connected ())
-      {
-        NeuronBase * n = s.get_neuron ();
-        Connector::size_type dendrite = s.get_nth ();
+    Connector::size_type synapse_dendrite (Connector::size_type nth_synapse) const { return synapses[nth_synapse].get_nth (); }
 
-        s.disconnect ();
+    virtual size_t sizeof_feedback () const { return sizeof (SynapseSignalType); }
 
-        n->disconnect_dendrite (dendrite);
-      }
+    const NeuronBase * dendrite_source (Connector::size_type kth_dendrite) const
+    {
+      return kth_dendrite < dendrites.size () ? dendrites[kth_dendrite].get_neuron () : 0;
     }
 
-    void disconnect_dendrite (Connector::size_type kth_dendrite)
-    {
-      if (kth_dendrite > dendrites.size ()) return;
+    Connector::size_type dendrite_synapse (Connector::size_type kth_dendrite) const { return dendrites[kth_dendrite].get_nth (); }
 
-      DendriteType & d = dendrites[kth_dendrite];
+    virtual size_t sizeof_input () const { return sizeof (DendriteSignalType); }
 
-      if (d.is_connected ())
-      {
-        NeuronBase * n = d.get_neuron ();
-        Connector::size_type synapse = d.get_nth ();
+    virtual __uint64_t state_hash () const
+    {
+      __uint64_t h = nn_hash_bytes (&state, sizeof (NeuronState));
 
-        d.disconnect ();
+      for (typename Dendrites::size_type i = 0; i < dendrites.size (); i++) h = nn_hash_bytes (&dendrites[i].get_state (), sizeof (DendriteState), h);
 
-        n->disconnect_synapse (synapse);
-      }
+      return h;
+    }
 
+    virtual void report_memory (MemoryReport & report) const
+    {
+      report.neuron_objects += sizeof (Neuron);
+      report.connectors_heap += dendrites.allocated () + synapses.allocated ();
+      report.connectors_used += dendrites.size () * sizeof (DendriteType) + synapses.size () * sizeof (SynapseType);
+      report.states += sizeof_state ();
+      report.heap_blocks += 1 + dendrites.is_spilled () + synapses.is_spilled ();
+
+      for (typename Dendrites::size_type i = 0; i < dendrites.size (); i++) report.functors += dendrites[i].functor_size ();
+      for (typename Synapses::size_type i = 0; i < synapses.size (); i++) report.functors += synapses[i].functor_size ();
     }
 
-    virtual PropagatorBase & propagator (PropagatorBase * ptr) { return propagator_factory.create (ptr, *this); }
-    virtual size_t sizeof_propagator () const { return propagator_factory.sizeof_propagator (); }
-    virtual void propagate (Connector::size_type nth, void * store) const { synapses[nth].propagate (state, (SynapseSignalType *)store); }
-    virtual void backpropagate (Connector::size_type nth, void * store) const { dendrites[nth].backpropagate (state, (DendriteSignalType *)store); }
+    virtual size_t sizeof_state () const { return sizeof (NeuronState) + dendrites.size () * sizeof (DendriteState); }
 
-    virtual void report_connections () const
+    virtual void save_state (void * buffer) const
     {
-      typename Dendrites::size_type nd = n_dendrites ();
-      typename Synapses::size_type  ns = n_synapses ();
+      char * p = (char *)buffer;
 
-      std::cerr << "Neuron " << id () << ": " << nd << " dendrites and " << ns << " synapses\n";
+      memcpy (p, &state, sizeof (NeuronState));
+      p += sizeof (NeuronState);
 
-      for (typename Dendrites::size_type i = 0; i < nd; i++)
-      {
-        const DendriteType & d = dendrites[i];
+      for (typename Dendrites::size_type i = 0; i < dendrites.size (); i++, p += sizeof (DendriteState))
+        memcpy (p, &dendrites[i].get_state (), sizeof (DendriteState));
+    }
 
-        if (d.is_connected ())
-          std::cerr << "\tDendrite " << i << " connected to synapse " << d.get_nth () << " of Neuron " << d.get_neuron ()->id () << std::endl;
-        else
-          std::cerr << "\tDendrite " << i << " not connected" << std::endl;
-      }
+    virtual void load_state (const void * buffer)
+    {
+      const char * p = (const char *)buffer;
 
-      for (typename Synapses::size_type i = 0; i < ns; i++)
-      {
-        const SynapseType & s = synapses[i];
+      memcpy (&state, p, sizeof (NeuronState));
+      p += sizeof (NeuronState);
 
-        if (s.is_connected ())
-          std::cerr << "\tSynapse " << i << " connected to dendrite " << s.get_nth () << " of Neuron " << s.get_neuron ()->id () << std::endl;
-        else
-          std::cerr << "\tSynapse " << i << " not connected" << std::endl;
-      }
+      for (typename Dendrites::size_type i = 0; i < dendrites.size (); i++, p += sizeof (DendriteState))
+        memcpy (&dendrites[i].get_state (), p, sizeof (DendriteState));
+    }
 
-      std::cerr << std::endl;
+    virtual PropagatorBase & propagator (PropagatorBase * ptr) { return propagator_factory.create (ptr, *this); }
+    virtual size_t sizeof_propagator () const { return propagator_factory.sizeof_propagator (); }
+    virtual void propagate (Connector::size_type nth, void * store) const { synapses[nth].propagate (state, (SynapseSignalType *)store); }
+    virtual void backpropagate (Connector::size_type nth, void * store) const { dendrites[nth].backpropagate (state, (DendriteSignalType *)store); }
+
+    virtual void backpropagate_dendrites (const size_t * offsets, char * store) const
+    {
+      for (typename Dendrites::size_type k = 0; k < dendrites.size (); k++)
+        if (offsets[k] != (size_t)-1) dendrites[k].backpropagate (state, (DendriteSignalType *)(store + offsets[k]));
     }
 
+    virtual void report_connections () const { nn_report_connections (*this, dendrites, synapses); }
+
   private:
 
     NeuronState state;
@@ -264,21 +371,19 @@ template <class NeuronFunctor> class Neuron : public NeuronBase
     };
 
     static NeuronFactory factory;
-    static PropagatorFactory<Propagator<NeuronFunctor> > propagator_factory;
+    static PropagatorFactory<Propagator<NeuronFunctor>, Neuron> propagator_factory;
 };
 
 
-template <class NeuronFunctor>
-typename Neuron<NeuronFunctor>::NeuronFactory Neuron<NeuronFunctor>::factory;
+template <class NeuronFunctor, size_t InlineConnectors>
+typename Neuron<NeuronFunctor, InlineConnectors>::NeuronFactory Neuron<NeuronFunctor, InlineConnectors>::factory;
 
-template <class NeuronFunctor>
-PropagatorFactory<Propagator<NeuronFunctor> > Neuron<NeuronFunctor>::propagator_factory;
+template <class NeuronFunctor, size_t InlineConnectors>
+PropagatorFactory<Propagator<NeuronFunctor>, Neuron<NeuronFunctor, InlineConnectors> > Neuron<NeuronFunctor, InlineConnectors>::propagator_factory;
 
-template <class PropagatorType>
-PropagatorBase & PropagatorFactory<PropagatorType>::create (PropagatorBase * ptr, NeuronBase & n) const
+template <class PropagatorType, class NeuronType>
+PropagatorBase & PropagatorFactory<PropagatorType, NeuronType>::create (PropagatorBase * ptr, NeuronBase & n) const
 {
-  typedef Neuron<NeuronFunctorType> NeuronType;
-
   NeuronType & neuron = static_cast<NeuronType &> (n);
   return *new (ptr) PropagatorType (neuron.get_dendrites (), neuron.get_synapses (), neuron.get_state ());
 }
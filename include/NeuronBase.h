@@ -22,26 +22,47 @@
 #define NEURONBASE_H_
 
 #include <sys/types.h>
+#include <atomic>
+#include "MemoryReport.h"
 
-#define NN_FLAG_IN_QUEUE_ALREADY 0b0000000000000001 // 1 = neuron has already been added to the update queue.
-                                                    //     This flag should be set when one of the dendrites
-                                                    //     received a new input and AQ was 0. At that time
-                                                    //     the neuron should have been added to the update queue.
-                                                    //     If subsequent dendrites receive new values the flag
-                                                    //     stays set and nothing else needs to be done about
-                                                    //     recomputing the neuron's state.
-                                                    // 0 = neuron has not been inserted into the update queue.
-#define NN_FLAG_IN_BPQUE_ALREADY 0b0000000000000010 // 1 = neuron has already been added to the back-propaga-
-                                                    //     tion queue
-                                                    // 0 = neuron has not yet been added to the back-propaga-
-                                                    //     tion queue
-#define NN_FLAG_DO_BCK_PROPAGATE 0b0000000000000100 // 0 = neuron will back propagate only if its value has changed
+#define NN_FLAG_DO_BCK_PROPAGATE 0b00000100 // 0 = neuron will back propagate only if its value has changed
                                                     // 1 = neuron will back propagate the signal regardless.
 
 
 
 class PropagatorBase;
 
+
+// 64 bit FNV-1a hash of a memory block. Used for hashing neurons' states.
+inline __uint64_t nn_hash_bytes (const void * p, size_t n, __uint64_t h = 14695981039346656037ULL)
+{
+  const unsigned char * b = (const unsigned char *)p;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    h ^= b[i];
+    h *= 1099511628211ULL;
+  }
+
+  return h;
+}
+
+// Small integers identifying the neuron classes, assigned on first use. Tag 0 is left for
+// the classes which don't set any.
+inline __uint16_t nn_next_type_tag ()
+{
+  static std::atomic<__uint16_t> counter (0);
+
+  return ++counter;
+}
+
+template <class NeuronType> __uint16_t nn_type_tag ()
+{
+  static const __uint16_t tag = nn_next_type_tag ();
+
+  return tag;
+}
+
 // The base class and abstract interface for a Neuron that is exposed to
 // the NeuralNetwork class and to the programmer. All Neuron implementations must implement virtual
 // methods listed here
@@ -51,10 +72,16 @@ class NeuronBase
   public:
 
     friend class NeuralNetwork;
+    friend class SpmvBackendBase;
 
     NeuronBase ()
     {
-      flags = 0b0000000000000000;
+      flags = 0b00000000;
+      in_queue = 0;
+      in_bp_queue = 0;
+      dirty = 1;
+      state_version = 0;
+      type_tag = 0;
       neuron_id = neuron_counter;
       neuron_counter++;
     }
@@ -65,34 +92,132 @@ class NeuronBase
     virtual void connect_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse) = 0;
     virtual void disconnect_synapse (Connector::size_type nth_synapse) = 0;
     virtual void disconnect_dendrite (Connector::size_type kth_dendrite) = 0;
+
+    // Make only this neuron's side of the connection, without touching the neuron on the
+    // other end. Used by NeuralNetwork's bulk connect, which sets both sides separately.
+    virtual void set_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite) = 0;
+    virtual void set_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse) = 0;
+    virtual bool is_synapse_connected (Connector::size_type nth_synapse) const = 0;
+    virtual bool is_dendrite_connected (Connector::size_type kth_dendrite) const = 0;
+
+    // Neuron connected to the given synapse, or 0 if the synapse is not connected.
+    virtual const NeuronBase * synapse_target (Connector::size_type nth_synapse) const = 0;
+
+    // Dendrite of synapse_target () the synapse is connected to.
+    virtual Connector::size_type synapse_dendrite (Connector::size_type nth_synapse) const { return 0; }
+
+    // Neuron connected to the given dendrite, or 0 if the dendrite is not connected.
+    virtual const NeuronBase * dendrite_source (Connector::size_type kth_dendrite) const { return 0; }
+
+    // Synapse of dendrite_source () the dendrite is connected to.
+    virtual Connector::size_type dendrite_synapse (Connector::size_type kth_dendrite) const { return 0; }
+
+    // Size of the signal received by the neuron's dendrites, or 0 if the neuron's propagator
+    // can't take the input read in advance (see NeuralNetwork::set_gather_apply_scatter ()).
+    virtual size_t sizeof_input () const { return 0; }
+
+    // Size of the feedback signal received by the neuron's synapses, or 0 if the neuron's
+    // propagator can't take the feedback read in advance (see NeuralNetwork::set_feedback_index ()).
+    virtual size_t sizeof_feedback () const { return 0; }
+
     virtual Connector::size_type n_synapses () const = 0;
     virtual Connector::size_type n_dendrites () const = 0;
     virtual void add_dendrite () = 0;
     virtual void add_synapse () = 0;
     virtual unsigned long int size () = 0;
 
-    virtual __uint32_t id () const { return neuron_id; }
+    // Neurons created by a NeuralNetwork are numbered by their position within it, others
+    // in the order of their creation.
+    virtual nn_id_t id () const { return neuron_id; }
     virtual void report_connections () const = 0;
 
+    // Hash of the neuron's state and its dendrites' states, used by NeuralNetwork for
+    // detecting steady states and limit cycles. Neuron templates hash the raw bytes of the
+    // states, so neurons whose states contain pointers or padding should override it.
+    virtual __uint64_t state_hash () const { return 0; }
+
+    // Serialisation of the neuron's state together with the states of its dendrites, used by
+    // NeuralNetwork's checkpoints. Neuron templates copy the raw bytes of the states, so any
+    // data kept by the functors themselves is not included. Neurons without a state of their
+    // own return 0.
+    virtual size_t sizeof_state () const { return 0; }
+    virtual void save_state (void * buffer) const {}
+    virtual void load_state (const void * buffer) {}
+
+    // Counter incremented by the network every time it recomputes the neuron or backpropagates
+    // through it. Lets the neurons connected to it tell whether its state may have changed
+    // since they last read it (see IncrementalNeuron).
+    __uint32_t version () const { return state_version; }
+
+    // Tag of the neuron's class, used by NeuralNetwork to group the neurons of the same
+    // class within the update queues (see NeuralNetwork::set_type_bucketing ()).
+    __uint16_t type () const { return type_tag; }
+
+    // Add the memory taken by the neuron to the report. The default implementation knows
+    // only what size () tells.
+    virtual void report_memory (MemoryReport & report) const
+    {
+      report.neuron_objects += const_cast<NeuronBase *> (this)->size ();
+      report.heap_blocks++;
+    }
+
+    // Mark the neuron as changed since the last checkpoint. The network does that whenever
+    // it recomputes the neuron or backpropagates through it; the user has to do it after
+    // modifying the neuron's state directly.
+    void mark_dirty () { dirty = 1; }
+
     virtual PropagatorBase & propagator (PropagatorBase * ptr) = 0;
     virtual size_t sizeof_propagator () const = 0;
     virtual void propagate (Connector::size_type nth, void * store) const = 0;
     virtual void backpropagate (Connector::size_type nth, void * store) const = 0;
 
-  private:
+    // Backpropagate all the dendrites at once, the kth into store + offsets[k], skipping the
+    // dendrites whose offset is (size_t)-1. Used by NeuralNetwork's feedback index.
+    virtual void backpropagate_dendrites (const size_t * offsets, char * store) const
+    {
+      Connector::size_type nd = n_dendrites ();
 
-    __uint16_t flags;
-    __uint32_t neuron_id;
+      for (Connector::size_type k = 0; k < nd; k++)
+        if (offsets[k] != (size_t)-1) backpropagate (k, store + offsets[k]);
+    }
 
-    static __uint32_t neuron_counter;
+  protected:
+
+    // To be called by the constructors of the neuron classes, the most derived one last.
+    void set_type_tag (__uint16_t t) { type_tag = t; }
+
+  private:
 
-    bool in_update_queue_already () const { return flags & NN_FLAG_IN_QUEUE_ALREADY; }
-    void set_in_update_queue (bool v) { if (v) flags |= NN_FLAG_IN_QUEUE_ALREADY; else flags &= ~NN_FLAG_IN_QUEUE_ALREADY; }
-    bool in_bp_update_queue_already () const { return flags & NN_FLAG_IN_BPQUE_ALREADY; }
-    void set_in_bp_update_queue (bool v) { if (v) flags |= NN_FLAG_IN_BPQUE_ALREADY; else flags &= ~NN_FLAG_IN_BPQUE_ALREADY; }
+    __uint8_t flags;
+
+    // The update queue membership markers are kept in separate bytes rather than as bits
+    // of flags, so that the forward and backpropagation phases, which may run on different
+    // threads (see NeuralNetwork::set_pipelined ()), never write the same memory location.
+
+    __uint8_t in_queue;    // 1 = neuron has already been added to the update queue.
+                           //     This flag should be set when one of the dendrites
+                           //     received a new input and AQ was 0. At that time
+                           //     the neuron should have been added to the update queue.
+                           //     If subsequent dendrites receive new values the flag
+                           //     stays set and nothing else needs to be done about
+                           //     recomputing the neuron's state.
+                           // 0 = neuron has not been inserted into the update queue.
+    __uint8_t in_bp_queue; // 1 = neuron has already been added to the back-propagation queue
+                           // 0 = neuron has not yet been added to the back-propagation queue
+    __uint8_t dirty;       // 1 = neuron's or its dendrites' state may have changed since the last checkpoint
+    __uint32_t state_version;
+    __uint16_t type_tag;
+    nn_id_t neuron_id;
+
+    static nn_id_t neuron_counter;
+
+    bool in_update_queue_already () const { return in_queue; }
+    void set_in_update_queue (bool v) { in_queue = v; }
+    bool in_bp_update_queue_already () const { return in_bp_queue; }
+    void set_in_bp_update_queue (bool v) { in_bp_queue = v; }
 };
 
-typedef std::vector<NeuronBase *> NeuronVector;
+typedef std::vector<NeuronBase *, NN_ALLOCATOR(NeuronBase *)> NeuronVector;
 
 
 #endif /* NEURONBASE_H_ */
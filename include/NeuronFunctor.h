@@ -61,6 +61,26 @@ template <class DendriteFunctor, class NeuronState, class SynapseFunctor> class
 };
 
 
+/*
+ * Variant of NeuronFunctor for neurons whose dendrites and synapses share a single, static
+ * instance of their functors (see SharedDendriteBase and SharedSynapseBase). Deriving the
+ * user's neuron functor from this template instead of NeuronFunctor is all that's needed to
+ * switch the neuron type to the compact connectors. Per-dendrite data has to be kept in the
+ * DendriteStateType then.
+ */
+template <class DendriteFunctor, class NeuronState, class SynapseFunctor>
+class SharedNeuronFunctor : public NeuronFunctor<DendriteFunctor, NeuronState, SynapseFunctor>
+{
+  public:
+
+    typedef SharedDendriteBase<DendriteFunctor> DendriteType;
+    typedef SharedSynapseBase<SynapseFunctor>   SynapseType;
+
+    SharedNeuronFunctor () {}
+    virtual ~SharedNeuronFunctor () {}
+};
+
+
 
 
 /* The base class for PropagatorBase class. Its main purpose
@@ -85,6 +105,15 @@ class PropagatorBase
     virtual bool backpropagate () = 0;
     virtual bool should_backpropagate () = 0;
 
+    // Same as backpropagate (), but with the feedback of the connected synapses, one signal
+    // for each in their order, already read into the array (see NeuralNetwork::set_feedback_index ()).
+    virtual bool backpropagate_feedback (const void * feedback) { return backpropagate (); }
+
+    // Same as operator (), but with the signals of the connected dendrites' source neurons,
+    // one for each dendrite in their order, already read into the array (see
+    // NeuralNetwork::set_gather_apply_scatter ()).
+    virtual bool recompute_inputs (const void * inputs) { return (*this) (); }
+
     virtual NeuronBase * first_synapse () = 0;
     virtual NeuronBase * next_synapse () = 0;
 
@@ -133,6 +162,23 @@ template <class NeuronFunctor> class Propagator : public PropagatorBase
       return neuron_functor.propagate (neuron_state);
     }
 
+    virtual bool recompute_inputs (const void * inputs)
+    {
+      const typename DendriteType::SignalType * f = (const typename DendriteType::SignalType *)inputs;
+      size_type i = 0;
+
+      for (DendriteType * d = dendrites.first (); d != dendrites.null (); d = dendrites.next ())
+      {
+        if (d->is_connected ())
+          if (d->process_input_signal (neuron_state, *f++))
+            neuron_functor.process_input (i, d->get_state (), d->propagate (neuron_state));
+
+        i++;
+      }
+
+      return neuron_functor.propagate (neuron_state);
+    }
+
     virtual bool backpropagate ()
     {
       size_type i = 0;
@@ -149,6 +195,23 @@ template <class NeuronFunctor> class Propagator : public PropagatorBase
       return neuron_functor.backpropagate (neuron_state);
     }
 
+    virtual bool backpropagate_feedback (const void * feedback)
+    {
+      const typename SynapseType::SignalType * f = (const typename SynapseType::SignalType *)feedback;
+      size_type i = 0;
+
+      for (SynapseType * s = synapses.first (); s != synapses.null (); s = synapses.next ())
+      {
+        if (s->is_connected ())
+          if (s->process_feedback_signal (neuron_state, *f++))
+            neuron_functor.process_feedback (i, s->backpropagate (neuron_state));
+
+        i++;
+      }
+
+      return neuron_functor.backpropagate (neuron_state);
+    }
+
     virtual bool should_backpropagate ()
     {
       return neuron_functor.should_backpropagate (neuron_state);
@@ -0,0 +1,250 @@
+/* OutputSink.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef OUTPUTSINK_H_
+#define OUTPUTSINK_H_
+
+#include <sys/types.h>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "Connector.h"
+
+
+/*
+ * Interface of the output sink exposed to NeuralNetwork, which notifies the sink about
+ * the beginning and the end of each iteration of run ().
+ */
+class OutputSinkBase
+{
+  public:
+
+    OutputSinkBase () {}
+    virtual ~OutputSinkBase () {}
+
+    virtual void begin_iteration (unsigned long int iteration) = 0;
+    virtual void end_iteration () = 0;
+};
+
+
+/*
+ * Output sink receiving the states of terminal neurons as they fire. Each terminal neuron
+ * is given its own slot in the sink when created.
+ */
+template <class State> class OutputSink : public OutputSinkBase
+{
+  public:
+
+    OutputSink () : n_slots (0) {}
+    virtual ~OutputSink () {}
+
+    virtual size_t add_slot () { return n_slots++; }
+    size_t slots () const { return n_slots; }
+
+    virtual void emit (size_t slot, nn_id_t neuron_id, const State & value) = 0;
+
+  protected:
+
+    size_t n_slots;
+};
+
+
+template <class State> struct OutputRecord
+{
+    nn_id_t           neuron_id;
+    unsigned long int iteration;
+    State             value;
+};
+
+
+/*
+ * Sink appending one OutputRecord per firing of a terminal neuron to a lock-free single
+ * producer, single consumer ring. The network is the producer; a consumer thread drains
+ * the records with pop () or drain () while the network keeps running. If the ring is full
+ * the records are dropped rather than stalling the network and are counted by dropped ().
+ */
+template <class State> class RecordSink : public OutputSink<State>
+{
+  public:
+
+    typedef OutputRecord<State> Record;
+
+    // Capacity of 0 is taken as 1.
+    RecordSink (size_t capacity) : ring (capacity ? capacity : 1), head (0), tail (0), n_dropped (0), iteration (0) {}
+    virtual ~RecordSink () {}
+
+    virtual void begin_iteration (unsigned long int i) { iteration = i; }
+    virtual void end_iteration () {}
+
+    virtual void emit (size_t slot, nn_id_t neuron_id, const State & value)
+    {
+      size_t t = tail.load (std::memory_order_relaxed);
+
+      if (t - head.load (std::memory_order_acquire) == ring.size ())
+      {
+        n_dropped.fetch_add (1, std::memory_order_relaxed);
+        return;
+      }
+
+      Record & r = ring[t % ring.size ()];
+
+      r.neuron_id = neuron_id;
+      r.iteration = iteration;
+      r.value = value;
+
+      tail.store (t + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Returns false if there is no record to be read.
+    bool pop (Record & r)
+    {
+      size_t h = head.load (std::memory_order_relaxed);
+
+      if (h == tail.load (std::memory_order_acquire)) return false;
+
+      r = ring[h % ring.size ()];
+
+      head.store (h + 1, std::memory_order_release);
+
+      return true;
+    }
+
+    // Consumer side. Reads up to n records into out and returns the number of records read.
+    size_t drain (Record * out, size_t n)
+    {
+      size_t h = head.load (std::memory_order_relaxed);
+      size_t t = tail.load (std::memory_order_acquire);
+      size_t k = 0;
+
+      for (; k < n and h != t; k++, h++) out[k] = ring[h % ring.size ()];
+
+      head.store (h, std::memory_order_release);
+
+      return k;
+    }
+
+    unsigned long int dropped () const { return n_dropped.load (std::memory_order_relaxed); }
+
+  private:
+
+    std::vector<Record> ring;
+
+    std::atomic<size_t> head; // next record to be read by the consumer
+    std::atomic<size_t> tail; // next record to be written by the network
+    std::atomic<unsigned long int> n_dropped;
+
+    unsigned long int iteration;
+};
+
+
+/*
+ * Sink collecting the values of all its terminal neurons into dense frames, one frame per
+ * iteration in which any of them fired. Slots of the neurons which didn't fire keep their
+ * previous values. Frames are passed to the consumer thread through a lock-free single
+ * producer, single consumer ring of n_frames frames; the consumer reads the oldest one with
+ * front () and releases it with pop (). Frames that don't fit in the ring are dropped.
+ * All the terminal neurons must be created before the network is run.
+ */
+template <class State> class FrameSink : public OutputSink<State>
+{
+  public:
+
+    // Ring of 0 frames is taken as 1.
+    FrameSink (size_t n) : n_frames (n ? n : 1), head (0), tail (0), n_dropped (0), iteration (0), changed (false) {}
+    virtual ~FrameSink () {}
+
+    virtual size_t add_slot ()
+    {
+      working.push_back (State ());
+
+      return OutputSink<State>::add_slot ();
+    }
+
+    virtual void begin_iteration (unsigned long int i) { iteration = i; }
+
+    virtual void emit (size_t slot, nn_id_t neuron_id, const State & value)
+    {
+      working[slot] = value;
+      changed = true;
+    }
+
+    virtual void end_iteration ()
+    {
+      if (not changed) return;
+
+      changed = false;
+
+      size_t t = tail.load (std::memory_order_relaxed);
+
+      if (t - head.load (std::memory_order_acquire) == n_frames)
+      {
+        n_dropped.fetch_add (1, std::memory_order_relaxed);
+        return;
+      }
+
+      if (frames.empty ())
+      {
+        frames.resize (n_frames * working.size ());
+        iterations.resize (n_frames);
+      }
+
+      size_t f = t % n_frames;
+
+      std::copy (working.begin (), working.end (), frames.begin () + f * working.size ());
+      iterations[f] = iteration;
+
+      tail.store (t + 1, std::memory_order_release);
+    }
+
+    // Consumer side. Returns the oldest frame not yet released, or 0 if there is none.
+    const State * front (unsigned long int & frame_iteration) const
+    {
+      size_t h = head.load (std::memory_order_relaxed);
+
+      if (h == tail.load (std::memory_order_acquire)) return 0;
+
+      frame_iteration = iterations[h % n_frames];
+
+      return &frames[(h % n_frames) * working.size ()];
+    }
+
+    // Consumer side. Releases the frame returned by front ().
+    void pop () { head.fetch_add (1, std::memory_order_release); }
+
+    unsigned long int dropped () const { return n_dropped.load (std::memory_order_relaxed); }
+
+  private:
+
+    size_t n_frames;
+
+    std::vector<State> frames;
+    std::vector<unsigned long int> iterations;
+
+    std::atomic<size_t> head; // oldest frame not yet released by the consumer
+    std::atomic<size_t> tail; // next frame to be written by the network
+    std::atomic<unsigned long int> n_dropped;
+
+    std::vector<State> working; // values of the terminal neurons during the current iteration
+    unsigned long int iteration;
+    bool changed;
+};
+
+
+#endif /* OUTPUTSINK_H_ */
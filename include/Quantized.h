@@ -0,0 +1,492 @@
+/* Quantized.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef QUANTIZED_H_
+#define QUANTIZED_H_
+
+#include <sys/types.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+#include <algorithm>
+#include "libnn.h"
+
+
+/*
+ * Reduced precision storage types for dendrite and neuron states. Float16 (IEEE 754 half
+ * precision) and BFloat16 (the upper half of a float) convert implicitly to and from float,
+ * so they can simply replace double or float members of the states. Int8Scaled keeps
+ * a signed byte which has to be multiplied by a scale factor, shared by all the dendrites
+ * of a neuron and kept in the neuron's state (see QuantizationScale).
+ * All three offer get (scale) and set (value, scale) used by QuantizedDendriteFunctor;
+ * the 16 bit types ignore the scale. Conversions round to nearest even.
+ */
+
+class Float16
+{
+  public:
+
+    Float16 () : bits (0) {}
+    Float16 (float f) : bits (from_float (f)) {}
+
+    operator float () const { return to_float (bits); }
+
+    float get (float scale) const { return to_float (bits); }
+    void set (float v, float scale) { bits = from_float (v); }
+
+    static __uint16_t from_float (float f)
+    {
+      const __uint32_t f16_max = (127 + 16) << 23;    // smallest float rounding to infinity
+      const __uint32_t f32_infinity = 255 << 23;
+      const __uint32_t denormal_magic = ((127 - 15) + (23 - 10) + 1) << 23;
+
+      __uint32_t u;
+
+      memcpy (&u, &f, sizeof (u));
+
+      __uint32_t sign = u & 0x80000000u;
+      __uint16_t h;
+
+      u ^= sign;
+
+      if (u >= f16_max)
+        h = u > f32_infinity ? 0x7e00 : 0x7c00;      // NaN or infinity
+      else if (u < (113 << 23))
+      {
+        // Result is subnormal or zero. Adding the magic number shifts the mantissa into
+        // place, the FPU doing the rounding.
+        float a, m;
+
+        memcpy (&a, &u, sizeof (a));
+        memcpy (&m, &denormal_magic, sizeof (m));
+
+        a += m;
+
+        memcpy (&u, &a, sizeof (u));
+
+        h = u - denormal_magic;
+      }
+      else
+      {
+        __uint32_t odd = (u >> 13) & 1;
+
+        u += ((15 - 127) << 23) + 0xfff + odd;
+
+        h = u >> 13;
+      }
+
+      return h | (sign >> 16);
+    }
+
+    static float to_float (__uint16_t h)
+    {
+      const __uint32_t shifted_exponent = 0x7c00 << 13;
+      const __uint32_t magic = 113 << 23;
+
+      __uint32_t u = (h & 0x7fff) << 13;
+      __uint32_t exponent = u & shifted_exponent;
+      float f;
+
+      u += (127 - 15) << 23;
+
+      if (exponent == shifted_exponent)
+        u += (128 - 16) << 23;                       // infinity or NaN
+      else if (exponent == 0)
+      {
+        float m;
+
+        u += 1 << 23;                                // zero or subnormal, renormalised by the FPU
+        memcpy (&f, &u, sizeof (f));
+        memcpy (&m, &magic, sizeof (m));
+        f -= m;
+        memcpy (&u, &f, sizeof (u));
+      }
+
+      u |= (__uint32_t)(h & 0x8000) << 16;
+
+      memcpy (&f, &u, sizeof (f));
+
+      return f;
+    }
+
+  private:
+
+    __uint16_t bits;
+};
+
+
+class BFloat16
+{
+  public:
+
+    BFloat16 () : bits (0) {}
+    BFloat16 (float f) : bits (from_float (f)) {}
+
+    operator float () const { return to_float (bits); }
+
+    float get (float scale) const { return to_float (bits); }
+    void set (float v, float scale) { bits = from_float (v); }
+
+    static __uint16_t from_float (float f)
+    {
+      __uint32_t u;
+
+      memcpy (&u, &f, sizeof (u));
+
+      if ((u & 0x7fffffff) > 0x7f800000) return (u >> 16) | 0x40; // keep NaN a NaN
+
+      return (u + 0x7fff + ((u >> 16) & 1)) >> 16;
+    }
+
+    static float to_float (__uint16_t b)
+    {
+      __uint32_t u = (__uint32_t)b << 16;
+      float f;
+
+      memcpy (&f, &u, sizeof (f));
+
+      return f;
+    }
+
+  private:
+
+    __uint16_t bits;
+};
+
+
+class Int8Scaled
+{
+  public:
+
+    Int8Scaled () : q (0) {}
+
+    float get (float scale) const { return q * scale; }
+
+    void set (float v, float scale)
+    {
+      float r = scale > 0.0f ? nearbyintf (v / scale) : 0.0f;
+
+      q = r > 127.0f ? 127 : r < -127.0f ? -127 : (__int8_t)r;
+    }
+
+    __int8_t raw () const { return q; }
+
+  private:
+
+    __int8_t q;
+};
+
+
+/*
+ * Neuron states of neurons whose dendrites keep Int8Scaled states should be derived from
+ * this class. The scale is set by nn_quantize_states () from the largest magnitude among
+ * the neuron's dendrite states. Until then, and for neuron states without a scale, the
+ * dendrite states cover [-1, 1] in steps of 1/127.
+ */
+struct QuantizationScale
+{
+    static constexpr float initial = 1.0f / 127.0f;
+
+    float scale;
+
+    QuantizationScale () : scale (initial) {}
+};
+
+template <class NeuronState>
+typename std::enable_if<std::is_base_of<QuantizationScale, NeuronState>::value, float>::type
+nn_quantization_scale (const NeuronState & s) { return s.scale; }
+
+template <class NeuronState>
+typename std::enable_if<not std::is_base_of<QuantizationScale, NeuronState>::value, float>::type
+nn_quantization_scale (const NeuronState & s) { return QuantizationScale::initial; }
+
+// Set the scale of the neuron state, if it has one. Returns false if it doesn't.
+template <class NeuronState>
+typename std::enable_if<std::is_base_of<QuantizationScale, NeuronState>::value, bool>::type
+nn_set_quantization_scale (NeuronState & s, float scale) { s.scale = scale; return true; }
+
+template <class NeuronState>
+typename std::enable_if<not std::is_base_of<QuantizationScale, NeuronState>::value, bool>::type
+nn_set_quantization_scale (NeuronState & s, float scale) { return false; }
+
+
+
+/*
+ * Adapter making a DendriteFunctor written for full precision state (float or double)
+ * keep its state in one of the reduced precision types above. Every call dequantises
+ * the state, passes it to the wrapped functor and, if the functor changed it, quantises
+ * it back, so the functor's code stays the same. The neuron functor sees Storage as its
+ * DendriteStateType.
+ * The adapter only changes the type of the state; it is the PackedDendriteBase of
+ * QuantizedNeuronFunctor that makes the dendrites smaller.
+ */
+template <class Functor, class Storage> class QuantizedDendriteFunctor
+{
+  public:
+
+    typedef typename Functor::NeuronStateType   NeuronStateType;
+    typedef typename Functor::SignalType        SignalType;
+    typedef Storage                             DendriteStateType;
+    typedef typename Functor::DendriteStateType FullStateType;
+
+    QuantizedDendriteFunctor () : functor () {}
+    virtual ~QuantizedDendriteFunctor () {}
+
+    virtual void init_state (DendriteStateType & state) const
+    {
+      FullStateType v;
+
+      functor.init_state (v);
+      state.set (v, nn_quantization_scale (NeuronStateType ()));
+    }
+
+    virtual bool process_input (const NeuronStateType & neuron_state, DendriteStateType & state, SignalType & signal)
+    {
+      float scale = nn_quantization_scale (neuron_state);
+      FullStateType v = state.get (scale);
+      FullStateType old = v;
+
+      bool r = functor.process_input (neuron_state, v, signal);
+
+      if (v != old) state.set (v, scale);
+
+      return r;
+    }
+
+    virtual bool process_feedback (const NeuronStateType & neuron_state, DendriteStateType & state)
+    {
+      float scale = nn_quantization_scale (neuron_state);
+      FullStateType v = state.get (scale);
+      FullStateType old = v;
+
+      bool r = functor.process_feedback (neuron_state, v);
+
+      if (v != old) state.set (v, scale);
+
+      return r;
+    }
+
+    virtual SignalType propagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const
+    {
+      return functor.propagate (neuron_state, FullStateType (state.get (nn_quantization_scale (neuron_state))));
+    }
+
+    virtual SignalType backpropagate (const NeuronStateType & neuron_state, const DendriteStateType & state) const
+    {
+      return functor.backpropagate (neuron_state, FullStateType (state.get (nn_quantization_scale (neuron_state))));
+    }
+
+    virtual unsigned long int size () { return functor.size (); }
+
+  private:
+
+    Functor functor;
+};
+
+
+
+/*
+ * Dendrite of the neurons whose functor is derived from QuantizedNeuronFunctor. Like
+ * SharedDendriteBase it shares one static functor among all the dendrites of its type and
+ * has no virtual methods; besides, it keeps the index of the source neuron's synapse in 32
+ * bits, so that with a 16 or 8 bit state the whole dendrite takes 16 bytes, against 40 of
+ * a DendriteBase and 24 of a SharedDendriteBase with a double state. A neuron's dendrites
+ * lie next to each other in its SmallVector, so the weights are read together with the
+ * connections at 16 bytes per input.
+ * The source neurons must have less than 4G synapses.
+ */
+template <class Functor> class PackedDendriteBase
+{
+  public:
+
+    typedef Connector::size_type                size_type;
+    typedef typename Functor::NeuronStateType   NeuronStateType;
+    typedef typename Functor::SignalType        SignalType;
+    typedef typename Functor::DendriteStateType DendriteStateType;
+
+    PackedDendriteBase () : neuron (0), nth (0) { functor.init_state (state); }
+
+    void connect (NeuronBase * n, size_type i)
+    {
+      neuron = n;
+      nth = i;
+    }
+
+    void disconnect ()
+    {
+      neuron = 0;
+      nth = 0;
+    }
+
+    const NeuronBase * get_neuron () const { return neuron; }
+    NeuronBase * get_neuron () { return neuron; }
+    size_type get_nth () const { return nth; }
+
+    bool is_connected () const { return neuron != 0; }
+    bool is_connected (const NeuronBase * n) const { return neuron == n; }
+    bool is_connected (const NeuronBase * n, size_type i) const { return neuron == n and nth == i; }
+
+    bool process_input (const NeuronStateType & neuron_state)
+    {
+      if (not is_connected ()) return false;
+
+      SignalType store;
+
+      neuron->propagate (nth, &store);
+
+      return functor.process_input (neuron_state, state, store);
+    }
+
+    bool process_input_signal (const NeuronStateType & neuron_state, const SignalType & signal)
+    {
+      SignalType store = signal;
+
+      return functor.process_input (neuron_state, state, store);
+    }
+
+    bool process_feedback (const NeuronStateType & neuron_state) { return functor.process_feedback (neuron_state, state); }
+
+    SignalType propagate (const NeuronStateType & neuron_state) const { return functor.propagate (neuron_state, state); }
+
+    void backpropagate (const NeuronStateType & neuron_state, SignalType * store) const
+    {
+      *store = functor.backpropagate (neuron_state, state);
+    }
+
+    const DendriteStateType & get_state () const { return state; }
+    DendriteStateType & get_state () { return state; }
+
+    unsigned long int functor_size () const { return 0; }
+
+    static Functor functor;
+
+  private:
+
+    NeuronBase * neuron;
+    __uint32_t nth;
+    DendriteStateType state;
+};
+
+template <class Functor> Functor PackedDendriteBase<Functor>::functor;
+
+
+/*
+ * Variant of NeuronFunctor for neurons keeping their dendrite states in Storage (Float16,
+ * BFloat16 or Int8Scaled) in PackedDendriteBase dendrites. DendriteFunctor is the full
+ * precision functor, wrapped in QuantizedDendriteFunctor; since it is shared by all the
+ * dendrites, per-dendrite data has to be kept in its state. Deriving the user's neuron
+ * functor from this template instead of NeuronFunctor is all that's needed.
+ */
+template <class DendriteFunctor, class Storage, class NeuronState, class SynapseFunctor>
+class QuantizedNeuronFunctor : public NeuronFunctor<QuantizedDendriteFunctor<DendriteFunctor, Storage>, NeuronState, SynapseFunctor>
+{
+  public:
+
+    typedef PackedDendriteBase<QuantizedDendriteFunctor<DendriteFunctor, Storage> > DendriteType;
+
+    QuantizedNeuronFunctor () {}
+    virtual ~QuantizedNeuronFunctor () {}
+};
+
+
+
+/*
+ * Copy the states of the full precision network ref into the network q of the same topology
+ * and neuron states, whose dendrites use QuantizedDendriteFunctor. Neurons are matched by
+ * their index; those that aren't RefNeuron in ref or QNeuron in q are skipped. Int8Scaled
+ * states get the scale of their neuron set so that the largest magnitude maps to 127.
+ */
+template <class RefNeuron, class QNeuron> void nn_quantize_states (const NeuralNetwork & ref, NeuralNetwork & q)
+{
+  NeuronVector::size_type n = std::min (ref.neurons_count (), q.neurons_count ());
+
+  for (NeuronVector::size_type i = 0; i < n; i++)
+  {
+    RefNeuron * r = dynamic_cast<RefNeuron *> (ref.neuron (i));
+    QNeuron * qn = dynamic_cast<QNeuron *> (q.neuron (i));
+
+    if (r == 0 or qn == 0) continue;
+
+    typename RefNeuron::DendriteIterator rd = r->get_dendrites ();
+    typename QNeuron::DendriteIterator qd = qn->get_dendrites ();
+    typename RefNeuron::DendriteIterator::size_type nd = std::min (rd.numof (), qd.numof ());
+
+    qn->get_state () = r->get_state ();
+
+    float max = 0.0f;
+
+    for (typename RefNeuron::DendriteIterator::size_type k = 0; k < nd; k++)
+      max = std::max (max, (float)fabs (rd[k].get_state ()));
+
+    float scale = max > 0.0f ? max / 127.0f : 1.0f;
+
+    if (not nn_set_quantization_scale (qn->get_state (), scale)) scale = nn_quantization_scale (qn->get_state ());
+
+    for (typename RefNeuron::DendriteIterator::size_type k = 0; k < nd; k++)
+      qd[k].get_state ().set (rd[k].get_state (), scale);
+
+    qn->mark_dirty ();
+  }
+}
+
+
+/*
+ * Result of nn_compare_states ().
+ */
+struct QuantizationError
+{
+    double max_abs;   // largest absolute difference
+    double rms;       // root mean square of the differences
+    size_t n_neurons; // number of neurons compared
+};
+
+/*
+ * Accuracy check of a reduced precision network against its full precision reference,
+ * typically after running both from the same starting point. value extracts a number
+ * from the neuron state of either type.
+ */
+template <class RefNeuron, class QNeuron, class Value>
+QuantizationError nn_compare_states (const NeuralNetwork & ref, const NeuralNetwork & q, Value value)
+{
+  QuantizationError e = { 0.0, 0.0, 0 };
+  NeuronVector::size_type n = std::min (ref.neurons_count (), q.neurons_count ());
+
+  for (NeuronVector::size_type i = 0; i < n; i++)
+  {
+    RefNeuron * r = dynamic_cast<RefNeuron *> (ref.neuron (i));
+    QNeuron * qn = dynamic_cast<QNeuron *> (q.neuron (i));
+
+    if (r == 0 or qn == 0) continue;
+
+    double d = fabs ((double)value (r->get_state ()) - (double)value (qn->get_state ()));
+
+    e.max_abs = std::max (e.max_abs, d);
+    e.rms += d * d;
+    e.n_neurons++;
+  }
+
+  if (e.n_neurons) e.rms = sqrt (e.rms / e.n_neurons);
+
+  return e;
+}
+
+
+#endif /* QUANTIZED_H_ */
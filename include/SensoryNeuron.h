@@ -0,0 +1,327 @@
+/* SensoryNeuron.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef SENSORYNEURON_H_
+#define SENSORYNEURON_H_
+
+#include <atomic>
+#include <new>
+#include "Neuron.h"
+
+
+/*
+ * Interface of the sensory input exposed to NeuralNetwork. The input is also the factory of
+ * its sensory neurons, each call to create () making the neuron for the next input slot.
+ */
+class SensoryInputBase : public NeuronFactoryBase
+{
+  public:
+
+    SensoryInputBase () {}
+    virtual ~SensoryInputBase () {}
+
+    virtual size_t n_inputs () const = 0;
+
+    // Called by the network at the beginning of each iteration. If a new frame has been
+    // published since the last call, switch to it and append to changed the sensory neurons
+    // whose values differ from the previous frame. Returns true if the frame was switched.
+    virtual bool poll (NeuronVector & changed) = 0;
+};
+
+
+/*
+ * Ring of input frames living in memory owned by the caller. A frame holds one value of type
+ * State for each input slot and the buffer must have room for n_frames such frames (at least
+ * two). The producer thread asks for the frame to be filled with frame_to_write (), writes the
+ * values directly into it and then calls publish (). Sensory neurons read their values directly
+ * from the frame currently used by the network, so the values are never copied. The network
+ * always switches to the most recently published frame, skipping those it didn't manage to
+ * consume in time. The slot of the frame used by the network is never handed out to the
+ * producer. The initial contents of the first frame are the inputs' values before anything is
+ * published.
+ * One producer thread and one network are supported.
+ */
+template <class SynapseFunctor> class SensoryInput : public SensoryInputBase
+{
+  public:
+
+    typedef typename SynapseFunctor::NeuronStateType State;
+
+    SensoryInput (State * buf, size_t n, size_t f) : buffer (buf), n_slots (n), n_frames (f),
+                                                     published (0), in_use (0), min_synapses (1), max_synapses (1)
+    {
+      neurons.reserve (n_slots);
+    }
+
+    virtual ~SensoryInput () {}
+
+    virtual size_t n_inputs () const { return n_slots; }
+
+    // Producer side. Returns the frame to be filled next, or 0 if the ring is full.
+    State * frame_to_write ()
+    {
+      unsigned long int next = published.load (std::memory_order_relaxed) + 1;
+
+      if (next - in_use.load (std::memory_order_acquire) >= n_frames) return 0;
+
+      return frame (next);
+    }
+
+    // Producer side. Makes the frame returned by frame_to_write () visible to the network.
+    void publish () { published.fetch_add (1, std::memory_order_release); }
+
+    // Values currently seen by the network.
+    const State * current () const { return frame (in_use.load (std::memory_order_relaxed)); }
+
+    virtual bool poll (NeuronVector & changed)
+    {
+      unsigned long int p = published.load (std::memory_order_acquire);
+      unsigned long int u = in_use.load (std::memory_order_relaxed);
+
+      if (p == u) return false;
+
+      const State * old_values = frame (u);
+      const State * new_values = frame (p);
+
+      for (size_t i = 0; i < neurons.size (); i++)
+        if (new_values[i] != old_values[i]) changed.push_back (neurons[i]);
+
+      in_use.store (p, std::memory_order_release);
+
+      return true;
+    }
+
+    // Number of synapses given to the sensory neurons created by the argument-less create ().
+    void set_synapses_range (unsigned int min_s, unsigned int max_s) { min_synapses = min_s; max_synapses = max_s; }
+
+    virtual NeuronBase * create ()
+    {
+      return create (0, min_synapses + (max_synapses > min_synapses ? rand () % (max_synapses - min_synapses + 1) : 0));
+    }
+
+    virtual NeuronBase * create (unsigned int n_dendrites, unsigned int n_synapses);
+
+  private:
+
+    State * frame (unsigned long int seq) const { return buffer + (seq % n_frames) * n_slots; }
+
+    State * buffer;
+    size_t n_slots;
+    size_t n_frames;
+
+    std::atomic<unsigned long int> published; // sequence number of the last published frame
+    std::atomic<unsigned long int> in_use;    // sequence number of the frame used by the network
+
+    unsigned int min_synapses;
+    unsigned int max_synapses;
+
+    NeuronVector neurons; // sensory neurons in the order of their input slots
+};
+
+
+
+/*
+ * Propagator of the sensory neuron. Sensory neuron fires whenever its input changes, so
+ * the recomputation always succeeds, and it has no dendrites to backpropagate to.
+ */
+template <class SynapseFunctor> class SensoryPropagator : public PropagatorBase
+{
+  public:
+
+    typedef SynapseBase<SynapseFunctor>               SynapseType;
+    typedef typename SynapseFunctor::NeuronStateType  NeuronState;
+    typedef ConnectorIterator<SynapseType>            Synapses;
+
+    SensoryPropagator (Synapses s, const NeuronState & ns) : synapses (s), neuron_state (ns) {}
+    virtual ~SensoryPropagator () {}
+
+    virtual bool operator () () { return true; }
+
+    virtual bool backpropagate ()
+    {
+      NeuronState state = neuron_state;
+
+      for (SynapseType * s = synapses.first (); s != synapses.null (); s = synapses.next ())
+        if (s->is_connected ())
+          s->process_feedback (state);
+
+      return false;
+    }
+
+    virtual bool should_backpropagate () { return false; }
+
+    virtual NeuronBase * first_synapse ()
+    {
+      for (SynapseType * s = synapses.first (); s != synapses.null (); s = synapses.next ())
+        if (s->is_connected ())
+          if (s->process_output (neuron_state))
+            return s->get_neuron ();
+
+      return 0;
+    }
+
+    virtual NeuronBase * next_synapse ()
+    {
+      for (SynapseType * s = synapses.next (); s != synapses.null (); s = synapses.next ())
+        if (s->is_connected ())
+          if (s->process_output (neuron_state))
+            return s->get_neuron ();
+
+      return 0;
+    }
+
+    virtual NeuronBase * first_dendrite () { return 0; }
+    virtual NeuronBase * next_dendrite () { return 0; }
+
+  protected:
+
+    Synapses synapses;
+    const NeuronState & neuron_state;
+};
+
+
+
+/*
+ * Input neuron of the network. It has synapses only and its state is the value of its slot
+ * within the current frame of the SensoryInput it was created by.
+ */
+template <class SynapseFunctor> class SensoryNeuron : public NeuronBase
+{
+  public:
+
+    typedef SynapseBase<SynapseFunctor>               SynapseType;
+    typedef typename SynapseFunctor::NeuronStateType  NeuronState;
+    typedef typename SynapseType::SignalType          SynapseSignalType;
+    typedef SmallVector<SynapseType>                  Synapses;
+    typedef ConnectorIterator<SynapseType>            SynapseIterator;
+    typedef SensoryPropagator<SynapseFunctor>         PropagatorType;
+
+    SensoryNeuron (const SensoryInput<SynapseFunctor> & in, size_t s, unsigned int n_synapses) : input (in),
+                                                                                                slot (s),
+                                                                                                synapses (n_synapses)
+    {
+      set_type_tag (nn_type_tag<SensoryNeuron> ());
+    }
+    virtual ~SensoryNeuron () {}
+
+    virtual Connector::size_type n_synapses () const { return synapses.size (); }
+    virtual Connector::size_type n_dendrites () const { return 0; }
+
+    virtual void add_dendrite () {}
+    virtual void add_synapse () { synapses.push_back (SynapseType ()); }
+
+    unsigned long int size () { return sizeof (SensoryNeuron) + synapses.allocated (); }
+
+    SynapseIterator get_synapses () { return SynapseIterator (synapses); }
+    const NeuronState & get_state () const { return input.current ()[slot]; }
+
+  protected:
+
+    void connect_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
+    {
+      nn_connect_synapse (this, synapses, nth_synapse, n, kth_dendrite);
+    }
+
+    void connect_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse) {}
+
+    void disconnect_synapse (Connector::size_type nth_synapse) { nn_disconnect_synapse (synapses, nth_synapse); }
+
+    void disconnect_dendrite (Connector::size_type kth_dendrite) {}
+
+    void set_synapse (Connector::size_type nth_synapse, NeuronBase * n, Connector::size_type kth_dendrite)
+    {
+      synapses[nth_synapse].connect (n, kth_dendrite);
+    }
+
+    void set_dendrite (Connector::size_type kth_dendrite, NeuronBase * n, Connector::size_type nth_synapse) {}
+
+    bool is_synapse_connected (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < synapses.size () and synapses[nth_synapse].is_connected ();
+    }
+
+    bool is_dendrite_connected (Connector::size_type kth_dendrite) const { return false; }
+
+    const NeuronBase * synapse_target (Connector::size_type nth_synapse) const
+    {
+      return nth_synapse < synapses.size () ? synapses[nth_synapse].get_neuron () : 0;
+    }
+
+    Connector::size_type synapse_dendrite (Connector::size_type nth_synapse) const { return synapses[nth_synapse].get_nth (); }
+
+    virtual void report_memory (MemoryReport & report) const
+    {
+      report.neuron_objects += sizeof (SensoryNeuron);
+      report.connectors_heap += synapses.allocated ();
+      report.connectors_used += synapses.size () * sizeof (SynapseType);
+      report.heap_blocks += 1 + synapses.is_spilled ();
+
+      for (typename Synapses::size_type i = 0; i < synapses.size (); i++) report.functors += synapses[i].functor_size ();
+    }
+
+    virtual __uint64_t state_hash () const { return nn_hash_bytes (&get_state (), sizeof (NeuronState)); }
+
+    virtual PropagatorBase & propagator (PropagatorBase * ptr) { return *new (ptr) PropagatorType (get_synapses (), get_state ()); }
+    virtual size_t sizeof_propagator () const { return sizeof (PropagatorType); }
+    virtual void propagate (Connector::size_type nth, void * store) const { synapses[nth].propagate (get_state (), (SynapseSignalType *)store); }
+    virtual void backpropagate (Connector::size_type nth, void * store) const {}
+
+    virtual void report_connections () const
+    {
+      typename Synapses::size_type ns = n_synapses ();
+
+      std::cerr << "Sensory neuron " << id () << " (input " << slot << "): " << ns << " synapses\n";
+
+      for (typename Synapses::size_type i = 0; i < ns; i++)
+      {
+        const SynapseType & s = synapses[i];
+
+        if (s.is_connected ())
+          std::cerr << "\tSynapse " << i << " connected to dendrite " << s.get_nth () << " of Neuron " << s.get_neuron ()->id () << std::endl;
+        else
+          std::cerr << "\tSynapse " << i << " not connected" << std::endl;
+      }
+
+      std::cerr << std::endl;
+    }
+
+  private:
+
+    const SensoryInput<SynapseFunctor> & input;
+    size_t slot;
+
+    Synapses synapses;
+};
+
+
+template <class SynapseFunctor>
+NeuronBase * SensoryInput<SynapseFunctor>::create (unsigned int n_dendrites, unsigned int n_synapses)
+{
+  if (neurons.size () == n_slots) return 0;
+
+  NeuronBase * n = new SensoryNeuron<SynapseFunctor> (*this, neurons.size (), n_synapses);
+
+  neurons.push_back (n);
+
+  return n;
+}
+
+
+#endif /* SENSORYNEURON_H_ */
@@ -0,0 +1,200 @@
+/* SmallVector.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef SMALLVECTOR_H_
+#define SMALLVECTOR_H_
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+#include "MemoryReport.h"
+
+
+// Number of connectors (dendrites or synapses) stored directly within the neuron object.
+// Neurons with more connections than that keep them in a separately allocated array, and
+// the inline slots stay unused, so the default is none. Networks made mostly of neurons
+// with a few connections save a heap block per connector list with the capacity set to
+// about their degree, at compile time or per neuron class (see Neuron).
+#ifndef NN_CONNECTOR_INLINE_CAPACITY
+#define NN_CONNECTOR_INLINE_CAPACITY 0
+#endif
+
+
+/*
+ * Inline storage of SmallVector. Without inline elements it takes no space at all, leaving
+ * SmallVector the size of a std::vector.
+ */
+template <class T, size_t N> class SmallVectorStorage
+{
+  protected:
+
+    T * inline_items () { return reinterpret_cast<T *> (&storage); }
+    const T * inline_items () const { return reinterpret_cast<const T *> (&storage); }
+
+  private:
+
+    typename std::aligned_storage<N * sizeof (T), alignof (T)>::type storage;
+};
+
+template <class T> class SmallVectorStorage<T, 0>
+{
+  protected:
+
+    T * inline_items () { return 0; }
+    const T * inline_items () const { return 0; }
+};
+
+
+/*
+ * Minimal vector-like container with inline storage for the first N elements. Used by
+ * Neuron to hold its dendrites and synapses, most neurons having only a handful of those.
+ * Only when the number of elements exceeds N they are moved to the heap, growing the
+ * capacity by half each time it is exhausted.
+ * The elements are stored contiguously in both cases, so iterators are plain pointers.
+ */
+
+template <class T, size_t N = NN_CONNECTOR_INLINE_CAPACITY> class SmallVector : private SmallVectorStorage<T, N>
+{
+    using SmallVectorStorage<T, N>::inline_items;
+
+  public:
+
+    typedef T         value_type;
+    typedef size_t    size_type;
+    typedef T *       iterator;
+    typedef const T * const_iterator;
+
+    SmallVector () : items (inline_items ()), n_items (0), n_capacity (N) {}
+
+    explicit SmallVector (size_type n) : items (inline_items ()), n_items (0), n_capacity (N)
+    {
+      reserve (n);
+
+      for (; n_items < n; n_items++) new (items + n_items) T ();
+    }
+
+    SmallVector (const SmallVector & v) : items (inline_items ()), n_items (0), n_capacity (N)
+    {
+      reserve (v.n_items);
+
+      for (; n_items < v.n_items; n_items++) new (items + n_items) T (v.items[n_items]);
+    }
+
+    ~SmallVector ()
+    {
+      clear ();
+
+      if (is_spilled ()) deallocate (items, n_capacity);
+    }
+
+    SmallVector & operator = (const SmallVector & v)
+    {
+      if (this != &v)
+      {
+        clear ();
+        reserve (v.n_items);
+
+        for (; n_items < v.n_items; n_items++) new (items + n_items) T (v.items[n_items]);
+      }
+
+      return *this;
+    }
+
+    size_type size () const { return n_items; }
+    size_type capacity () const { return n_capacity; }
+    bool empty () const { return n_items == 0; }
+
+    // True if the elements were moved out of the inline storage to the heap.
+    bool is_spilled () const { return items != inline_items (); }
+
+    // Number of bytes allocated on the heap (zero as long as the elements fit inline).
+    size_type allocated () const { return is_spilled () ? n_capacity * sizeof (T) : 0; }
+
+    iterator begin () { return items; }
+    iterator end () { return items + n_items; }
+    const_iterator begin () const { return items; }
+    const_iterator end () const { return items + n_items; }
+
+    T & operator [] (size_type i) { return items[i]; }
+    const T & operator [] (size_type i) const { return items[i]; }
+
+    void push_back (const T & v)
+    {
+      if (n_items == n_capacity)
+      {
+        T copy (v); // v may be one of the elements reserve () is about to move
+
+        reserve (n_capacity + (n_capacity >> 1) + 1);
+        new (items + n_items) T (copy);
+      }
+      else
+        new (items + n_items) T (v);
+
+      n_items++;
+    }
+
+    void reserve (size_type n)
+    {
+      if (n <= n_capacity) return;
+
+      T * p = allocate (n);
+
+      for (size_type i = 0; i < n_items; i++)
+      {
+        new (p + i) T (items[i]);
+        items[i].~T ();
+      }
+
+      if (is_spilled ()) deallocate (items, n_capacity);
+
+      items = p;
+      n_capacity = n;
+    }
+
+    void clear ()
+    {
+      for (size_type i = 0; i < n_items; i++) items[i].~T ();
+
+      n_items = 0;
+    }
+
+    // Destroy the elements and free the heap storage, if any, going back to the inline one.
+    void release ()
+    {
+      clear ();
+
+      if (is_spilled ()) deallocate (items, n_capacity);
+
+      items = inline_items ();
+      n_capacity = N;
+    }
+
+  private:
+
+    static T * allocate (size_type n) { return NN_ALLOCATOR(T) ().allocate (n); }
+    static void deallocate (T * p, size_type n) { NN_ALLOCATOR(T) ().deallocate (p, n); }
+
+    T * items;
+    size_type n_items;
+    size_type n_capacity;
+};
+
+
+#endif /* SMALLVECTOR_H_ */
@@ -0,0 +1,294 @@
+/* SpmvBackend.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef SPMVBACKEND_H_
+#define SPMVBACKEND_H_
+
+#include <vector>
+#include <unordered_map>
+#include "libnn.h"
+
+
+// When at least 1 / NN_SPMV_DENSE_FRACTION of the neurons is to be recomputed the backend
+// sorts them first, so that their rows are read in the order of the matrix.
+#ifndef NN_SPMV_DENSE_FRACTION
+#define NN_SPMV_DENSE_FRACTION 8
+#endif
+
+// Number of blocks of the out-of-core matrix requested ahead of the one being computed.
+#ifndef NN_SPMV_PREFETCH_BLOCKS
+#define NN_SPMV_PREFETCH_BLOCKS 4
+#endif
+
+
+class BlockStore;
+
+/*
+ * Out-of-core mode of SpmvBackend. The matrix (weights, columns and the synapses' targets)
+ * is written to the file in blocks of block_rows consecutive rows as it is extracted from the
+ * network and only cache_blocks blocks are kept in memory. Each iteration loads the blocks
+ * holding the rows of the frontier in their order, each block once, reading the next ones
+ * in the background while the current one is computed, and the blocks of the following
+ * frontier are requested as soon as it is known. The file is overwritten.
+ * The dendrites still hold the weights in memory until SpmvBackend::release_dendrites () is
+ * called, after which only the neurons' states and synapses are kept in core.
+ */
+struct SpmvPaging
+{
+    const char * filename;
+    size_t block_rows;
+    size_t cache_blocks;
+};
+
+
+/*
+ * Type independent part of SpmvBackend: the weight matrix in CSR form (a row for each
+ * neuron, a column for each neuron feeding it, in the order of the dendrites), the lists of
+ * neurons each neuron's synapses lead to (in the order of the synapses), and the iteration
+ * itself, run on the network's update queue.
+ */
+class SpmvBackendBase
+{
+  public:
+
+    SpmvBackendBase (NeuralNetwork & nn, unsigned int n_threads, const SpmvPaging * paging);
+    virtual ~SpmvBackendBase ();
+
+    // False if the network contains neurons the backend can't handle, or in the out-of-core
+    // mode if the file could not be written or read. run () does nothing then.
+    bool is_valid () const { return valid; }
+
+    // One iteration: take the stimuli injected into the network, recompute the neurons of its
+    // update queue and queue the neurons their synapses lead to, if they fire.
+    void run ();
+
+    // Run up to n iterations, stopping earlier if the network quiesces: no neuron is queued
+    // and no stimulus waits. Topology changes aren't applied by the backend, so those still
+    // waiting don't count. Returns the number of iterations performed.
+    unsigned long int run_n (unsigned long int n);
+
+    // Whether the last iteration read the rows in order, its frontier being large enough.
+    // In the out-of-core mode: whether it needed every block.
+    bool was_dense () const { return dense; }
+
+    size_t n_rows () const { return rows.size (); }
+    size_t n_weights () const { return row_begin.back (); }
+
+    bool is_paged () const { return store != 0; }
+
+    // Number of blocks read from the file in the out-of-core mode.
+    unsigned long int blocks_read () const;
+
+    // Read-only access to the matrix for running it on signals kept elsewhere (see Ensemble).
+    // Not available in the out-of-core mode.
+    NeuronBase * neuron (size_t row) const { return rows[row]; }
+
+    // Weights of the row and the rows they apply to.
+    const double * row_weights (size_t row, const size_t * & columns, size_t & n) const
+    {
+      n = row_begin[row + 1] - row_begin[row];
+      columns = this->columns.data () + row_begin[row];
+
+      return weights.data () + row_begin[row];
+    }
+
+    // Rows the synapses of the row lead to.
+    const size_t * row_targets (size_t row, size_t & n) const
+    {
+      n = target_begin[row + 1] - target_begin[row];
+
+      return targets.data () + target_begin[row];
+    }
+
+  protected:
+
+    // Called by the derived class' constructor once the rows are added.
+    void add_row (NeuronBase * n);
+
+    // The weights are given row by row, between begin_weights () and build ().
+    void begin_weights ();
+    void add_weight (const NeuronBase * source, double weight); // of the dendrite connected to source
+    void end_row ();
+    void build ();
+
+    virtual double signal (size_t row) = 0;              // what the neuron's synapses deliver
+    virtual bool activate (size_t row, double sum) = 0;   // recompute the neuron from the weighted sum
+
+    NeuralNetwork & network;
+    unsigned int n_threads;
+    bool valid;
+    bool dendrites_released; // the matrix is the only copy of the weights
+
+    std::vector<NeuronBase *> rows;
+
+  private:
+
+    void multiply (const size_t * list, size_t n, const double * weights, const size_t * columns, size_t base);
+    void activate_rows (const size_t * list, size_t n, const size_t * targets, size_t base);
+    void flush_block ();
+    void run_paged ();
+    void prefetch_frontier ();
+
+    std::unordered_map<const NeuronBase *, size_t> row_of;
+
+    // CSR: weights of row r are at [row_begin[r], row_begin[r + 1]). In the out-of-core mode
+    // the vectors hold only the block being written.
+    std::vector<size_t> row_begin;
+    std::vector<size_t> columns;
+    std::vector<double> weights;
+
+    std::vector<size_t> target_begin; // targets of row r's synapses at [target_begin[r], target_begin[r + 1])
+    std::vector<size_t> targets;
+
+    BlockStore * store;
+    size_t block_rows;
+    size_t prefetch_blocks;
+    size_t weights_written; // number of weights and targets already in the file
+    size_t targets_written;
+    std::vector<char> block_buffer;
+
+    std::vector<double> x; // current signals of the neurons
+    std::vector<double> y; // weighted sums
+    std::vector<size_t> active;
+    std::vector<char> fired;
+    std::vector<size_t> pending; // targets of the neurons that fired
+    NeuronVector injected;       // neurons whose state the stimuli set
+    bool dense;
+};
+
+
+// Default extraction of the weight from the dendrite's state.
+template <class DendriteState> double nn_spmv_weight (const DendriteState & s) { return s; }
+
+
+/*
+ * Execution backend for networks of weighted sum neurons, running the iterations as sparse
+ * matrix-vector products over a weight matrix extracted from the dendrites' states.
+ * It applies to networks all of whose neurons are NeuronType, where
+ * - every synapse of a neuron delivers the same signal and always passes it on,
+ * - the dendrite functor always accepts the input and passes on the signal multiplied by
+ *   its weight (as extracted by the weight function),
+ * - the neuron functor adds up the signals given to its process_input () and computes the
+ *   new state from the sum in propagate (),
+ * - the network does no backpropagation.
+ * The neuron functor is given the whole weighted sum through a single process_input () call
+ * before propagate (). The sums are computed in double, in the order of the dendrites, so
+ * they come out exactly as in the object based path when the dendrite signals and the sum
+ * the functor keeps are double too; with narrower types they differ by the rounding of the
+ * products and partial sums. The backend computes all the neurons of the frontier from the
+ * signals of the previous iteration though, whereas run () lets neurons see the new states
+ * of the neurons recomputed earlier within the same pass, so the results are the same only
+ * as long as no neuron is queued together with a neuron feeding it.
+ * The weights are read when the backend is created; the topology must not change afterwards
+ * and update_weights () has to be called after the weights are changed.
+ * With paging given the matrix is kept out of core (see SpmvPaging); the neurons themselves
+ * and a few numbers per neuron stay in memory, the dendrites too unless they are released.
+ */
+template <class NeuronType> class SpmvBackend : public SpmvBackendBase
+{
+  public:
+
+    typedef typename NeuronType::NeuronFunctorType   NeuronFunctor;
+    typedef typename NeuronType::NeuronState         NeuronState;
+    typedef typename NeuronType::DendriteState       DendriteState;
+    typedef typename NeuronType::SynapseSignalType   SynapseSignalType;
+    typedef typename NeuronType::DendriteIterator    DendriteIterator;
+
+    typedef double (* WeightFunction) (const DendriteState & state);
+
+    SpmvBackend (NeuralNetwork & nn, WeightFunction w = nn_spmv_weight<DendriteState>, unsigned int n_threads = 0,
+                 const SpmvPaging * paging = 0) :
+      SpmvBackendBase (nn, n_threads, paging), weight (w)
+    {
+      for (NeuronVector::size_type i = 0; i < nn.neurons_count (); i++)
+      {
+        NeuronBase * n = nn.neuron (i);
+
+        if (n->type () != nn_type_tag<NeuronType> ()) valid = false;
+
+        add_row (n);
+      }
+
+      if (valid) update_weights ();
+    }
+
+    virtual ~SpmvBackend () {}
+
+    void update_weights ()
+    {
+      if (dendrites_released) return;
+
+      begin_weights ();
+
+      for (size_t r = 0; r < rows.size (); r++)
+      {
+        DendriteIterator d = static_cast<NeuronType *> (rows[r])->get_dendrites ();
+
+        for (typename DendriteIterator::size_type k = 0; k < d.numof (); k++)
+          if (d[k].is_connected ()) add_weight (d[k].get_neuron (), weight (d[k].get_state ()));
+
+        end_row ();
+      }
+
+      build ();
+    }
+
+    // Free the dendrites of all the neurons, the backend's matrix holding their weights from
+    // then on. With the matrix out of core this leaves the neurons' states and synapses (and
+    // the dendrites kept inline in the neuron objects) as the only part of the network in
+    // memory. Afterwards the network may be run only through the backend, its topology must
+    // not change and update_weights () does nothing. Needs NeuronType::release_dendrites ().
+    void release_dendrites ()
+    {
+      if (not valid or dendrites_released) return;
+
+      for (size_t r = 0; r < rows.size (); r++) static_cast<NeuronType *> (rows[r])->release_dendrites ();
+
+      dendrites_released = true;
+    }
+
+  protected:
+
+    virtual double signal (size_t row)
+    {
+      SynapseSignalType s = SynapseSignalType ();
+
+      if (rows[row]->n_synapses ()) rows[row]->propagate (0, &s);
+
+      return s;
+    }
+
+    virtual bool activate (size_t row, double sum)
+    {
+      NeuronFunctor functor;
+
+      functor.process_input (0, DendriteState (), sum);
+
+      return functor.propagate (static_cast<NeuronType *> (rows[row])->get_state ());
+    }
+
+  private:
+
+    WeightFunction weight;
+};
+
+
+#endif /* SPMVBACKEND_H_ */
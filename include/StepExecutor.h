@@ -0,0 +1,97 @@
+/* StepExecutor.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef STEPEXECUTOR_H_
+#define STEPEXECUTOR_H_
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include "libnn.h"
+
+
+// Default number of neurons a network recomputes or backpropagates before StepExecutor
+// switches to the next network.
+#ifndef NN_STEP_CHUNK
+#define NN_STEP_CHUNK 4096
+#endif
+
+
+/*
+ * Runs many networks on a small pool of threads. Each submitted network is advanced by
+ * NeuralNetwork::step () a chunk of neurons at a time, after which the thread moves on to the
+ * next network waiting in the queue, so a network with a large frontier doesn't hold up the
+ * others for more than one chunk (save for the pipelined networks and the forward
+ * propagations of the gather-apply-scatter engine, see NeuralNetwork::step ()). The result of the run is delivered through the returned
+ * future once the network quiesces, performs the requested number of iterations, exceeds
+ * its time budget or is cancelled.
+ * A network must not be submitted again, or used in any other way, until its future is
+ * ready. The deadline and cancellation are checked between chunks, so a network may be left
+ * in the middle of an iteration; the next run () or step () completes it.
+ */
+class StepExecutor
+{
+  public:
+
+    StepExecutor (unsigned int n_threads = 1, size_t chunk = NN_STEP_CHUNK);
+    ~StepExecutor (); // cancels all the runs not yet finished
+
+    std::future<RunStatus> submit (NeuralNetwork & nn, unsigned long int max_iterations, double time_budget = 0.0);
+
+    // Stop the run of the network at the end of its current chunk. The future then
+    // reports RUN_CANCELLED. Does nothing if the network is not being run.
+    void cancel (NeuralNetwork & nn);
+
+    // Number of runs not yet finished.
+    size_t pending ();
+
+  private:
+
+    struct Task
+    {
+        NeuralNetwork * network;
+        unsigned long int remaining; // iterations yet to be performed
+        bool has_deadline;
+        std::chrono::steady_clock::time_point deadline;
+        bool cancelled;
+        std::promise<RunStatus> result;
+    };
+
+    void work ();
+    bool advance (Task & task, RunStatus & status);
+
+    size_t chunk;
+
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Task *> queue; // runs waiting for their next chunk
+    std::vector<Task *> runs; // all the runs not yet finished
+    bool stopping;
+
+    std::vector<std::thread> workers;
+};
+
+
+#endif /* STEPEXECUTOR_H_ */
@@ -0,0 +1,159 @@
+/* StimulusQueue.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef STIMULUSQUEUE_H_
+#define STIMULUSQUEUE_H_
+
+#include <atomic>
+#include <type_traits>
+#include <string.h>
+#include "Connector.h"
+#include "NeuronBase.h"
+#include "IntrusiveQueue.h"
+
+
+// Largest neuron state a stimulus can carry, in bytes.
+#ifndef NN_STIMULUS_STATE_SIZE
+#define NN_STIMULUS_STATE_SIZE 64
+#endif
+
+
+class StimulusPool;
+
+/*
+ * Event passed to the network by NeuralNetwork::inject (): the neuron, identified by its
+ * index within the network, is to be recomputed, or set to the state the stimulus carries.
+ * Stimuli come from a StimulusPool and the network gives them back to it once applied.
+ */
+class Stimulus
+{
+  public:
+
+    // Sets the neuron's state to the one given, if the neuron is of the right class.
+    typedef bool (* ApplyFunction) (NeuronBase & n, const void * state);
+
+    Stimulus () : index (0), apply (0), pool (0), next (0) {}
+
+    // True if the stimulus sets the neuron's state, which is then propagated to the neurons
+    // its synapses lead to rather than recomputed.
+    bool has_state () const { return apply != 0; }
+
+    // Called on the network's thread. Returns false if the stimulus doesn't apply to the
+    // neuron, which is left alone then.
+    bool apply_to (NeuronBase & n) const { return apply == 0 or apply (n, &state); }
+
+    template <class NeuronType> void set_state (const typename NeuronType::NeuronState & s)
+    {
+      typedef typename NeuronType::NeuronState NeuronState;
+
+      static_assert (sizeof (NeuronState) <= NN_STIMULUS_STATE_SIZE, "neuron state larger than NN_STIMULUS_STATE_SIZE");
+      static_assert (std::is_trivially_copyable<NeuronState>::value, "neuron state not trivially copyable");
+
+      memcpy (&state, &s, sizeof (NeuronState));
+      apply = apply_state<NeuronType>;
+    }
+
+    // Give the stimulus back to its pool.
+    inline void release ();
+
+    NeuronVector::size_type index;
+    ApplyFunction apply;          // 0 = the neuron is recomputed
+    StimulusPool * pool;
+    std::atomic<Stimulus *> next; // used by IntrusiveQueue
+
+  private:
+
+    template <class NeuronType> static bool apply_state (NeuronBase & n, const void * s)
+    {
+      if (n.type () != nn_type_tag<NeuronType> ()) return false;
+
+      memcpy (&static_cast<NeuronType &> (n).get_state (), s, sizeof (typename NeuronType::NeuronState));
+
+      return true;
+    }
+
+    typename std::aligned_storage<NN_STIMULUS_STATE_SIZE>::type state;
+};
+
+
+/*
+ * Queue of the stimuli injected into the network. Stimuli left in it go back to their pools.
+ */
+typedef IntrusiveQueue<Stimulus, IntrusiveRelease<Stimulus> > StimulusQueue;
+
+
+/*
+ * Preallocated stimuli of one producer thread, so that injecting doesn't allocate. The
+ * producer takes stimuli with get () and the network returns them once applied, through a
+ * lock-free queue, so the pool may be used by one producer thread and any number of networks
+ * at a time. It must outlive the stimuli it gave out: destroy it only after the networks took
+ * them, or were destroyed themselves.
+ */
+class StimulusPool
+{
+  public:
+
+    StimulusPool (size_t n) : stimuli (new Stimulus[n]), n_stimuli (n)
+    {
+      for (size_t i = 0; i < n; i++)
+      {
+        stimuli[i].pool = this;
+        free.push (&stimuli[i]);
+      }
+    }
+
+    ~StimulusPool ()
+    {
+      while (not free.is_empty ()) free.pop ();
+
+      delete [] stimuli;
+    }
+
+    // Producer side. Returns a stimulus, or 0 if all of them are waiting to be applied.
+    Stimulus * get ()
+    {
+      Stimulus * s = free.pop ();
+
+      if (s) s->apply = 0;
+
+      return s;
+    }
+
+    // Network side.
+    void put (Stimulus * s) { free.push (s); }
+
+    size_t size () const { return n_stimuli; }
+
+  private:
+
+    StimulusPool (const StimulusPool &);
+    StimulusPool & operator = (const StimulusPool &);
+
+    Stimulus * stimuli;
+    size_t n_stimuli;
+    IntrusiveQueue<Stimulus, IntrusiveKeep<Stimulus> > free; // the stimuli belong to the array
+};
+
+
+inline void Stimulus::release () { pool->put (this); }
+
+
+#endif /* STIMULUSQUEUE_H_ */
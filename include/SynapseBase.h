@@ -116,6 +116,12 @@ template <class Functor> class SynapseBase : public Connector
       return false;
     }
 
+    // Same as process_feedback (), with the feedback signal already read.
+    virtual bool process_feedback_signal (NeuronStateType & neuron_state, const SignalType & feedback)
+    {
+      return functor.process_feedback (neuron_state, feedback);
+    }
+
     virtual void propagate (const NeuronStateType & neuron_state, SignalType * store) const
     {
       *store = functor.propagate (neuron_state);
@@ -126,6 +132,9 @@ template <class Functor> class SynapseBase : public Connector
       return functor.backpropagate (neuron_state);
     }
 
+    // Heap data of the functor, as reported by its size ().
+    unsigned long int functor_size () const { return const_cast<Functor &> (functor).size (); }
+
   private :
 
     Functor functor;
@@ -133,4 +142,68 @@ template <class Functor> class SynapseBase : public Connector
 
 
 
+/*
+ * Lightweight variant of SynapseBase sharing one static Functor instance among all
+ * synapses of the given type. It has no virtual methods and no per-synapse data besides
+ * the Connector itself. As with SharedDendriteBase, the functor can't have any fields.
+ */
+
+template <class Functor> class SharedSynapseBase : public Connector
+{
+  public:
+
+    typedef typename Functor::NeuronStateType NeuronStateType;
+    typedef typename Functor::SignalType SignalType;
+
+    static_assert (sizeof (Functor) == sizeof (SynapseFunctor<NeuronStateType, SignalType>), "shared synapse functor keeping data");
+
+    SharedSynapseBase () : Connector () { }
+    SharedSynapseBase (NeuronBase * n, size_type i) : Connector (n, i) { }
+
+    bool process_output (const NeuronStateType & neuron_state)
+    {
+      return functor.process_output (neuron_state);
+    }
+
+    bool process_feedback (NeuronStateType & neuron_state)
+    {
+      if (is_connected ())
+      {
+        NeuronBase * source = get_neuron ();
+
+        SignalType store;
+
+        source->backpropagate (get_nth (), &store);
+
+        return functor.process_feedback (neuron_state, store);
+      }
+
+      return false;
+    }
+
+    bool process_feedback_signal (NeuronStateType & neuron_state, const SignalType & feedback)
+    {
+      return functor.process_feedback (neuron_state, feedback);
+    }
+
+    void propagate (const NeuronStateType & neuron_state, SignalType * store) const
+    {
+      *store = functor.propagate (neuron_state);
+    }
+
+    SignalType backpropagate (const NeuronStateType & neuron_state) const
+    {
+      return functor.backpropagate (neuron_state);
+    }
+
+    // The shared functor doesn't belong to any particular synapse.
+    unsigned long int functor_size () const { return 0; }
+
+    static Functor functor;
+};
+
+template <class Functor> Functor SharedSynapseBase<Functor>::functor;
+
+
+
 #endif /* SYNAPSEBASE_H_ */
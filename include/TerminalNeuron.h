@@ -0,0 +1,137 @@
+/* TerminalNeuron.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef TERMINALNEURON_H_
+#define TERMINALNEURON_H_
+
+#include <new>
+#include "Neuron.h"
+#include "OutputSink.h"
+
+
+/*
+ * Propagator of the terminal neuron. Recomputes the neuron's state exactly like Propagator
+ * does and, whenever the neuron fires, passes its new state to the output sink.
+ */
+template <class NeuronFunctor> class TerminalPropagator : public Propagator<NeuronFunctor>
+{
+  public:
+
+    typedef Propagator<NeuronFunctor>                 Base;
+    typedef typename Base::NeuronState                NeuronState;
+
+    TerminalPropagator (typename Base::Dendrites d, typename Base::Synapses s, NeuronState & ns,
+                        OutputSink<NeuronState> & o, size_t sl, nn_id_t i) : Base (d, s, ns),
+                                                                           output (o),
+                                                                           slot (sl),
+                                                                           neuron_id (i) {}
+    virtual ~TerminalPropagator () {}
+
+    virtual bool operator () ()
+    {
+      if (not Base::operator () ()) return false;
+
+      output.emit (slot, neuron_id, this->neuron_state);
+
+      return true;
+    }
+
+    virtual bool recompute_inputs (const void * inputs)
+    {
+      if (not Base::recompute_inputs (inputs)) return false;
+
+      output.emit (slot, neuron_id, this->neuron_state);
+
+      return true;
+    }
+
+  private:
+
+    OutputSink<NeuronState> & output;
+    size_t slot;
+    nn_id_t neuron_id;
+};
+
+
+/*
+ * Output neuron of the network. It behaves like the Neuron of the same NeuronFunctor, but
+ * has dendrites only and reports its state to the OutputSink every time it fires, so that
+ * the results can be consumed by another thread while the network runs.
+ * Terminal neurons are created by the TerminalNeuron::Factory bound to the sink.
+ */
+template <class NeuronFunctor, size_t InlineConnectors = NN_CONNECTOR_INLINE_CAPACITY>
+class TerminalNeuron : public Neuron<NeuronFunctor, InlineConnectors>
+{
+  public:
+
+    typedef Neuron<NeuronFunctor, InlineConnectors> Base;
+    typedef typename Base::NeuronState              NeuronState;
+    typedef TerminalPropagator<NeuronFunctor>       PropagatorType;
+
+    TerminalNeuron (OutputSink<NeuronState> & o, unsigned int n_dendrites) : Base (n_dendrites, 0),
+                                                                            output (o),
+                                                                            slot (o.add_slot ())
+    {
+      this->set_type_tag (nn_type_tag<TerminalNeuron> ());
+    }
+    virtual ~TerminalNeuron () {}
+
+    size_t output_slot () const { return slot; }
+
+  protected:
+
+    virtual PropagatorBase & propagator (PropagatorBase * ptr)
+    {
+      return *new (ptr) PropagatorType (this->get_dendrites (), this->get_synapses (), this->get_state (), output, slot, this->id ());
+    }
+
+    virtual size_t sizeof_propagator () const { return sizeof (PropagatorType); }
+
+    virtual void report_memory (MemoryReport & report) const
+    {
+      Base::report_memory (report);
+
+      report.neuron_objects += sizeof (TerminalNeuron) - sizeof (Base);
+    }
+
+  private:
+
+    OutputSink<NeuronState> & output;
+    size_t slot;
+
+  public:
+
+    class Factory : public NeuronFactoryBase
+    {
+      public:
+
+        Factory (OutputSink<NeuronState> & o) : output (o) {}
+
+        virtual NeuronBase * create () { return new TerminalNeuron (output, 1); }
+        virtual NeuronBase * create (unsigned int n_dendrites, unsigned int n_synapses) { return new TerminalNeuron (output, n_dendrites); }
+
+      private:
+
+        OutputSink<NeuronState> & output;
+    };
+};
+
+
+#endif /* TERMINALNEURON_H_ */
@@ -0,0 +1,117 @@
+/* TopologyLog.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef TOPOLOGYLOG_H_
+#define TOPOLOGYLOG_H_
+
+#include <atomic>
+#include "Connector.h"
+#include "NeuronBase.h"
+#include "IntrusiveQueue.h"
+
+
+class TopologyChangePool;
+
+/*
+ * Change of the network's topology logged by NeuralNetwork::schedule_connect () or
+ * schedule_disconnect (). Neurons are identified by their index within the network, the
+ * synapse and dendrite by their index within the respective neurons, NEW standing for
+ * a connector to be added to the neuron. Changes come from a TopologyChangePool and the
+ * network gives them back to it once applied.
+ */
+struct TopologyChange
+{
+    enum Kind { CONNECT, DISCONNECT };
+
+    static constexpr Connector::size_type NEW = (Connector::size_type)-1;
+
+    TopologyChange () : kind (CONNECT), source (0), synapse (0), target (0), dendrite (0), pool (0), next (0) {}
+
+    // Give the change back to its pool.
+    inline void release ();
+
+    Kind                    kind;
+    NeuronVector::size_type source;   // neuron the connection originates from
+    Connector::size_type    synapse;  // synapse of the source neuron
+    NeuronVector::size_type target;   // neuron receiving the connection (CONNECT only)
+    Connector::size_type    dendrite; // dendrite of the target neuron (CONNECT only)
+
+    TopologyChangePool * pool;
+    std::atomic<TopologyChange *> next; // used by IntrusiveQueue
+};
+
+
+/*
+ * Log of the topology changes waiting for the next iteration boundary. Changes left in it go
+ * back to their pools.
+ */
+typedef IntrusiveQueue<TopologyChange, IntrusiveRelease<TopologyChange> > TopologyLog;
+
+
+/*
+ * Preallocated topology changes of one scheduling thread, so that scheduling doesn't
+ * allocate. Works like StimulusPool: the thread takes changes with get () and the network
+ * returns them once applied, so the pool may be used by one thread and any number of
+ * networks at a time, and must outlive the changes it gave out.
+ */
+class TopologyChangePool
+{
+  public:
+
+    TopologyChangePool (size_t n) : changes (new TopologyChange[n]), n_changes (n)
+    {
+      for (size_t i = 0; i < n; i++)
+      {
+        changes[i].pool = this;
+        free.push (&changes[i]);
+      }
+    }
+
+    ~TopologyChangePool ()
+    {
+      while (not free.is_empty ()) free.pop ();
+
+      delete [] changes;
+    }
+
+    // Scheduling side. Returns a change, or 0 if all of them are waiting to be applied.
+    TopologyChange * get () { return free.pop (); }
+
+    // Network side.
+    void put (TopologyChange * c) { free.push (c); }
+
+    size_t size () const { return n_changes; }
+
+  private:
+
+    TopologyChangePool (const TopologyChangePool &);
+    TopologyChangePool & operator = (const TopologyChangePool &);
+
+    TopologyChange * changes;
+    size_t n_changes;
+    IntrusiveQueue<TopologyChange, IntrusiveKeep<TopologyChange> > free; // the changes belong to the array
+};
+
+
+inline void TopologyChange::release () { pool->put (this); }
+
+
+#endif /* TOPOLOGYLOG_H_ */
@@ -21,6 +21,75 @@
 #define LIBNN_H_
 
 #include "Neuron.h"
+#include "FixedNeuron.h"
+#include "SensoryNeuron.h"
+#include "TerminalNeuron.h"
+#include "IncrementalNeuron.h"
+#include "StimulusQueue.h"
+#include "TopologyLog.h"
+#include <future>
+#include <cstddef>
+
+/*
+ * Single connection of the network's topology, used by the bulk NeuralNetwork::connect ().
+ * Neurons are identified by their index within the network (that is, the order in which
+ * they were created), the synapse and dendrite by their index within the respective neurons.
+ */
+struct Edge
+{
+    NeuronVector::size_type source;   // index of the neuron the connection originates from
+    Connector::size_type    synapse;  // synapse of the source neuron
+    NeuronVector::size_type target;   // index of the neuron receiving the connection
+    Connector::size_type    dendrite; // dendrite of the target neuron
+};
+
+// Largest number of vertices NeuralNetwork::import_edge_list () accepts by default. Guards
+// against malformed or hostile files making the import allocate without bound.
+// Can be overridden at compile time.
+#ifndef NN_IMPORT_MAX_VERTICES
+#define NN_IMPORT_MAX_VERTICES (1UL << 28)
+#endif
+
+/*
+ * Formats of edge list files accepted by NeuralNetwork::import_edge_list ().
+ */
+enum EdgeListFormat
+{
+    EDGE_LIST_TEXT,     // One "source target" pair per line, separated by comma, semicolon, tabs
+                        // or spaces (CSV/TSV). Further columns are ignored, so are empty lines
+                        // and lines starting with '#' or '%'.
+    EDGE_LIST_BINARY32, // Consecutive pairs of 32 bit unsigned integers in host byte order.
+    EDGE_LIST_BINARY64  // Consecutive pairs of 64 bit unsigned integers in host byte order.
+};
+
+/*
+ * Reasons for NeuralNetwork::run_until () to return.
+ */
+enum RunStatus
+{
+    RUN_QUIESCENT,      // No neurons left to be recomputed or to backpropagate.
+    RUN_CYCLE,          // The network came back to the frontier it had earlier (see cycle_period ()).
+    RUN_MAX_ITERATIONS, // The limit of iterations was reached.
+    RUN_TIME_BUDGET,    // The time budget was used up.
+    RUN_CONDITION,      // User supplied RunCondition was met.
+    RUN_CANCELLED       // The run submitted to StepExecutor was cancelled.
+};
+
+class NeuralNetwork;
+class StepExecutor;
+
+/*
+ * User defined stop condition for NeuralNetwork::run_until (), evaluated after each iteration.
+ */
+class RunCondition
+{
+  public:
+
+    RunCondition () {}
+    virtual ~RunCondition () {}
+
+    virtual bool operator () (const NeuralNetwork & nn) = 0;
+};
 
 /*
  * Class: NeuralNetwork
@@ -35,6 +104,8 @@ class NeuralNetwork
 {
   public:
 
+    friend class SpmvBackendBase;
+
     NeuralNetwork();
     virtual ~NeuralNetwork();
 
@@ -44,14 +115,59 @@ class NeuralNetwork
     void erase ();
     unsigned long int size ();
 
+    // Queue the neuron for recomputation in the current iteration, or the next one if the
+    // iteration is not in progress.
+    void fire (NeuronBase * n);
+
+    // Thread-safe counterparts of fire (), which may be called by any number of threads, also
+    // while the network runs on another one. The stimuli are passed through a lock-free queue
+    // and taken by the network at the beginning of the next iteration, in the order they were
+    // injected. The i-th neuron (in the order of creation) is then either queued for
+    // recomputation or, if the state is given, set to that state and treated as if it has
+    // just fired: the neurons its synapses pass the new state to are queued. States given for
+    // neurons of other classes than NeuronType are ignored.
+    // Each producer thread takes the stimuli from its own pool, which gets them back once they
+    // are applied. False if all the pool's stimuli are still waiting; nothing is injected then.
+    bool inject (StimulusPool & pool, NeuronVector::size_type i)
+    {
+      Stimulus * s = pool.get ();
+
+      if (s == 0) return false;
+
+      s->index = i;
+      stimuli.push (s);
+
+      return true;
+    }
+
+    template <class NeuronType> bool inject (StimulusPool & pool, NeuronVector::size_type i, const typename NeuronType::NeuronState & state)
+    {
+      Stimulus * s = pool.get ();
+
+      if (s == 0) return false;
+
+      s->index = i;
+      s->set_state<NeuronType> (state);
+      stimuli.push (s);
+
+      return true;
+    }
+
     void create_neuron (NeuronFactoryBase & factory);
     void create_neuron (NeuronFactoryBase & factory, unsigned int n_dendrites, unsigned int n_synapses);
 
-    //void generate_random_sensory_neurons (unsigned int n_neurons,
-    //                                      unsigned int min_synapses, unsigned int max_synapses);
-    //void generate_random_terminal_neurons (unsigned int n_neurons,
-    //                                       unsigned int min_dendrites, unsigned int max_dendrites);
-    void generate_random_core_neurons (NeuronFactoryBase & factory, unsigned int n_neurons,
+    // Create one sensory neuron for each slot of the input, with random number of synapses.
+    // The input is polled at the beginning of every run () and the sensory neurons whose
+    // values changed in the newly published frame are queued for firing.
+    void generate_random_sensory_neurons (SensoryInputBase & input,
+                                          unsigned int min_synapses, unsigned int max_synapses);
+    // Create terminal neurons with random number of dendrites. The factory should create
+    // neurons reporting to the output sink (see TerminalNeuron::Factory); the network notifies
+    // the sink about the beginning and the end of each iteration.
+    void generate_random_terminal_neurons (NeuronFactoryBase & factory, OutputSinkBase & output,
+                                           NeuronVector::size_type n_neurons,
+                                           unsigned int min_dendrites, unsigned int max_dendrites);
+    void generate_random_core_neurons (NeuronFactoryBase & factory, NeuronVector::size_type n_neurons,
                                        unsigned int min_dendrites, unsigned int max_dedtrites,
                                        unsigned int min_synapses, unsigned int max_synapses);
 
@@ -61,16 +177,220 @@ class NeuralNetwork
 
     void connect (NeuronBase * a, Connector::size_type synapse, NeuronBase * b, Connector::size_type dendrite);
 
-    bool is_firing () { return not (current_queue->empty () and bp_current_queue->empty ()); }
+    // Make all the connections listed in the edges array at once, using n_threads threads
+    // (0 = as many as there are hardware threads). The whole list is validated first: neuron
+    // indices must be within the network, synapses and dendrites must exist, be unconnected
+    // and must not appear in the list more than once. If any of the edges is invalid nothing
+    // is connected and false is returned.
+    bool connect (const Edge * edges, size_t n_edges, unsigned int n_threads = 0);
+
+    // Thread-safe counterparts of connect () and of disconnecting a synapse, which may be
+    // called by any number of threads, also from within the functors while the network runs.
+    // The changes are logged and applied at the beginning of the next iteration, in the order
+    // they were scheduled and before the stimuli injected after them are taken, so they never
+    // touch the connectors of a neuron being recomputed or backpropagating. TopologyChange::NEW
+    // as the synapse or dendrite adds a new connector to the neuron; the change is dropped if
+    // the neuron can't grow, and so are the changes referring to neurons or connectors that
+    // don't exist. The neurons whose dendrites were connected or disconnected are queued for
+    // recomputation.
+    // Each scheduling thread takes the changes from its own pool, which gets them back once
+    // they are applied. False if all the pool's changes are still waiting; nothing is
+    // scheduled then.
+    bool schedule_connect (TopologyChangePool & pool, NeuronVector::size_type source, Connector::size_type synapse,
+                           NeuronVector::size_type target, Connector::size_type dendrite)
+    {
+      TopologyChange * c = pool.get ();
+
+      if (c == 0) return false;
+
+      c->kind = TopologyChange::CONNECT;
+      c->source = source;
+      c->synapse = synapse;
+      c->target = target;
+      c->dendrite = dendrite;
+      topology_log.push (c);
+
+      return true;
+    }
+
+    bool schedule_disconnect (TopologyChangePool & pool, NeuronVector::size_type source, Connector::size_type synapse)
+    {
+      TopologyChange * c = pool.get ();
+
+      if (c == 0) return false;
+
+      c->kind = TopologyChange::DISCONNECT;
+      c->source = source;
+      c->synapse = synapse;
+      topology_log.push (c);
+
+      return true;
+    }
+
+    // Number of the iterations so far which began with applying topology changes. Structures
+    // built from the topology at an earlier epoch (SpmvBackend, Ensemble) are out of date.
+    unsigned long int topology_epoch () const { return epoch.load (std::memory_order_acquire); }
+
+    // Read the topology from an edge list file. Vertices of the file are numbered from 0 and
+    // vertex i becomes a new neuron created by the factory, added after the neurons already
+    // present in the network. The file is read twice in chunks, first counting degrees of
+    // the vertices, so that each neuron gets exactly as many dendrites and synapses as it
+    // needs, then making the connections. Chunks are parsed by n_threads threads (0 = as many
+    // as there are hardware threads). Returns false if the file could not be read or parsed,
+    // ends with a truncated binary record, refers to a vertex numbered max_vertices or higher,
+    // or changed between the passes, or if the factory refused to create a neuron. The
+    // network is left as it was before the import then.
+    bool import_edge_list (const char * filename, EdgeListFormat format, NeuronFactoryBase & factory,
+                           unsigned int n_threads = 0, unsigned long int max_vertices = NN_IMPORT_MAX_VERTICES);
+
+    // In the pipelined mode the backpropagation of iteration N runs on a separate thread,
+    // concurrently with the forward propagation of iteration N + 1. It is done only
+    // for neurons that are not going to be recomputed in the forward propagation and whose
+    // synapses don't lead to such neurons; the rest of the backpropagation follows after the
+    // forward propagation. The division depends only on the network's state, and the neurons
+    // are queued in the same order as in the sequential mode, so the results are the same.
+    // For this to hold, the functors must follow these rules: forward propagation functions
+    // write only the state of the neuron being recomputed and its dendrites; backpropagation
+    // functions write only the state of the neuron backpropagating, its dendrites and
+    // synapses, and read the states of the neurons and dendrites its synapses lead to.
+    // Functors shared between connectors (SharedNeuronFunctor) can't keep any data, which the
+    // compiler checks.
+    void set_pipelined (bool p) { pipelined = p; }
+    bool is_pipelined () const { return pipelined; }
+
+    // With type bucketing enabled the update queues are reordered at the beginning of each
+    // iteration so that the neurons of the same class (see NeuronBase::type ()) are processed
+    // one after another, keeping their relative order. In networks mixing several neuron
+    // classes this makes consecutive virtual calls go to the same code. Does nothing for
+    // queues holding neurons of a single class.
+    void set_type_bucketing (bool b) { type_bucketing = b; }
+    bool is_type_bucketing () const { return type_bucketing; }
+
+    // Register the runners of the neurons of class NeuronType. With type bucketing enabled the
+    // network then recomputes and backpropagates each bucket of such neurons with one call of
+    // code compiled for NeuronType's propagator, which calls the propagator's methods directly
+    // rather than through its virtual table. Only building the propagator of each neuron
+    // remains a virtual call. All the neurons tagged as NeuronType must use its propagator,
+    // so classes derived from it and keeping its tag must not override propagator ().
+    template <class NeuronType> void register_runners ()
+    {
+      __uint16_t t = nn_type_tag<NeuronType> ();
+
+      if (runners.size () <= t) runners.resize (t + 1);
+
+      runners[t].forward = &NeuralNetwork::forward_bucket<typename NeuronType::PropagatorType>;
+      runners[t].backward = &NeuralNetwork::backward_bucket<typename NeuronType::PropagatorType>;
+    }
+
+    // With the feedback index enabled the backpropagation doesn't follow each synapse to the
+    // neuron it is connected to. Instead the network keeps one row of feedback slots per
+    // neuron, one slot per connected synapse, and each neuron writes the feedback of all its
+    // dendrites into the slots of the synapses they are connected to whenever the network
+    // recomputes it or backpropagates through it. The backpropagating neuron's propagator then
+    // reads its row in one go. The index is rebuilt at the beginning of the iteration following
+    // any change of the topology; states modified directly by the user need
+    // set_feedback_index () to be called again. Neurons whose synapses lead back to themselves
+    // are left out of the index and backpropagate as usual, so the results are the same
+    // either way.
+    void set_feedback_index (bool f) { feedback_index = f; feedback_index_valid = false; }
+    bool is_feedback_index () const { return feedback_index; }
+
+    // With the gather-apply-scatter engine the forward propagation is done in three phases,
+    // each going over the whole update queue before the next one starts. First the signals
+    // of the source neurons of all the queued neurons' dendrites are read into one buffer,
+    // packed neuron by neuron, prefetching the source neurons ahead of the reads. This phase
+    // only reads the network and is run by n_threads threads (0 = as many as there are
+    // hardware threads). Then all the queued neurons are recomputed from the buffer and
+    // finally the neurons they fire and backpropagate to are queued.
+    // All the neurons recomputed in an iteration thus see the states their source neurons had
+    // at the beginning of the iteration, regardless of their order within the queue, rather
+    // than the states already updated by the neurons recomputed before them. Neurons whose
+    // classes can't take the input read in advance (see NeuronBase::sizeof_input ()) are
+    // recomputed as usual at the start of the second phase, before any other neuron. They see
+    // the states their source neurons had at the beginning of the iteration too, except for
+    // the source neurons of their own kind recomputed before them.
+    void set_gather_apply_scatter (bool g, unsigned int n_threads = 1) { gather_apply_scatter = g; gather_threads = n_threads; }
+    bool is_gather_apply_scatter () const { return gather_apply_scatter; }
+
+    // Perform a part of the iteration, recomputing or backpropagating at most max_neurons
+    // neurons, and return true if that completed the iteration. Subsequent calls continue
+    // where the previous one stopped, which allows for interleaving the computations with
+    // other work (see StepExecutor). run () completes the iteration in progress, if any.
+    // In the pipelined mode the whole iteration is always performed at once, with the
+    // gather-apply-scatter engine the whole forward propagation, max_neurons bounding only the
+    // backpropagation then. A forward propagation left in the middle is completed without the
+    // gather-apply-scatter engine, even if it has been enabled since.
+    bool step (size_t max_neurons);
+
+    // Submit the network to the executor to run up to max_iterations iterations within
+    // time_budget seconds (0 = no limit). See StepExecutor::submit ().
+    std::future<RunStatus> step_async (StepExecutor & executor, unsigned long int max_iterations, double time_budget = 0.0);
+
+    // Run up to n iterations, stopping earlier if the network quiesces or, with cycle
+    // detection enabled, enters a limit cycle or a steady state. Returns the number of
+    // iterations performed.
+    unsigned long int run_n (unsigned long int n);
+
+    // Run until the network quiesces, max_iterations iterations are performed, time_budget
+    // seconds pass (0 = no limit) or the condition (if given) is met. With cycle detection
+    // enabled also stops when the network enters a limit cycle or a steady state.
+    RunStatus run_until (unsigned long int max_iterations, double time_budget = 0.0, RunCondition * condition = 0);
+
+    // Enable detection of limit cycles with periods up to window iterations (0 disables it).
+    // After each iteration the states of all the neurons (and their dendrites, see
+    // NeuronBase::state_hash ()) are hashed together with the frontier, that is the neurons
+    // queued for recomputation and backpropagation, and compared with the hashes of the last
+    // window iterations. A match means the network is going to repeat itself, short of a
+    // 64 bit hash collision. The hash of the whole network is kept up to date neuron by neuron
+    // as they change, which costs a hash of the state of each recomputed neuron.
+    void set_cycle_detection (unsigned int window);
+
+    // Period of the cycle detected by the last run_until () returning RUN_CYCLE. Period of
+    // 1 means a steady state: the same neurons keep firing without changing their states.
+    unsigned long int cycle_period () const { return period; }
+
+    // Write the states of the neurons (and their dendrites) changed since the previous
+    // checkpoint, or of all the neurons if full is true, to the file. Neurons are identified
+    // by their index within the network, states are written as raw bytes in host byte order.
+    // Only the states are saved, neither the topology nor the update queues. Neurons which
+    // have been recomputed but whose states are the same as in the previous checkpoint are
+    // considered unchanged; the network keeps a copy of each neuron's checkpointed state to
+    // tell.
+    bool save_checkpoint (const char * filename, bool full = false);
+
+    // Restore the states from the checkpoint file. Rolling back to a given checkpoint means
+    // loading the last full checkpoint followed by all the deltas up to the given one, or
+    // a single file produced by compact_checkpoints (). Returns false if the file doesn't
+    // match the network; the states restored before the mismatch was found stay.
+    bool load_checkpoint (const char * filename);
+
+    // Merge a full checkpoint and the following deltas, given in the order they were taken,
+    // into a single checkpoint keeping only the latest state of each neuron.
+    static bool compact_checkpoints (const char * const * filenames, size_t n_files, const char * output);
+
+    // Also true if there are stimuli or topology changes waiting to be taken. Not thread-safe.
+    bool is_firing () const
+    {
+      return not (current_queue->empty () and bp_current_queue->empty () and stimuli.is_empty () and topology_log.is_empty ());
+    }
+
+    // Detailed account of the memory used by the network. Unlike size () it includes the
+    // unused capacity of the containers, the update queues, the propagator stores and the
+    // allocator's overhead, as well as the data the connectors' functors report.
+    MemoryReport memory_report () const;
 
     // Dump the map of entire network in human readable form. Can be used for debugging
     // and testing.
     void report_connections () const;
 
     NeuronVector::size_type neurons_count () const { return neurons.size (); }
+    NeuronBase * neuron (NeuronVector::size_type i) const { return neurons[i]; }
     NeuronVector::size_type neurons_firing_count () const { return current_queue->size (); }
     NeuronVector::size_type neurons_backpropagating_count () const { return bp_current_queue->size (); }
 
+    // Number of iterations (calls to run ()) performed so far.
+    unsigned long int iterations () const { return iteration; }
+
   protected:
 
     void add_to_update_queue (NeuronBase * n);
@@ -78,11 +398,54 @@ class NeuralNetwork
 
   private:
 
+    void wire (const Edge * edges, size_t n_edges, unsigned int n_threads);
+
+    void poll_inputs ();
+    void take_stimuli (Stimulus * last, NeuronVector * set = 0);
+    void apply_topology_changes ();
+    bool apply_topology_change (const TopologyChange & c);
+    void bucket_by_type (NeuronVector & queue);
+    void build_feedback_index ();
+    void state_changed (const NeuronBase & n);
+    static __uint64_t neuron_hash (const NeuronBase & n);
+    void scatter_feedback (const NeuronBase & n);
+    const void * feedback_row (const NeuronBase & n) const;
+    void begin_iteration ();
+    void end_iteration ();
+    void forward_pass (PropagatorBase * store, NeuronVector * bp_deferred, size_t begin, size_t end);
+    template <class P> void forward_bucket (PropagatorBase * store, NeuronVector * bp_deferred, size_t begin, size_t end);
+    void gather_inputs ();
+    void gather_apply_scatter_pass (NeuronVector * bp_deferred);
+    void backward_pass (const NeuronVector & queue, PropagatorBase * store, size_t begin, size_t end);
+    template <class P> void backward_bucket (const NeuronVector & queue, PropagatorBase * store, size_t begin, size_t end);
+    static size_t bucket_end (const NeuronVector & queue, size_t begin, size_t end);
+    void run_pipelined ();
+    void queue_logged_backpropagation ();
+    static bool conflicts_with_forward_pass (const NeuronBase & n);
+    __uint64_t frontier_hash () const;
     void swap_update_queues ();
     void swap_bp_update_queues ();
 
     NeuronVector neurons;
 
+    std::vector<SensoryInputBase *> inputs; // sources of the sensory neurons' values
+    NeuronVector changed_inputs;            // sensory neurons whose values have just changed
+    StimulusQueue stimuli;                  // injected by other threads
+    TopologyLog topology_log;               // changes scheduled since the last iteration began
+    std::atomic<unsigned long int> epoch;   // see topology_epoch ()
+    std::vector<OutputSinkBase *> outputs;  // sinks of the terminal neurons' states
+
+    unsigned long int iteration;
+
+    std::vector<std::vector<char> > checkpoint_states; // each neuron's last checkpointed state, empty = unknown
+
+    std::vector<__uint64_t> cycle_hashes;            // hashes of the last iterations
+    std::vector<unsigned long int> cycle_iterations; // and the iterations they were taken at
+    bool cycle_tracking;                             // true while run_until () detects cycles
+    std::vector<__uint64_t> neuron_hashes;           // hash of each neuron's state then
+    std::atomic<__uint64_t> network_hash;            // and their sum
+    unsigned long int period;
+
     // The first two queues store pointers to neurons that were affected by signal propagation
     // from their dendrite-connected neurons and therefore require state recomputation
     // (that is invocation of their respective recompute() functions).
@@ -96,6 +459,118 @@ class NeuralNetwork
 
     size_t propagator_store_size;
     PropagatorBase * propagator_store;
+    PropagatorBase * bp_propagator_store; // used by the backpropagation thread in the pipelined mode
+
+    bool pipelined;
+    NeuronVector bp_concurrent; // backpropagating neurons processed concurrently with the forward pass
+    NeuronVector bp_serial;     // backpropagating neurons processed after the forward pass
+    NeuronVector bp_deferred;   // neurons the forward pass backpropagates to
+    NeuronVector bp_logged;     // neurons the backward passes backpropagate to, each neuron's ended with 0
+    NeuronVector * bp_log;      // &bp_logged while the backward passes of the pipelined mode run
+
+    bool type_bucketing;
+    NeuronVector bucketed;              // scratch queue for bucket_by_type ()
+    std::vector<size_t> bucket_offsets; // and its per class counters
+
+    // Runners of the neurons of one class, processing the queued neurons [begin, end).
+    typedef void (NeuralNetwork::* ForwardRunner) (PropagatorBase * store, NeuronVector * bp_deferred, size_t begin, size_t end);
+    typedef void (NeuralNetwork::* BackwardRunner) (const NeuronVector & queue, PropagatorBase * store, size_t begin, size_t end);
+
+    struct TypeRunners
+    {
+        TypeRunners () : forward (0), backward (0) {}
+
+        ForwardRunner  forward;
+        BackwardRunner backward;
+    };
+
+    std::vector<TypeRunners> runners; // indexed by the type tags, see register_runners ()
+
+    bool feedback_index;
+    bool feedback_index_valid;                 // false after the topology changed
+    std::vector<size_t> feedback_offset;       // row of each neuron within feedback_buffer, or NONE
+    std::vector<size_t> feedback_slots_begin;  // first of each neuron's dendrites in feedback_slots, and the end
+    std::vector<size_t> feedback_slots;        // where each dendrite writes its feedback, or NONE
+    std::vector<char> feedback_buffer;
+
+    // Dendrite of a queued neuron, as seen by the gather phase.
+    struct GatherEdge
+    {
+        const NeuronBase *   source;  // neuron the dendrite is connected to
+        Connector::size_type synapse; // and its synapse
+        size_t               offset;  // slot of the signal within gather_buffer
+    };
+
+    bool gather_apply_scatter;
+    unsigned int gather_threads;
+    std::vector<GatherEdge> gather_edges;
+    std::vector<size_t> gather_offset;         // inputs of each queued neuron within gather_buffer
+    std::vector<char> gather_buffer;
+    std::vector<char> applied;                 // outcome of the apply phase for each queued neuron
+    std::vector<std::max_align_t> apply_store; // and its propagator, kept for the scatter phase
+
+    enum { STEP_IDLE, STEP_FORWARD, STEP_BACKWARD } step_phase; // part of the iteration step () is in
+    size_t step_position;                                       // and the position within the queue
 };
 
+// Same as forward_pass () over neurons all using propagators of class P.
+
+template <class P> void NeuralNetwork::forward_bucket (PropagatorBase * store, NeuronVector * bp_deferred, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; i++)
+  {
+    NeuronBase & neuron = *(*current_queue)[i];
+
+    neuron.set_in_update_queue (false);
+
+    P & p = static_cast<P &> (neuron.propagator (store));
+
+    neuron.dirty = 1;
+    neuron.state_version++;
+
+    if (p.P::operator () ())
+    {
+      for (NeuronBase * n = p.P::first_synapse (); n != p.null (); n = p.P::next_synapse ()) add_to_update_queue (n);
+
+      if (p.P::should_backpropagate ())
+      {
+        if (bp_deferred)
+          for (NeuronBase * n = p.P::first_dendrite (); n != p.null (); n = p.P::next_dendrite ()) bp_deferred->push_back (n);
+        else
+          for (NeuronBase * n = p.P::first_dendrite (); n != p.null (); n = p.P::next_dendrite ()) add_to_bp_update_queue (n);
+      }
+    }
+
+    state_changed (neuron);
+  }
+}
+
+// Same as backward_pass () over neurons all using propagators of class P.
+
+template <class P> void NeuralNetwork::backward_bucket (const NeuronVector & queue, PropagatorBase * store, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; i++)
+  {
+    NeuronBase & neuron = *queue[i];
+
+    neuron.set_in_bp_update_queue (false);
+
+    P & p = static_cast<P &> (neuron.propagator (store));
+
+    neuron.dirty = 1;
+    neuron.state_version++;
+
+    const void * feedback = feedback_index ? feedback_row (neuron) : 0;
+
+    if (feedback ? p.P::backpropagate_feedback (feedback) : p.P::backpropagate ())
+      for (NeuronBase * n = p.P::first_dendrite (); n != p.null (); n = p.P::next_dendrite ()) add_to_bp_update_queue (n);
+
+    if (bp_log) bp_log->push_back (0);
+
+    state_changed (neuron);
+  }
+}
+
+#include "StepExecutor.h"
+
 #endif /* LIBNN_H_ */
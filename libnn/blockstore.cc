@@ -0,0 +1,280 @@
+/* blockstore.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include "blockstore.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+const size_t BlockStore::NONE;
+
+
+BlockStore::BlockStore (const char * filename, size_t cache_blocks) :
+  fd (open (filename, O_RDWR | O_CREAT | O_TRUNC, 0600)), end_offset (0),
+  slots (cache_blocks < 2 ? 2 : cache_blocks), clock (0), n_reads (0), stop (false)
+{
+  for (std::vector<Slot>::iterator s = slots.begin (); s != slots.end (); s++)
+  {
+    s->block = NONE;
+    s->state = SLOT_EMPTY;
+    s->pins = 0;
+    s->used = false;
+    s->last_used = 0;
+  }
+
+  if (fd >= 0) thread = std::thread (&BlockStore::io_thread, this);
+}
+
+BlockStore::~BlockStore ()
+{
+  if (fd < 0) return;
+
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+    stop = true;
+  }
+
+  cv.notify_all ();
+  thread.join ();
+
+  close (fd);
+}
+
+void BlockStore::clear ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  requests.clear ();
+
+  for (size_t i = 0; i < slots.size (); i++)
+    while (slots[i].state == SLOT_LOADING) cv.wait (lock);
+
+  for (std::vector<Slot>::iterator s = slots.begin (); s != slots.end (); s++)
+  {
+    s->block = NONE;
+    s->state = SLOT_EMPTY;
+    s->used = false;
+  }
+
+  offsets.clear ();
+  sizes.clear ();
+  slot_of.clear ();
+
+  end_offset = 0;
+
+  if (fd >= 0 and ftruncate (fd, 0) != 0) {}
+}
+
+bool BlockStore::append (const void * data, size_t size)
+{
+  const char * p = (const char *)data;
+  off_t offset = end_offset;
+
+  for (size_t done = 0; done < size;)
+  {
+    ssize_t n = pwrite (fd, p + done, size - done, offset + done);
+
+    if (n < 0 and errno == EINTR) continue;
+    if (n <= 0) return false;
+
+    done += n;
+  }
+
+  std::lock_guard<std::mutex> lock (mutex);
+
+  offsets.push_back (offset);
+  sizes.push_back (size);
+  slot_of.push_back (NONE);
+
+  end_offset += size;
+
+  return true;
+}
+
+// Slot to be reused for a new block: the empty one, the least recently used one among those
+// already used, or the oldest prefetched one, in that order. Pinned slots and those being
+// loaded are never taken. Returns NONE if there is no such slot.
+
+size_t BlockStore::find_victim () const
+{
+  size_t victim = NONE;
+
+  for (size_t i = 0; i < slots.size (); i++)
+  {
+    const Slot & s = slots[i];
+
+    if (s.state == SLOT_EMPTY) return i;
+    if (s.state == SLOT_LOADING or s.pins) continue;
+
+    if (victim == NONE) victim = i;
+    else
+    {
+      const Slot & v = slots[victim];
+
+      if (s.used != v.used ? s.used : s.last_used < v.last_used) victim = i;
+    }
+  }
+
+  return victim;
+}
+
+size_t BlockStore::assign_slot (size_t block)
+{
+  size_t i = find_victim ();
+
+  if (i == NONE) return NONE;
+
+  Slot & s = slots[i];
+
+  if (s.block != NONE) slot_of[s.block] = NONE;
+
+  s.block = block;
+  s.state = SLOT_LOADING;
+  s.used = false;
+  slot_of[block] = i;
+
+  return i;
+}
+
+// Read the block assigned to the slot. The lock is released during the read.
+
+bool BlockStore::load (size_t slot, std::unique_lock<std::mutex> & lock)
+{
+  Slot & s = slots[slot];
+  off_t offset = offsets[s.block];
+  size_t size = sizes[s.block];
+
+  lock.unlock ();
+
+  s.data.resize (size ? size : 1); // so that even an empty block has an address
+
+  bool ok = true;
+
+  for (size_t done = 0; done < size;)
+  {
+    ssize_t n = pread (fd, &s.data[done], size - done, offset + done);
+
+    if (n < 0 and errno == EINTR) continue;
+    if (n <= 0) { ok = false; break; }
+
+    done += n;
+  }
+
+  lock.lock ();
+
+  n_reads++;
+
+  if (ok)
+  {
+    s.state = SLOT_READY;
+    s.last_used = ++clock;
+  }
+  else
+  {
+    slot_of[s.block] = NONE;
+    s.block = NONE;
+    s.state = SLOT_EMPTY;
+  }
+
+  cv.notify_all ();
+
+  return ok;
+}
+
+void BlockStore::prefetch (size_t block)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  if (block >= slot_of.size () or slot_of[block] != NONE) return;
+
+  requests.push_back (block);
+
+  cv.notify_all ();
+}
+
+const char * BlockStore::acquire (size_t block)
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  if (block >= slot_of.size ()) return 0;
+
+  for (;;)
+  {
+    size_t i = slot_of[block];
+
+    if (i == NONE)
+    {
+      i = assign_slot (block);
+
+      if (i == NONE) cv.wait (lock);
+      else if (not load (i, lock)) return 0;
+
+      continue;
+    }
+
+    Slot & s = slots[i];
+
+    if (s.state == SLOT_LOADING)
+    {
+      cv.wait (lock);
+      continue;
+    }
+
+    s.pins++;
+    s.used = true;
+    s.last_used = ++clock;
+
+    return &s.data[0];
+  }
+}
+
+void BlockStore::release (size_t block)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  size_t i = slot_of[block];
+
+  if (i != NONE and slots[i].pins) slots[i].pins--;
+
+  cv.notify_all ();
+}
+
+void BlockStore::io_thread ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  for (;;)
+  {
+    while (not stop and requests.empty ()) cv.wait (lock);
+
+    if (stop) return;
+
+    size_t block = requests.front ();
+
+    requests.pop_front ();
+
+    if (block >= slot_of.size () or slot_of[block] != NONE) continue;
+
+    size_t i = assign_slot (block);
+
+    if (i != NONE) load (i, lock);
+  }
+}
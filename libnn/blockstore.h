@@ -0,0 +1,112 @@
+/* blockstore.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+// Internal file backed storage of the out-of-core execution. Not installed.
+
+#ifndef BLOCKSTORE_H_
+#define BLOCKSTORE_H_
+
+#include <sys/types.h>
+#include <stddef.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/*
+ * Sequence of variable sized blocks written once to a file and read back through a cache of
+ * a bounded number of blocks. Blocks are loaded on demand by acquire () or in advance by
+ * prefetch (), which hands the read over to a background thread. Acquired blocks stay pinned
+ * in the cache until released. When a block has to be loaded into a full cache the least
+ * recently used unpinned one is evicted, blocks prefetched but not used yet going last.
+ * Blocks are written and acquired by one thread.
+ */
+class BlockStore
+{
+  public:
+
+    BlockStore (const char * filename, size_t cache_blocks);
+    ~BlockStore ();
+
+    bool is_open () const { return fd >= 0; }
+
+    // Drop all the blocks, both from the file and from the cache. No block may be acquired.
+    void clear ();
+
+    // Write the next block to the end of the file. Returns false on error.
+    bool append (const void * data, size_t size);
+
+    size_t n_blocks () const { return offsets.size (); }
+
+    // Ask for the block to be loaded in the background. Ignored if the block is cached or
+    // being loaded already, or if all the cache slots are in use.
+    void prefetch (size_t block);
+
+    // Wait for the block to be in the cache, loading it if necessary, and pin it there.
+    // Returns 0 if the block could not be read.
+    const char * acquire (size_t block);
+    void release (size_t block);
+
+    // Number of blocks read from the file so far.
+    unsigned long int reads () const { return n_reads; }
+
+  private:
+
+    enum { SLOT_EMPTY, SLOT_LOADING, SLOT_READY };
+
+    struct Slot
+    {
+        size_t block;
+        int state;
+        unsigned int pins;
+        bool used;                  // acquired since it was loaded
+        unsigned long int last_used;
+        std::vector<char> data;
+    };
+
+    static const size_t NONE = (size_t)-1;
+
+    size_t find_victim () const;
+    size_t assign_slot (size_t block);
+    bool load (size_t slot, std::unique_lock<std::mutex> & lock);
+    void io_thread ();
+
+    int fd;
+    off_t end_offset;
+
+    std::vector<off_t> offsets; // position of each block within the file
+    std::vector<size_t> sizes;
+    std::vector<size_t> slot_of; // cache slot of each block, or NONE
+
+    std::vector<Slot> slots;
+    unsigned long int clock;
+    unsigned long int n_reads;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<size_t> requests; // blocks to be prefetched
+    bool stop;
+    std::thread thread;
+};
+
+
+#endif /* BLOCKSTORE_H_ */
@@ -0,0 +1,255 @@
+/* checkpoint.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "libnn.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <map>
+
+
+/*
+ * Checkpoint file layout (host byte order):
+ *
+ *   header                       checkpoint_header
+ *   n_records times:
+ *     index of the neuron        uint64_t
+ *     size of the state          uint64_t
+ *     state                      size bytes, as written by NeuronBase::save_state ()
+ */
+
+static const char checkpoint_magic[4] = { 'L', 'N', 'N', 'C' };
+static const uint32_t checkpoint_version = 1;
+
+struct checkpoint_header
+{
+    char     magic[4];
+    uint32_t version;
+    uint64_t n_neurons;  // size of the network the checkpoint was taken of
+    uint64_t n_records;
+    uint64_t iteration;  // NeuralNetwork::iterations () at the time of the checkpoint
+};
+
+typedef std::map<uint64_t, std::vector<char> > CheckpointRecords;
+
+
+static bool write_header (FILE * f, uint64_t n_neurons, uint64_t n_records, uint64_t iteration)
+{
+  checkpoint_header h;
+
+  memcpy (h.magic, checkpoint_magic, sizeof (h.magic));
+  h.version = checkpoint_version;
+  h.n_neurons = n_neurons;
+  h.n_records = n_records;
+  h.iteration = iteration;
+
+  return fwrite (&h, sizeof (h), 1, f) == 1;
+}
+
+static bool read_header (FILE * f, checkpoint_header & h)
+{
+  return fread (&h, sizeof (h), 1, f) == 1 and
+         memcmp (h.magic, checkpoint_magic, sizeof (h.magic)) == 0 and h.version == checkpoint_version;
+}
+
+static bool write_record (FILE * f, uint64_t index, const char * state, uint64_t size)
+{
+  return fwrite (&index, sizeof (index), 1, f) == 1 and fwrite (&size, sizeof (size), 1, f) == 1 and
+         fwrite (state, 1, size, f) == size;
+}
+
+static bool read_record_header (FILE * f, uint64_t & index, uint64_t & size)
+{
+  return fread (&index, sizeof (index), 1, f) == 1 and fread (&size, sizeof (size), 1, f) == 1;
+}
+
+// To be called only once the size read by read_record_header () has been validated, so that
+// a corrupted size can't make it allocate arbitrary amounts of memory.
+static bool read_record_state (FILE * f, uint64_t size, std::vector<char> & state)
+{
+  state.resize (size);
+
+  return fread (state.data (), 1, size, f) == size;
+}
+
+// Number of bytes between the current position and the end of the file.
+static uint64_t bytes_left (FILE * f)
+{
+  long position = ftell (f);
+
+  if (position < 0 or fseek (f, 0, SEEK_END) != 0) return 0;
+
+  long end = ftell (f);
+
+  if (end < position or fseek (f, position, SEEK_SET) != 0) return 0;
+
+  return end - position;
+}
+
+
+// The network keeps a copy of the state each neuron was last checkpointed with, empty if
+// unknown, so that the deltas leave out the neurons recomputed without their states changing.
+// The number of records is known only at the end, the header is written again then.
+
+bool NeuralNetwork::save_checkpoint (const char * filename, bool full)
+{
+  FILE * f = fopen (filename, "wb");
+
+  if (not f) return false;
+
+  std::vector<char> state;
+  std::vector<char> written;         // states written, one after another
+  std::vector<NeuronVector::size_type> written_neurons;
+  uint64_t n_records = 0;
+
+  checkpoint_states.resize (neurons.size ());
+
+  bool ok = write_header (f, neurons.size (), 0, iteration);
+
+  for (NeuronVector::size_type i = 0; ok and i < neurons.size (); i++)
+  {
+    NeuronBase & n = *neurons[i];
+
+    if (not (full or n.dirty) or n.sizeof_state () == 0) continue;
+
+    state.resize (n.sizeof_state ());
+    n.save_state (state.data ());
+
+    if (not full and state == checkpoint_states[i]) continue;
+
+    written.insert (written.end (), state.begin (), state.end ());
+    written_neurons.push_back (i);
+    n_records++;
+
+    ok = write_record (f, i, state.data (), state.size ());
+  }
+
+  if (ok) ok = fseek (f, 0, SEEK_SET) == 0 and write_header (f, neurons.size (), n_records, iteration);
+
+  if (fclose (f) != 0) ok = false;
+
+  // The flags are cleared and the copies updated only once the checkpoint is safely written,
+  // so that a failed checkpoint doesn't lose any changes for the next one.
+
+  if (ok)
+  {
+    for (NeuronVector::iterator i = neurons.begin (); i != neurons.end (); i++) (*i)->dirty = 0;
+
+    size_t offset = 0;
+
+    for (size_t k = 0; k < written_neurons.size (); k++)
+    {
+      std::vector<char> & copy = checkpoint_states[written_neurons[k]];
+
+      copy.assign (written.begin () + offset, written.begin () + offset + neurons[written_neurons[k]]->sizeof_state ());
+      offset += copy.size ();
+    }
+  }
+
+  return ok;
+}
+
+bool NeuralNetwork::load_checkpoint (const char * filename)
+{
+  FILE * f = fopen (filename, "rb");
+
+  if (not f) return false;
+
+  checkpoint_header h;
+  bool ok = read_header (f, h) and h.n_neurons == neurons.size ();
+
+  std::vector<char> state;
+  uint64_t index;
+  uint64_t size;
+
+  for (uint64_t k = 0; ok and k < h.n_records; k++)
+  {
+    ok = read_record_header (f, index, size) and index < neurons.size () and size == neurons[index]->sizeof_state () and
+         read_record_state (f, size, state);
+
+    if (ok)
+    {
+      neurons[index]->load_state (state.data ());
+      neurons[index]->state_version++; // dendrites reading it (IncrementalNeuron) have to read it again
+      neurons[index]->dirty = 1; // differs from what the next delta is going to be based on
+      state_changed (*neurons[index]);
+
+      if (index < checkpoint_states.size ()) checkpoint_states[index].clear ();
+    }
+  }
+
+  fclose (f);
+
+  if (ok) iteration = h.iteration;
+
+  return ok;
+}
+
+bool NeuralNetwork::compact_checkpoints (const char * const * filenames, size_t n_files, const char * output)
+{
+  CheckpointRecords records;
+  uint64_t n_neurons = 0;
+  uint64_t last_iteration = 0;
+
+  for (size_t i = 0; i < n_files; i++)
+  {
+    FILE * f = fopen (filenames[i], "rb");
+
+    if (not f) return false;
+
+    checkpoint_header h;
+    bool ok = read_header (f, h) and (i == 0 or h.n_neurons == n_neurons);
+
+    uint64_t index;
+    uint64_t size;
+
+    for (uint64_t k = 0; ok and k < h.n_records; k++)
+    {
+      std::vector<char> state;
+
+      ok = read_record_header (f, index, size) and index < h.n_neurons and size <= bytes_left (f) and
+           read_record_state (f, size, state);
+
+      if (ok) records[index].swap (state);
+    }
+
+    fclose (f);
+
+    if (not ok) return false;
+
+    n_neurons = h.n_neurons;
+    last_iteration = h.iteration;
+  }
+
+  FILE * f = fopen (output, "wb");
+
+  if (not f) return false;
+
+  bool ok = write_header (f, n_neurons, records.size (), last_iteration);
+
+  for (CheckpointRecords::iterator i = records.begin (); ok and i != records.end (); i++)
+    ok = write_record (f, i->first, i->second.data (), i->second.size ());
+
+  if (fclose (f) != 0) ok = false;
+
+  return ok;
+}
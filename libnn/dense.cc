@@ -0,0 +1,113 @@
+/* dense.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "libnn.h"
+#include "DenseLayer.h"
+#include <string.h>
+#include <algorithm>
+
+
+// Blocking of the matrix product: rows of A and of B (that is the inner dimension) processed
+// at a time, chosen so that the block of B stays in L2 and the rows of C in L1.
+#ifndef NN_GEMM_BLOCK_ROWS
+#define NN_GEMM_BLOCK_ROWS 64
+#endif
+
+#ifndef NN_GEMM_BLOCK_INNER
+#define NN_GEMM_BLOCK_INNER 256
+#endif
+
+
+// Vector types of the kernel. Operations on them are compiled into whatever SIMD
+// instructions the target offers, or split into scalar ones if there are none.
+
+template <class T> struct simd;
+
+template <> struct simd<float>
+{
+    typedef float type __attribute__ ((vector_size (32)));
+    enum { width = 8 };
+};
+
+template <> struct simd<double>
+{
+    typedef double type __attribute__ ((vector_size (32)));
+    enum { width = 4 };
+};
+
+
+// c[0, n) += a * b[0, n)
+
+template <class T> static inline void axpy (size_t n, T a, const T * b, T * c)
+{
+  typedef typename simd<T>::type V;
+  const size_t w = simd<T>::width;
+
+  V va;
+
+  for (size_t i = 0; i < w; i++) va[i] = a;
+
+  size_t j = 0;
+
+  for (; j + 2 * w <= n; j += 2 * w)
+  {
+    V b0, b1, c0, c1;
+
+    memcpy (&b0, b + j, sizeof (V));
+    memcpy (&b1, b + j + w, sizeof (V));
+    memcpy (&c0, c + j, sizeof (V));
+    memcpy (&c1, c + j + w, sizeof (V));
+
+    c0 += va * b0;
+    c1 += va * b1;
+
+    memcpy (c + j, &c0, sizeof (V));
+    memcpy (c + j + w, &c1, sizeof (V));
+  }
+
+  for (; j < n; j++) c[j] += a * b[j];
+}
+
+template <class T>
+void nn_gemm (size_t m, size_t n, size_t k, const T * a, size_t lda, const T * b, size_t ldb, T * c, size_t ldc)
+{
+  for (size_t p0 = 0; p0 < k; p0 += NN_GEMM_BLOCK_INNER)
+  {
+    size_t p1 = std::min (k, p0 + NN_GEMM_BLOCK_INNER);
+
+    for (size_t i0 = 0; i0 < m; i0 += NN_GEMM_BLOCK_ROWS)
+    {
+      size_t i1 = std::min (m, i0 + NN_GEMM_BLOCK_ROWS);
+
+      for (size_t i = i0; i < i1; i++)
+      {
+        const T * ai = a + i * lda;
+        T * ci = c + i * ldc;
+
+        for (size_t p = p0; p < p1; p++)
+          if (ai[p] != T ()) axpy (n, ai[p], b + p * ldb, ci);
+      }
+    }
+  }
+}
+
+template void nn_gemm<float> (size_t, size_t, size_t, const float *, size_t, const float *, size_t, float *, size_t);
+template void nn_gemm<double> (size_t, size_t, size_t, const double *, size_t, const double *, size_t, double *, size_t);
@@ -0,0 +1,50 @@
+/* ensemble.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include "Ensemble.h"
+#include <atomic>
+#include <thread>
+
+
+unsigned long int EnsembleBase::run_n (unsigned long int n)
+{
+  unsigned int t = n_threads ? n_threads : std::thread::hardware_concurrency ();
+
+  if (t == 0) t = 1;
+  if (t > size ()) t = size ();
+
+  std::atomic<size_t> next (0);
+  std::atomic<unsigned long int> total (0);
+
+  auto work = [&] ()
+  {
+    for (size_t i; (i = next.fetch_add (1)) < size ();) total += run_replica (i, n);
+  };
+
+  std::vector<std::thread> threads;
+
+  for (unsigned int i = 1; i < t; i++) threads.push_back (std::thread (work));
+
+  work ();
+
+  for (std::vector<std::thread>::iterator i = threads.begin (); i != threads.end (); i++) i->join ();
+
+  return total;
+}
@@ -0,0 +1,157 @@
+/* executor.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "libnn.h"
+#include <algorithm>
+
+
+StepExecutor::StepExecutor (unsigned int n_threads, size_t c) : chunk (c ? c : 1), stopping (false)
+{
+  if (n_threads == 0) n_threads = 1;
+
+  for (unsigned int i = 0; i < n_threads; i++) workers.push_back (std::thread (&StepExecutor::work, this));
+}
+
+StepExecutor::~StepExecutor ()
+{
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+
+    for (std::vector<Task *>::iterator i = runs.begin (); i != runs.end (); i++) (*i)->cancelled = true;
+
+    stopping = true;
+  }
+
+  ready.notify_all ();
+
+  for (std::vector<std::thread>::iterator i = workers.begin (); i != workers.end (); i++) i->join ();
+}
+
+std::future<RunStatus> StepExecutor::submit (NeuralNetwork & nn, unsigned long int max_iterations, double time_budget)
+{
+  Task * task = new Task;
+
+  task->network = &nn;
+  task->remaining = max_iterations;
+  task->has_deadline = time_budget > 0.0;
+  task->deadline = std::chrono::steady_clock::now () +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration> (std::chrono::duration<double> (time_budget));
+  task->cancelled = false;
+
+  std::future<RunStatus> f = task->result.get_future ();
+
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+
+    runs.push_back (task);
+    queue.push_back (task);
+  }
+
+  ready.notify_one ();
+
+  return f;
+}
+
+void StepExecutor::cancel (NeuralNetwork & nn)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  for (std::vector<Task *>::iterator i = runs.begin (); i != runs.end (); i++)
+    if ((*i)->network == &nn) (*i)->cancelled = true;
+}
+
+size_t StepExecutor::pending ()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  return runs.size ();
+}
+
+// Perform the next chunk of the task. Returns true if the run is finished, status telling why.
+
+bool StepExecutor::advance (Task & task, RunStatus & status)
+{
+  bool cancelled;
+
+  {
+    std::lock_guard<std::mutex> lock (mutex);
+
+    cancelled = task.cancelled;
+  }
+
+  if (cancelled) { status = RUN_CANCELLED; return true; }
+
+  if (task.remaining == 0) { status = RUN_MAX_ITERATIONS; return true; }
+
+  NeuralNetwork & nn = *task.network;
+
+  if (nn.step (chunk))
+  {
+    task.remaining--;
+
+    if (not nn.is_firing ()) { status = RUN_QUIESCENT; return true; }
+
+    if (task.remaining == 0) { status = RUN_MAX_ITERATIONS; return true; }
+  }
+
+  if (task.has_deadline and std::chrono::steady_clock::now () >= task.deadline) { status = RUN_TIME_BUDGET; return true; }
+
+  return false;
+}
+
+void StepExecutor::work ()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  for (;;)
+  {
+    while (queue.empty () and not stopping) ready.wait (lock);
+
+    if (queue.empty ()) return;
+
+    Task * task = queue.front ();
+    queue.pop_front ();
+
+    lock.unlock ();
+
+    RunStatus status;
+    bool finished = advance (*task, status);
+
+    lock.lock ();
+
+    if (finished)
+    {
+      runs.erase (std::find (runs.begin (), runs.end (), task));
+
+      task->result.set_value (status);
+
+      delete task;
+    }
+    else
+      queue.push_back (task);
+  }
+}
+
+
+std::future<RunStatus> NeuralNetwork::step_async (StepExecutor & executor, unsigned long int max_iterations, double time_budget)
+{
+  return executor.submit (*this, max_iterations, time_budget);
+}
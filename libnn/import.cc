@@ -0,0 +1,352 @@
+/* import.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include "libnn.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <vector>
+#include <algorithm>
+#include "parallel.h"
+
+
+// Size of the chunks the edge list files are read in.
+#ifndef NN_IMPORT_CHUNK_SIZE
+#define NN_IMPORT_CHUNK_SIZE (16 << 20)
+#endif
+
+
+struct vertex_pair
+{
+    unsigned long int source;
+    unsigned long int target;
+};
+
+typedef std::vector<vertex_pair> VertexPairs;
+
+
+static bool is_separator (char c) { return c == ' ' or c == '\t' or c == ',' or c == ';' or c == '\r'; }
+
+static bool parse_number (const char * & p, const char * end, unsigned long int & v)
+{
+  if (p == end or *p < '0' or *p > '9') return false;
+
+  for (v = 0; p != end and *p >= '0' and *p <= '9'; p++)
+  {
+    unsigned long int d = *p - '0';
+
+    if (v > (ULONG_MAX - d) / 10) return false; // overflow
+
+    v = v * 10 + d;
+  }
+
+  return true;
+}
+
+// Parse the complete lines within [p, end) and append the pairs found to out. Returns false
+// on malformed line.
+static bool parse_lines (const char * p, const char * end, VertexPairs & out)
+{
+  while (p != end)
+  {
+    while (p != end and is_separator (*p)) p++;
+
+    if (p != end and *p != '\n' and *p != '#' and *p != '%')
+    {
+      vertex_pair v;
+
+      if (not parse_number (p, end, v.source)) return false;
+
+      while (p != end and is_separator (*p)) p++;
+
+      if (not parse_number (p, end, v.target)) return false;
+
+      out.push_back (v);
+    }
+
+    while (p != end and *p != '\n') p++;
+
+    if (p != end) p++;
+  }
+
+  return true;
+}
+
+
+/*
+ * Reads the edge list file chunk by chunk. Text chunks always end at a line boundary, with
+ * the incomplete line carried over to the next chunk, and are parsed by several threads,
+ * each taking its own range of lines.
+ */
+class EdgeListReader
+{
+  public:
+
+    EdgeListReader (const char * filename, EdgeListFormat f, unsigned int n) :
+      file (fopen (filename, "rb")), format (f), n_threads (n), buffer (NN_IMPORT_CHUNK_SIZE + 1), carry (0), error (false), parts (n ? n : 1) {}
+
+    ~EdgeListReader () { if (file) fclose (file); }
+
+    bool is_open () const { return file != 0; }
+
+    void rewind () { ::rewind (file); carry = 0; }
+
+    // Read the next chunk of vertex pairs into pairs. Returns false at the end of file or on error,
+    // the latter being reported by failed ().
+    bool next (VertexPairs & pairs)
+    {
+      pairs.clear ();
+
+      return format == EDGE_LIST_TEXT ? next_text (pairs) : next_binary (pairs);
+    }
+
+    bool failed () const { return error or ferror (file); }
+
+  private:
+
+    bool next_text (VertexPairs & pairs)
+    {
+      size_t n = fread (&buffer[carry], 1, NN_IMPORT_CHUNK_SIZE - carry, file);
+      size_t total = carry + n;
+
+      error = false;
+
+      if (total == 0) return false;
+
+      size_t last; // end of the last complete line
+
+      if (n < NN_IMPORT_CHUNK_SIZE - carry)
+      {
+        if (buffer[total - 1] != '\n') buffer[total++] = '\n';
+
+        last = total;
+      }
+      else
+      {
+        for (last = total; last > 0 and buffer[last - 1] != '\n'; last--);
+
+        if (last == 0) { error = true; return false; } // line longer than the whole chunk
+      }
+
+      // Split the chunk into ranges of lines, one per thread.
+
+      unsigned int n_parts = parts.size ();
+      std::vector<size_t> bounds (n_parts + 1);
+
+      bounds[0] = 0;
+      bounds[n_parts] = last;
+
+      for (unsigned int i = 1; i < n_parts; i++)
+      {
+        size_t b = i * (last / n_parts);
+
+        if (b < bounds[i - 1]) b = bounds[i - 1];
+        while (b > 0 and b < last and buffer[b - 1] != '\n') b++;
+
+        bounds[i] = b;
+      }
+
+      std::vector<char> ok (n_parts, 1);
+
+      parallel_for (n_parts, n_threads, [&] (size_t begin, size_t end)
+      {
+        for (size_t i = begin; i < end; i++)
+        {
+          parts[i].clear ();
+          ok[i] = parse_lines (&buffer[bounds[i]], &buffer[bounds[i + 1]], parts[i]);
+        }
+      });
+
+      for (unsigned int i = 0; i < n_parts; i++)
+      {
+        if (not ok[i]) { error = true; return false; }
+
+        pairs.insert (pairs.end (), parts[i].begin (), parts[i].end ());
+      }
+
+      carry = total - last;
+      memmove (&buffer[0], &buffer[last], carry);
+
+      return true;
+    }
+
+    bool next_binary (VertexPairs & pairs)
+    {
+      size_t record = format == EDGE_LIST_BINARY32 ? 2 * sizeof (uint32_t) : 2 * sizeof (uint64_t);
+      size_t bytes = fread (&buffer[0], 1, NN_IMPORT_CHUNK_SIZE / record * record, file);
+      size_t n = bytes / record;
+
+      error = bytes % record != 0; // truncated last record
+
+      if (n == 0 or error) return false;
+
+      pairs.resize (n);
+
+      for (size_t i = 0; i < n; i++)
+      {
+        if (format == EDGE_LIST_BINARY32)
+        {
+          uint32_t v[2];
+
+          memcpy (v, &buffer[i * record], record);
+          pairs[i].source = v[0];
+          pairs[i].target = v[1];
+        }
+        else
+        {
+          uint64_t v[2];
+
+          memcpy (v, &buffer[i * record], record);
+          pairs[i].source = v[0];
+          pairs[i].target = v[1];
+        }
+      }
+
+      return true;
+    }
+
+    FILE * file;
+    EdgeListFormat format;
+    unsigned int n_threads;
+
+    std::vector<char> buffer;
+    size_t carry; // bytes of the incomplete line left at the beginning of the buffer
+    bool error;
+
+    std::vector<VertexPairs> parts;
+};
+
+
+// Delete the neurons from the first-th on, which the import has connected only to each other.
+static void remove_neurons (NeuronVector & neurons, NeuronVector::size_type first)
+{
+  for (NeuronVector::size_type i = first; i < neurons.size (); i++) delete neurons[i];
+
+  neurons.resize (first);
+}
+
+
+bool NeuralNetwork::import_edge_list (const char * filename, EdgeListFormat format, NeuronFactoryBase & factory,
+                                      unsigned int n_threads, unsigned long int max_vertices)
+{
+  if (n_threads == 0) n_threads = std::thread::hardware_concurrency ();
+
+  // Neurons are numbered by nn_id_t (see NeuronBase::id ()).
+  unsigned long int id_limit = (nn_id_t)~(nn_id_t)0 - neurons.size ();
+
+  if (max_vertices > id_limit) max_vertices = id_limit;
+
+  EdgeListReader reader (filename, format, n_threads);
+
+  if (not reader.is_open ()) return false;
+
+  VertexPairs pairs;
+
+  // First pass: count synapses (outgoing edges) and dendrites (incoming edges) of each vertex.
+
+  std::vector<unsigned int> n_synapses;
+  std::vector<unsigned int> n_dendrites;
+
+  while (reader.next (pairs))
+  {
+    for (VertexPairs::iterator i = pairs.begin (); i != pairs.end (); i++)
+    {
+      unsigned long int m = i->source > i->target ? i->source : i->target;
+
+      if (m >= max_vertices) return false;
+
+      if (m >= n_synapses.size ())
+      {
+        n_synapses.resize (m + 1, 0);
+        n_dendrites.resize (m + 1, 0);
+      }
+
+      if (n_synapses[i->source] == UINT_MAX or n_dendrites[i->target] == UINT_MAX) return false;
+
+      n_synapses[i->source]++;
+      n_dendrites[i->target]++;
+    }
+  }
+
+  if (reader.failed ()) return false;
+
+  NeuronVector::size_type first = neurons.size ();
+  NeuronVector::size_type n_vertices = n_synapses.size ();
+
+  neurons.reserve (first + n_vertices);
+
+  for (NeuronVector::size_type i = 0; i < n_vertices; i++) create_neuron (factory, n_dendrites[i], n_synapses[i]);
+
+  // A factory may refuse to create a neuron (see FixedNeuron), which would shift the rest.
+
+  if (neurons.size () != first + n_vertices)
+  {
+    remove_neurons (neurons, first);
+    return false;
+  }
+
+  // Second pass: make the connections, assigning consecutive synapses and dendrites of each
+  // neuron to its edges. The counters from the first pass are reused as slot counters.
+
+  std::fill (n_synapses.begin (), n_synapses.end (), 0);
+  std::fill (n_dendrites.begin (), n_dendrites.end (), 0);
+
+  std::vector<Edge> edges;
+
+  bool ok = true;
+
+  reader.rewind ();
+
+  while (ok and reader.next (pairs))
+  {
+    edges.resize (pairs.size ());
+
+    for (VertexPairs::size_type i = 0; ok and i < pairs.size (); i++)
+    {
+      const vertex_pair & v = pairs[i];
+
+      // The file may have changed between the passes.
+      if (v.source >= n_vertices or v.target >= n_vertices)
+      {
+        ok = false;
+        break;
+      }
+
+      Edge & e = edges[i];
+
+      e.source = first + v.source;
+      e.synapse = n_synapses[v.source]++;
+      e.target = first + v.target;
+      e.dendrite = n_dendrites[v.target]++;
+
+      ok = e.synapse < neurons[e.source]->n_synapses () and e.dendrite < neurons[e.target]->n_dendrites ();
+    }
+
+    if (ok and not edges.empty ()) wire (&edges[0], edges.size (), n_threads);
+  }
+
+  if (ok and not reader.failed ()) return true;
+
+  remove_neurons (neurons, first);
+  feedback_index_valid = false;
+
+  return false;
+}
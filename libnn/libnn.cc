@@ -20,11 +20,43 @@
 
 #include "libnn.h"
 #include <stdlib.h>
+#include <cstddef>
 #include <time.h>
 #include <iostream>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include "parallel.h"
 // #include <alloca.h>
 
 
+// Number of dendrites the gather phase of the gather-apply-scatter engine prefetches the
+// source neurons of ahead of reading their signals.
+#ifndef NN_GATHER_PREFETCH_DISTANCE
+#define NN_GATHER_PREFETCH_DISTANCE 8
+#endif
+
+static const size_t NONE = (size_t)-1;
+
+
+// Random number in [0, n). rand () gives as few as 15 or 31 random bits, so for larger ranges
+// the results of several calls are combined. Smaller ranges keep using a single call, which
+// leaves the random networks generated for a given seed unchanged.
+static unsigned long int random_index (unsigned long int n)
+{
+  if (n <= (unsigned long int)RAND_MAX) return rand () % n;
+
+  unsigned long int r = 0;
+
+  for (unsigned long int range = 1; range < n and range != 0; range *= (unsigned long int)RAND_MAX + 1)
+    r = r * ((unsigned long int)RAND_MAX + 1) + rand ();
+
+  return r % n;
+}
+
+
 NeuralNetwork::NeuralNetwork()
 {
   current_queue = new NeuronVector ();
@@ -33,7 +65,29 @@ NeuralNetwork::NeuralNetwork()
   bp_next_queue = new NeuronVector ();
 
   propagator_store = 0;
+  bp_propagator_store = 0;
   propagator_store_size = 0;
+
+  pipelined = false;
+  bp_log = 0;
+
+  type_bucketing = false;
+
+  feedback_index = false;
+  feedback_index_valid = false;
+
+  gather_apply_scatter = false;
+  gather_threads = 1;
+
+  step_phase = STEP_IDLE;
+  step_position = 0;
+
+  period = 0;
+  cycle_tracking = false;
+  network_hash = 0;
+
+  iteration = 0;
+  epoch = 0;
 }
 
 NeuralNetwork::~NeuralNetwork()
@@ -43,7 +97,8 @@ NeuralNetwork::~NeuralNetwork()
   delete bp_current_queue;
   delete bp_next_queue;
 
-  delete propagator_store;
+  free (propagator_store);
+  free (bp_propagator_store);
 }
 
 void NeuralNetwork::add_to_update_queue (NeuronBase * n)
@@ -55,9 +110,20 @@ void NeuralNetwork::add_to_update_queue (NeuronBase * n)
   }
 }
 
+void NeuralNetwork::fire (NeuronBase * n)
+{
+  if (! n->in_update_queue_already ())
+  {
+    current_queue->push_back (n);
+    n->set_in_update_queue (true);
+  }
+}
+
 void NeuralNetwork::add_to_bp_update_queue (NeuronBase * n)
 {
-  if (! n->in_bp_update_queue_already())
+  if (bp_log)
+    bp_log->push_back (n);
+  else if (! n->in_bp_update_queue_already())
   {
     bp_next_queue->push_back (n);
     n->set_in_bp_update_queue (true);
@@ -92,7 +158,11 @@ void NeuralNetwork::create_neuron (NeuronFactoryBase & factory, unsigned int n_d
 {
   NeuronBase * neuron = factory.create(n_dendrites, n_synapses);
 
+  if (neuron == 0) return;
+
+  neuron->neuron_id = neurons.size ();
   neurons.push_back (neuron);
+  feedback_index_valid = false;
 
   size_t propagator_size = neuron->sizeof_propagator();
 
@@ -100,16 +170,21 @@ void NeuralNetwork::create_neuron (NeuronFactoryBase & factory, unsigned int n_d
   {
     propagator_store_size = propagator_size;
     propagator_store = (PropagatorBase *)realloc (propagator_store, propagator_store_size);
+
+    // The store of the backpropagation thread never holds a live propagator between
+    // iterations, so there is nothing to move over.
+    free (bp_propagator_store);
+    bp_propagator_store = (PropagatorBase *)malloc (propagator_store_size);
   }
 }
 
 void NeuralNetwork::start ()
 {
-  NeuronVector::size_type nn = rand () % neurons.size ();
+  NeuronVector::size_type nn = random_index (neurons.size ());
 
   for (NeuronVector::size_type i = 0; i < nn; i++)
   {
-    NeuronBase * n = neurons[rand () % neurons.size ()];
+    NeuronBase * n = neurons[random_index (neurons.size ())];
 
     add_to_update_queue (n);
   }
@@ -117,51 +192,907 @@ void NeuralNetwork::start ()
   swap_update_queues ();
 }
 
-void NeuralNetwork::run ()
+void NeuralNetwork::poll_inputs ()
+{
+  for (std::vector<SensoryInputBase *>::iterator i = inputs.begin (); i != inputs.end (); i++)
+  {
+    changed_inputs.clear ();
+
+    if ((*i)->poll (changed_inputs))
+      for (NeuronVector::iterator n = changed_inputs.begin (); n != changed_inputs.end (); n++)
+        if (! (*n)->in_update_queue_already ())
+        {
+          current_queue->push_back (*n);
+          (*n)->set_in_update_queue (true);
+        }
+  }
+}
+
+// Only the stimuli up to last, the last one injected when the iteration began, are taken,
+// so that the producers can't hold the network up. The neurons whose state the stimuli set
+// are added to set, if given.
+
+void NeuralNetwork::take_stimuli (Stimulus * last, NeuronVector * set)
 {
-  if (current_queue->size ())
+  while (last)
   {
-    for (NeuronVector::iterator i = current_queue->begin (); i != current_queue->end (); i++)
+    Stimulus * s = stimuli.pop ();
+
+    if (s == 0) break;
+    if (s == last) last = 0;
+
+    if (s->index < neurons.size () and s->apply_to (*neurons[s->index]))
     {
-      NeuronBase & neuron = **i;
+      NeuronBase & n = *neurons[s->index];
 
-      neuron.set_in_update_queue (false);
+      if (s->has_state ())
+      {
+        n.dirty = 1;
+        n.state_version++;
+
+        PropagatorBase & p = n.propagator (propagator_store);
 
-      PropagatorBase & p = neuron.propagator (propagator_store);
+        for (NeuronBase * t = p.first_synapse (); t != p.null (); t = p.next_synapse ()) fire (t);
+
+        state_changed (n);
+
+        if (set) set->push_back (&n);
+      }
+      else
+        fire (&n);
+    }
+
+    s->release ();
+  }
+}
 
-      if (p ())
+// Apply the topology changes logged before the iteration began. No propagator of the network
+// is alive at this point, neither is the backpropagation thread of the pipelined mode, so
+// the connectors may be reallocated and the storage they leave is reclaimed right away.
+
+void NeuralNetwork::apply_topology_changes ()
+{
+  TopologyChange * last = topology_log.last ();
+  bool changed = false;
+
+  while (last)
+  {
+    TopologyChange * c = topology_log.pop ();
+
+    if (c == 0) break;
+    if (c == last) last = 0;
+
+    if (apply_topology_change (*c)) changed = true;
+
+    c->release ();
+  }
+
+  if (changed)
+  {
+    feedback_index_valid = false;
+    epoch.fetch_add (1, std::memory_order_release);
+  }
+}
+
+bool NeuralNetwork::apply_topology_change (const TopologyChange & c)
+{
+  if (c.source >= neurons.size ()) return false;
+
+  NeuronBase * a = neurons[c.source];
+
+  if (c.kind == TopologyChange::DISCONNECT)
+  {
+    if (not a->is_synapse_connected (c.synapse)) return false;
+
+    NeuronBase * t = const_cast<NeuronBase *> (a->synapse_target (c.synapse));
+
+    a->disconnect_synapse (c.synapse);
+    fire (t);
+
+    return true;
+  }
+
+  if (c.target >= neurons.size ()) return false;
+
+  NeuronBase * b = neurons[c.target];
+
+  if ((c.synapse != TopologyChange::NEW and c.synapse >= a->n_synapses ()) or
+      (c.dendrite != TopologyChange::NEW and c.dendrite >= b->n_dendrites ())) return false;
+
+  Connector::size_type synapse = c.synapse;
+  Connector::size_type dendrite = c.dendrite;
+
+  if (synapse == TopologyChange::NEW)
+  {
+    synapse = a->n_synapses ();
+    a->add_synapse ();
+  }
+
+  if (dendrite == TopologyChange::NEW)
+  {
+    dendrite = b->n_dendrites ();
+    b->add_dendrite ();
+  }
+
+  if (synapse >= a->n_synapses () or dendrite >= b->n_dendrites ()) return false;
+
+  if (a->is_synapse_connected (synapse)) fire (const_cast<NeuronBase *> (a->synapse_target (synapse)));
+
+  connect (a, synapse, b, dendrite);
+  fire (b);
+
+  return true;
+}
+
+// Recompute the neurons at positions [begin, end) of the current update queue and propagate
+// their signals. Neurons to backpropagate to are added to the backpropagation queue, or if
+// bp_deferred is given, just collected there.
+
+void NeuralNetwork::forward_pass (PropagatorBase * store, NeuronVector * bp_deferred, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; i++)
+  {
+    NeuronBase & neuron = *(*current_queue)[i];
+
+    if (type_bucketing and neuron.type () < runners.size () and runners[neuron.type ()].forward)
+    {
+      size_t j = bucket_end (*current_queue, i, end);
+
+      (this->*runners[neuron.type ()].forward) (store, bp_deferred, i, j);
+
+      i = j - 1;
+      continue;
+    }
+
+    neuron.set_in_update_queue (false);
+
+    PropagatorBase & p = neuron.propagator (store);
+
+    neuron.dirty = 1;
+    neuron.state_version++;
+
+    if (p ())
+    {
+      for (NeuronBase * n = p.first_synapse (); n != p.null (); n = p.next_synapse ()) add_to_update_queue (n);
+
+      if (p.should_backpropagate ())
       {
-        for (NeuronBase * n = p.first_synapse (); n != p.null (); n = p.next_synapse ()) add_to_update_queue (n);
+        if (bp_deferred)
+          for (NeuronBase * n = p.first_dendrite (); n != p.null (); n = p.next_dendrite ()) bp_deferred->push_back (n);
+        else
+          for (NeuronBase * n = p.first_dendrite (); n != p.null (); n = p.next_dendrite ()) add_to_bp_update_queue (n);
+      }
+    }
+
+    state_changed (neuron);
+  }
+}
+
+// Read the inputs of all the neurons of the current update queue into gather_buffer. Neurons
+// which can't take them read in advance get NONE as their offset.
+
+void NeuralNetwork::gather_inputs ()
+{
+  const size_t align = alignof (std::max_align_t);
+  const NeuronVector & queue = *current_queue;
+
+  gather_edges.clear ();
+  gather_offset.resize (queue.size ());
+
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < queue.size (); i++)
+  {
+    const NeuronBase & n = *queue[i];
+    size_t slot = n.sizeof_input ();
+
+    gather_offset[i] = NONE;
+
+    if (slot == 0) continue;
+
+    gather_offset[i] = bytes;
+
+    Connector::size_type nd = n.n_dendrites ();
+
+    for (Connector::size_type k = 0; k < nd; k++)
+    {
+      const NeuronBase * s = n.dendrite_source (k);
+
+      if (s == 0) continue;
 
-        if (p.should_backpropagate ())
+      GatherEdge e = { s, n.dendrite_synapse (k), bytes };
+
+      gather_edges.push_back (e);
+      bytes += slot;
+    }
+
+    bytes = (bytes + align - 1) / align * align;
+  }
+
+  if (gather_buffer.size () < bytes) gather_buffer.resize (bytes);
+
+  parallel_for (gather_edges.size (), gather_threads, [&] (size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; i++)
+    {
+      if (i + NN_GATHER_PREFETCH_DISTANCE < end) __builtin_prefetch (gather_edges[i + NN_GATHER_PREFETCH_DISTANCE].source);
+
+      const GatherEdge & e = gather_edges[i];
+
+      e.source->propagate (e.synapse, &gather_buffer[e.offset]);
+    }
+  });
+}
+
+// Same as forward_pass () over the whole update queue, split into the gather, apply and
+// scatter phases. The versions of the recomputed neurons are bumped only after the apply
+// phase, so that the incremental neurons see them change together with the inputs. The
+// neurons which can't take their inputs read in advance are recomputed first, before any
+// other neuron changes its state. Each neuron's propagator is kept in its own slot of
+// apply_store from the apply phase to the scatter phase.
+
+void NeuralNetwork::gather_apply_scatter_pass (NeuronVector * bp_deferred)
+{
+  const NeuronVector & queue = *current_queue;
+  const size_t stride = (propagator_store_size + sizeof (std::max_align_t) - 1) / sizeof (std::max_align_t);
+
+  gather_inputs ();
+
+  applied.resize (queue.size ());
+  if (apply_store.size () < queue.size () * stride) apply_store.resize (queue.size () * stride);
+
+  for (int fallback = 1; fallback >= 0; fallback--)
+    for (size_t i = 0; i < queue.size (); i++)
+    {
+      if ((gather_offset[i] == NONE) != fallback) continue;
+
+      NeuronBase & neuron = *queue[i];
+
+      neuron.set_in_update_queue (false);
+
+      PropagatorBase & p = neuron.propagator ((PropagatorBase *)&apply_store[i * stride]);
+
+      if (fallback ? p () : p.recompute_inputs (&gather_buffer[gather_offset[i]]))
+        applied[i] = p.should_backpropagate () ? 2 : 1;
+      else
+        applied[i] = 0;
+    }
+
+  for (size_t i = 0; i < queue.size (); i++)
+  {
+    NeuronBase & neuron = *queue[i];
+
+    neuron.dirty = 1;
+    neuron.state_version++;
+
+    if (applied[i] != 0)
+    {
+      PropagatorBase & p = *(PropagatorBase *)&apply_store[i * stride];
+
+      for (NeuronBase * n = p.first_synapse (); n != p.null (); n = p.next_synapse ()) add_to_update_queue (n);
+
+      if (applied[i] == 2)
+      {
+        if (bp_deferred)
+          for (NeuronBase * n = p.first_dendrite (); n != p.null (); n = p.next_dendrite ()) bp_deferred->push_back (n);
+        else
           for (NeuronBase * n = p.first_dendrite (); n != p.null (); n = p.next_dendrite ()) add_to_bp_update_queue (n);
       }
     }
 
+    state_changed (neuron);
+  }
+}
+
+void NeuralNetwork::backward_pass (const NeuronVector & queue, PropagatorBase * store, size_t begin, size_t end)
+{
+  for (size_t i = begin; i < end; i++)
+  {
+    NeuronBase & neuron = *queue[i];
+
+    if (type_bucketing and neuron.type () < runners.size () and runners[neuron.type ()].backward)
+    {
+      size_t j = bucket_end (queue, i, end);
+
+      (this->*runners[neuron.type ()].backward) (queue, store, i, j);
+
+      i = j - 1;
+      continue;
+    }
+
+    neuron.set_in_bp_update_queue (false);
+
+    PropagatorBase & p = neuron.propagator (store);
+
+    neuron.dirty = 1;
+    neuron.state_version++;
+
+    const void * feedback = feedback_index ? feedback_row (neuron) : 0;
+
+    if (feedback ? p.backpropagate_feedback (feedback) : p.backpropagate ())
+      for (NeuronBase * n = p.first_dendrite (); n != p.null (); n = p.next_dendrite ()) add_to_bp_update_queue (n);
+
+    if (bp_log) bp_log->push_back (0);
+
+    state_changed (neuron);
+  }
+}
+
+// Backpropagation by the neuron may run concurrently with the forward pass only if neither
+// the neuron itself nor any of its synapses' targets is going to be recomputed in that pass.
+// Otherwise the neuron would write the state the forward pass reads, or read the states
+// the forward pass writes.
+
+bool NeuralNetwork::conflicts_with_forward_pass (const NeuronBase & n)
+{
+  if (n.in_update_queue_already ()) return true;
+
+  Connector::size_type ns = n.n_synapses ();
+
+  for (Connector::size_type i = 0; i < ns; i++)
+  {
+    const NeuronBase * t = n.synapse_target (i);
+
+    if (t != 0 and t->in_update_queue_already ()) return true;
+  }
+
+  return false;
+}
+
+void NeuralNetwork::run_pipelined ()
+{
+  bp_concurrent.clear ();
+  bp_serial.clear ();
+
+  for (NeuronVector::iterator i = bp_current_queue->begin (); i != bp_current_queue->end (); i++)
+  {
+    if (conflicts_with_forward_pass (**i)) bp_serial.push_back (*i);
+    else bp_concurrent.push_back (*i);
+  }
+
+  // The backward passes don't queue the neurons they backpropagate to, but log them for
+  // queue_logged_backpropagation (). The forward pass doesn't touch bp_log.
+
+  bp_logged.clear ();
+  bp_log = &bp_logged;
+
+  std::thread worker;
+
+  if (not bp_concurrent.empty ())
+    worker = std::thread (&NeuralNetwork::backward_pass, this, std::cref (bp_concurrent), bp_propagator_store,
+                          0, bp_concurrent.size ());
+
+  if (gather_apply_scatter)
+    gather_apply_scatter_pass (&bp_deferred);
+  else
+    forward_pass (propagator_store, &bp_deferred, 0, current_queue->size ());
+
+  swap_update_queues ();
+
+  if (worker.joinable ()) worker.join ();
+
+  backward_pass (bp_serial, propagator_store, 0, bp_serial.size ());
+
+  bp_log = 0;
+
+  // This must happen before the swap: queued after it the neurons would wait an extra
+  // iteration, or be lost with their flags set if the network stopped as quiescent in the
+  // meantime.
+
+  queue_logged_backpropagation ();
+
+  swap_bp_update_queues ();
+}
+
+// Queue the neurons to backpropagate to exactly as the sequential mode would have: first those
+// of the forward pass, skipping the neurons still waiting in the current backpropagation
+// queue, then those of each backpropagating neuron in the order of that queue, skipping the
+// neurons further on in it. bp_logged holds the neurons of bp_concurrent followed by those of
+// bp_serial, both in the order of the queue.
+
+void NeuralNetwork::queue_logged_backpropagation ()
+{
+  NeuronVector & queue = *bp_current_queue;
+
+  for (NeuronVector::iterator i = queue.begin (); i != queue.end (); i++) (*i)->set_in_bp_update_queue (true);
+  for (NeuronVector::iterator i = bp_deferred.begin (); i != bp_deferred.end (); i++) add_to_bp_update_queue (*i);
+
+  bp_deferred.clear ();
+
+  // Positions within bp_logged of the neurons of the next neuron of bp_concurrent and of
+  // bp_serial.
+
+  size_t concurrent = 0, concurrent_log = 0, serial_log = 0;
+
+  for (size_t k = 0; k < bp_concurrent.size (); k++) while (bp_logged[serial_log++] != 0);
+
+  for (NeuronVector::iterator i = queue.begin (); i != queue.end (); i++)
+  {
+    bool is_concurrent = concurrent < bp_concurrent.size () and bp_concurrent[concurrent] == *i;
+    size_t & log = is_concurrent ? concurrent_log : serial_log;
+
+    concurrent += is_concurrent;
+
+    (*i)->set_in_bp_update_queue (false);
+
+    for (; bp_logged[log] != 0; log++) add_to_bp_update_queue (bp_logged[log]);
+
+    log++;
+  }
+}
+
+// Stable counting sort of the queue by the neurons' type tags.
+
+void NeuralNetwork::bucket_by_type (NeuronVector & queue)
+{
+  if (queue.size () < 2) return;
+
+  __uint16_t first = queue[0]->type ();
+  __uint16_t max = first;
+  bool mixed = false;
+
+  for (NeuronVector::iterator i = queue.begin (); i != queue.end (); i++)
+  {
+    __uint16_t t = (*i)->type ();
+
+    if (t != first) mixed = true;
+    if (t > max) max = t;
+  }
+
+  if (not mixed) return;
+
+  bucket_offsets.assign (max + 2, 0);
+
+  for (NeuronVector::iterator i = queue.begin (); i != queue.end (); i++) bucket_offsets[(*i)->type () + 1]++;
+
+  for (size_t t = 1; t < bucket_offsets.size (); t++) bucket_offsets[t] += bucket_offsets[t - 1];
+
+  bucketed.resize (queue.size ());
+
+  for (NeuronVector::iterator i = queue.begin (); i != queue.end (); i++) bucketed[bucket_offsets[(*i)->type ()]++] = *i;
+
+  queue.swap (bucketed);
+}
+
+// End of the bucket of neurons of the same class starting at begin, at most end.
+
+size_t NeuralNetwork::bucket_end (const NeuronVector & queue, size_t begin, size_t end)
+{
+  __uint16_t t = queue[begin]->type ();
+
+  while (++begin < end and queue[begin]->type () == t);
+
+  return begin;
+}
+
+// Rows of the feedback index are laid out in the order of the neurons within the network,
+// each row's slots aligned for any signal type. The slots of a neuron's dendrites are kept
+// in the same order as its dendrites, so that the neuron writes its feedback with a single
+// virtual call (see scatter_feedback ()).
+
+void NeuralNetwork::build_feedback_index ()
+{
+  const size_t align = alignof (std::max_align_t);
+  const size_t n_neurons = neurons.size ();
+
+  feedback_offset.assign (n_neurons, NONE);
+  feedback_slots_begin.assign (n_neurons + 1, 0);
+
+  size_t bytes = 0;
+
+  for (size_t i = 0; i < n_neurons; i++)
+  {
+    const NeuronBase & n = *neurons[i];
+    size_t slot = n.sizeof_feedback ();
+    size_t connected = 0;
+    bool self = false;
+
+    if (slot == 0) continue;
+
+    Connector::size_type ns = n.n_synapses ();
+
+    for (Connector::size_type k = 0; k < ns and not self; k++)
+    {
+      const NeuronBase * t = n.synapse_target (k);
+
+      if (t == 0) continue;
+
+      connected++;
+      self = t == &n; // the feedback would depend on the synapses processed before
+    }
+
+    if (self or connected == 0) continue;
+
+    feedback_offset[i] = bytes;
+
+    for (Connector::size_type k = 0; k < ns; k++)
+    {
+      const NeuronBase * t = n.synapse_target (k);
+
+      if (t != 0) feedback_slots_begin[t->neuron_id] = 1; // t feeds an indexed neuron
+    }
+
+    bytes += (connected * slot + align - 1) / align * align;
+  }
+
+  // Only the neurons feeding an indexed neuron get slots for their dendrites.
+
+  size_t n_slots = 0;
+
+  for (size_t i = 0; i < n_neurons; i++)
+  {
+    bool feeds = feedback_slots_begin[i];
+
+    feedback_slots_begin[i] = n_slots;
+    if (feeds) n_slots += neurons[i]->n_dendrites ();
+  }
+
+  feedback_slots_begin[n_neurons] = n_slots;
+  feedback_slots.assign (n_slots, NONE);
+
+  for (size_t i = 0; i < n_neurons; i++)
+  {
+    if (feedback_offset[i] == NONE) continue;
+
+    const NeuronBase & n = *neurons[i];
+    size_t slot = n.sizeof_feedback ();
+    size_t f = feedback_offset[i];
+    Connector::size_type ns = n.n_synapses ();
+
+    for (Connector::size_type k = 0; k < ns; k++)
+    {
+      const NeuronBase * t = n.synapse_target (k);
+
+      if (t == 0) continue;
+
+      feedback_slots[feedback_slots_begin[t->neuron_id] + n.synapse_dendrite (k)] = f;
+      f += slot;
+    }
+  }
+
+  feedback_buffer.resize (bytes);
+  feedback_index_valid = true;
+
+  for (size_t i = 0; i < n_neurons; i++) scatter_feedback (*neurons[i]);
+}
+
+// Write the feedback of all the dendrites of n into the rows of the neurons they are
+// connected to. To be called after any change of n's state or of its dendrites' states.
+
+void NeuralNetwork::scatter_feedback (const NeuronBase & n)
+{
+  if (not feedback_index or not feedback_index_valid) return;
+
+  size_t first = feedback_slots_begin[n.neuron_id];
+
+  if (first != feedback_slots_begin[n.neuron_id + 1]) n.backpropagate_dendrites (&feedback_slots[first], &feedback_buffer[0]);
+}
+
+// To be called after any change of n's state or of its dendrites' states.
+
+void NeuralNetwork::state_changed (const NeuronBase & n)
+{
+  scatter_feedback (n);
+
+  if (cycle_tracking)
+  {
+    __uint64_t h = neuron_hash (n);
+
+    network_hash.fetch_add (h - neuron_hashes[n.neuron_id], std::memory_order_relaxed);
+    neuron_hashes[n.neuron_id] = h;
+  }
+}
+
+__uint64_t NeuralNetwork::neuron_hash (const NeuronBase & n)
+{
+  nn_id_t id = n.neuron_id;
+
+  return nn_hash_bytes (&id, sizeof (id), n.state_hash ());
+}
+
+// Row of the feedback of all the synapses of n, or 0 if n is not in the index.
+
+const void * NeuralNetwork::feedback_row (const NeuronBase & n) const
+{
+  if (not feedback_index_valid or feedback_offset[n.neuron_id] == NONE) return 0;
+
+  return &feedback_buffer[feedback_offset[n.neuron_id]];
+}
+
+void NeuralNetwork::begin_iteration ()
+{
+  Stimulus * last_stimulus = stimuli.last ();
+
+  apply_topology_changes ();
+  poll_inputs ();
+  take_stimuli (last_stimulus);
+
+  if (type_bucketing)
+  {
+    bucket_by_type (*current_queue);
+    bucket_by_type (*bp_current_queue);
+  }
+
+  if (feedback_index and not feedback_index_valid) build_feedback_index ();
+
+  for (std::vector<OutputSinkBase *>::iterator i = outputs.begin (); i != outputs.end (); i++) (*i)->begin_iteration (iteration);
+}
+
+void NeuralNetwork::end_iteration ()
+{
+  for (std::vector<OutputSinkBase *>::iterator i = outputs.begin (); i != outputs.end (); i++) (*i)->end_iteration ();
+
+  iteration++;
+}
+
+void NeuralNetwork::run ()
+{
+  if (pipelined and step_phase == STEP_IDLE)
+  {
+    begin_iteration ();
+    run_pipelined ();
+    end_iteration ();
+  }
+  else
+    step ((size_t)-1);
+}
+
+bool NeuralNetwork::step (size_t max_neurons)
+{
+  if (step_phase == STEP_IDLE)
+  {
+    if (pipelined)
+    {
+      run ();
+      return true;
+    }
+
+    begin_iteration ();
+
+    step_phase = STEP_FORWARD;
+    step_position = 0;
+  }
+
+  if (step_phase == STEP_FORWARD)
+  {
+    size_t n = current_queue->size () - step_position;
+
+    // The gather-apply-scatter engine reads the inputs of the whole queue before recomputing
+    // any neuron, so it recomputes all of it in one step, whatever max_neurons is. A forward
+    // propagation begun without it is finished without it.
+
+    if (gather_apply_scatter and step_position == 0)
+      gather_apply_scatter_pass (0);
+    else
+    {
+      n = std::min (n, max_neurons);
+      forward_pass (propagator_store, 0, step_position, step_position + n);
+    }
+
+    step_position += n;
+    max_neurons -= std::min (n, max_neurons);
+
+    if (step_position < current_queue->size ()) return false;
+
     swap_update_queues ();
+
+    step_phase = STEP_BACKWARD;
+    step_position = 0;
+  }
+
+  size_t n = std::min (bp_current_queue->size () - step_position, max_neurons);
+
+  backward_pass (*bp_current_queue, propagator_store, step_position, step_position + n);
+
+  step_position += n;
+
+  if (step_position < bp_current_queue->size ()) return false;
+
+  swap_bp_update_queues ();
+
+  step_phase = STEP_IDLE;
+
+  end_iteration ();
+
+  return true;
+}
+
+unsigned long int NeuralNetwork::run_n (unsigned long int n)
+{
+  unsigned long int first = iteration;
+
+  run_until (n);
+
+  return iteration - first;
+}
+
+RunStatus NeuralNetwork::run_until (unsigned long int max_iterations, double time_budget, RunCondition * condition)
+{
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now () +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration> (std::chrono::duration<double> (time_budget));
+
+  size_t window = cycle_hashes.size ();
+  size_t n_hashes = 0;
+  RunStatus status = RUN_MAX_ITERATIONS;
+
+  period = 0;
+
+  // The states may have been changed directly since the last run, so the hash of the whole
+  // network is computed anew and then kept up to date as the neurons change.
+
+  if (window)
+  {
+    neuron_hashes.resize (neurons.size ());
+    network_hash = 0;
+
+    for (size_t i = 0; i < neurons.size (); i++)
+    {
+      neuron_hashes[i] = neuron_hash (*neurons[i]);
+      network_hash += neuron_hashes[i];
+    }
+
+    cycle_tracking = true;
   }
 
-  if (bp_current_queue->size ())
+  for (unsigned long int i = 0; i < max_iterations; i++)
   {
-    for (NeuronVector::iterator i = bp_current_queue->begin (); i != bp_current_queue->end (); i++)
+    run ();
+
+    if (not is_firing ()) { status = RUN_QUIESCENT; break; }
+
+    if (condition and (*condition) (*this)) { status = RUN_CONDITION; break; }
+
+    if (window)
     {
-      NeuronBase & neuron = **i;
+      __uint64_t h = frontier_hash () ^ network_hash.load (std::memory_order_relaxed);
+      bool cycle = false;
 
-      neuron.set_in_bp_update_queue (false);
+      for (size_t k = 0; k < n_hashes and k < window and not cycle; k++)
+        if (cycle_hashes[k] == h)
+        {
+          period = iteration - cycle_iterations[k];
+          cycle = true;
+        }
 
-      PropagatorBase & p = neuron.propagator (propagator_store);
+      if (cycle) { status = RUN_CYCLE; break; }
 
-      if (p.backpropagate ())
-        for (NeuronBase * n = p.first_dendrite (); n != p.null (); n = p.next_dendrite ()) add_to_bp_update_queue (n);
+      cycle_hashes[n_hashes % window] = h;
+      cycle_iterations[n_hashes % window] = iteration;
+      n_hashes++;
     }
 
-    swap_bp_update_queues ();
+    if (time_budget > 0.0 and std::chrono::steady_clock::now () >= deadline) { status = RUN_TIME_BUDGET; break; }
+  }
+
+  cycle_tracking = false;
+
+  return status;
+}
+
+void NeuralNetwork::set_cycle_detection (unsigned int window)
+{
+  cycle_hashes.assign (window, 0);
+  cycle_iterations.assign (window, 0);
+}
+
+// Hash of which neurons are queued. The states are taken into account by network_hash. The
+// hash doesn't depend on the order of neurons within the queues.
+
+__uint64_t NeuralNetwork::frontier_hash () const
+{
+  __uint64_t h = 0;
+
+  for (NeuronVector::const_iterator i = current_queue->begin (); i != current_queue->end (); i++)
+  {
+    nn_id_t id = (*i)->neuron_id;
+
+    h += nn_hash_bytes (&id, sizeof (id));
+  }
+
+  for (NeuronVector::const_iterator i = bp_current_queue->begin (); i != bp_current_queue->end (); i++)
+  {
+    nn_id_t id = (*i)->neuron_id;
+
+    h += nn_hash_bytes (&id, sizeof (id), ~14695981039346656037ULL);
   }
+
+  return h;
 }
 
 void NeuralNetwork::connect (NeuronBase * a, Connector::size_type synapse, NeuronBase * b, Connector::size_type dendrite)
 {
   a->connect_synapse (synapse, b, dendrite);
+  feedback_index_valid = false;
+}
+
+// Bit set with atomic test-and-set used for detecting connectors listed more than once.
+struct atomic_bitset
+{
+    atomic_bitset (size_t n) : words (new std::atomic<unsigned long> [n / 64 + 1])
+    {
+      for (size_t i = 0; i <= n / 64; i++) words[i].store (0, std::memory_order_relaxed);
+    }
+
+    ~atomic_bitset () { delete [] words; }
+
+    // Sets the i-th bit and returns its previous value.
+    bool test_and_set (size_t i)
+    {
+      unsigned long mask = 1UL << (i % 64);
+
+      return words[i / 64].fetch_or (mask, std::memory_order_relaxed) & mask;
+    }
+
+    std::atomic<unsigned long> * words;
+};
+
+bool NeuralNetwork::connect (const Edge * edges, size_t n_edges, unsigned int n_threads)
+{
+  NeuronVector::size_type n_neurons = neurons.size ();
+
+  // Offsets of each neuron's synapses and dendrites within the bit sets of all the synapses
+  // and dendrites of the network.
+
+  std::vector<size_t> synapse_offset (n_neurons + 1);
+  std::vector<size_t> dendrite_offset (n_neurons + 1);
+
+  synapse_offset[0] = dendrite_offset[0] = 0;
+
+  for (NeuronVector::size_type i = 0; i < n_neurons; i++)
+  {
+    synapse_offset[i + 1] = synapse_offset[i] + neurons[i]->n_synapses ();
+    dendrite_offset[i + 1] = dendrite_offset[i] + neurons[i]->n_dendrites ();
+  }
+
+  atomic_bitset synapses_used (synapse_offset[n_neurons]);
+  atomic_bitset dendrites_used (dendrite_offset[n_neurons]);
+
+  std::atomic<bool> valid (true);
+
+  parallel_for (n_edges, n_threads, [&] (size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end and valid.load (std::memory_order_relaxed); i++)
+    {
+      const Edge & e = edges[i];
+
+      if (e.source >= n_neurons or e.target >= n_neurons or
+          e.synapse >= synapse_offset[e.source + 1] - synapse_offset[e.source] or
+          e.dendrite >= dendrite_offset[e.target + 1] - dendrite_offset[e.target] or
+          neurons[e.source]->is_synapse_connected (e.synapse) or
+          neurons[e.target]->is_dendrite_connected (e.dendrite) or
+          synapses_used.test_and_set (synapse_offset[e.source] + e.synapse) or
+          dendrites_used.test_and_set (dendrite_offset[e.target] + e.dendrite))
+        valid.store (false, std::memory_order_relaxed);
+    }
+  });
+
+  if (not valid.load ()) return false;
+
+  wire (edges, n_edges, n_threads);
+
+  return true;
+}
+
+// Every connector must appear in the list at most once, so that each thread writes to
+// a different set of synapses and dendrites and no locking is necessary.
+
+void NeuralNetwork::wire (const Edge * edges, size_t n_edges, unsigned int n_threads)
+{
+  feedback_index_valid = false;
+
+  parallel_for (n_edges, n_threads, [&] (size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; i++)
+    {
+      const Edge & e = edges[i];
+
+      NeuronBase * a = neurons[e.source];
+      NeuronBase * b = neurons[e.target];
+
+      a->set_synapse (e.synapse, b, e.dendrite);
+      b->set_dendrite (e.dendrite, a, e.synapse);
+    }
+  });
 }
 
 void NeuralNetwork::erase ()
@@ -173,6 +1104,12 @@ void NeuralNetwork::erase ()
   //sensors.clear ();
   //terminals.clear ();
   neurons.clear ();
+  inputs.clear ();
+  outputs.clear ();
+  checkpoint_states.clear ();
+  neuron_hashes.clear ();
+
+  feedback_index_valid = false;
 }
 
 unsigned long int NeuralNetwork::size ()
@@ -186,6 +1123,53 @@ unsigned long int NeuralNetwork::size ()
   return size;
 }
 
+MemoryReport NeuralNetwork::memory_report () const
+{
+  MemoryReport report;
+
+  report.n_neurons = neurons.size ();
+
+  for (NeuronVector::const_iterator i = neurons.begin (); i != neurons.end (); i++) (*i)->report_memory (report);
+
+  const NeuronVector * queues[] = { &neurons, current_queue, next_queue, bp_current_queue, bp_next_queue,
+                                    &changed_inputs, &bp_concurrent, &bp_serial, &bp_deferred, &bp_logged, &bucketed };
+
+  for (size_t i = 0; i < sizeof (queues) / sizeof (queues[0]); i++)
+  {
+    report.queues += queues[i]->capacity () * sizeof (NeuronBase *);
+    report.heap_blocks += queues[i]->capacity () != 0;
+  }
+
+  report.queues += 4 * sizeof (NeuronVector);
+  report.heap_blocks += 4;
+
+  report.queues += inputs.capacity () * sizeof (SensoryInputBase *) + outputs.capacity () * sizeof (OutputSinkBase *) +
+                   gather_edges.capacity () * sizeof (GatherEdge) + gather_offset.capacity () * sizeof (size_t) +
+                   gather_buffer.capacity () + applied.capacity () + apply_store.capacity () * sizeof (std::max_align_t) +
+                   bucket_offsets.capacity () * sizeof (size_t) + runners.capacity () * sizeof (TypeRunners) +
+                   (feedback_offset.capacity () + feedback_slots_begin.capacity () + feedback_slots.capacity ()) * sizeof (size_t) +
+                   feedback_buffer.capacity () +
+                   (cycle_hashes.capacity () + neuron_hashes.capacity ()) * sizeof (__uint64_t) +
+                   cycle_iterations.capacity () * sizeof (unsigned long int) +
+                   checkpoint_states.capacity () * sizeof (std::vector<char>);
+
+  for (size_t i = 0; i < checkpoint_states.size (); i++)
+  {
+    report.queues += checkpoint_states[i].capacity ();
+    report.heap_blocks += checkpoint_states[i].capacity () != 0;
+  }
+
+  report.propagator_stores = 2 * propagator_store_size;
+  report.heap_blocks += 2 * (propagator_store_size != 0);
+
+  report.heap_overhead = report.heap_blocks * NN_MALLOC_OVERHEAD;
+
+  report.counted_bytes = nn_counted_bytes ().load (std::memory_order_relaxed);
+  report.counted_blocks = nn_counted_blocks ().load (std::memory_order_relaxed);
+
+  return report;
+}
+
 // Structure to hold counts of unconnected dendrites or synapses for each individual neuron
 struct ncounter
 {
@@ -201,18 +1185,22 @@ struct ncounter
 
 struct neuron_pool
 {
-    neuron_pool (unsigned int n) : n_neurons (n), n_available (n)
+    typedef NeuronVector::size_type size_type;
+
+    neuron_pool (size_type n) : n_neurons (n), n_available (n)
     {
       pool = (ncounter *)malloc (n * sizeof (ncounter));
     }
 
     ncounter * pool;
-    unsigned int n_neurons;   // total number of neurons in the pool
-    unsigned int n_available; // number of neurons available for making connections
+    size_type n_neurons;   // total number of neurons in the pool
+    size_type n_available; // number of neurons available for making connections
 
-    ncounter & operator [] (unsigned int i) { return pool[i]; }
+    ~neuron_pool () { free (pool); }
 
-    void delete_neuron (unsigned int i)
+    ncounter & operator [] (size_type i) { return pool[i]; }
+
+    void delete_neuron (size_type i)
     {
       n_available--;
 
@@ -226,11 +1214,13 @@ void swap (unsigned int & x1, unsigned int & x2)
   x2 = x1;
   x1 = tmp;
 }
-/*
-void NeuralNetwork::generate_random_sensory_neurons (unsigned int n_neurons,
+void NeuralNetwork::generate_random_sensory_neurons (SensoryInputBase & input,
                                                      unsigned int min_synapses, unsigned int max_synapses)
 {
-  sensors.reserve (n_neurons);
+  size_t n_neurons = input.n_inputs ();
+
+  neurons.reserve (neurons.size () + n_neurons);
+  inputs.push_back (&input);
 
   srand (time (NULL));
 
@@ -238,18 +1228,20 @@ void NeuralNetwork::generate_random_sensory_neurons (unsigned int n_neurons,
 
   unsigned int m = max_synapses - min_synapses + 1;
 
-  for (unsigned int  i = 0; i < n_neurons; i++)
+  for (size_t i = 0; i < n_neurons; i++)
   {
     unsigned int s = min_synapses + rand () % m;
 
-    sensors.push_back ((NeuronBase *)new SensoryNeuron (s));
+    create_neuron (input, 0, s);
   }
 }
-
-void NeuralNetwork::generate_random_terminal_neurons (unsigned int n_neurons,
+void NeuralNetwork::generate_random_terminal_neurons (NeuronFactoryBase & factory, OutputSinkBase & output,
+                                                      NeuronVector::size_type n_neurons,
                                                       unsigned int min_dendrites, unsigned int max_dendrites)
 {
-  terminals.reserve (n_neurons);
+  neurons.reserve (neurons.size () + n_neurons);
+
+  if (std::find (outputs.begin (), outputs.end (), &output) == outputs.end ()) outputs.push_back (&output);
 
   srand (time (NULL));
 
@@ -257,19 +1249,18 @@ void NeuralNetwork::generate_random_terminal_neurons (unsigned int n_neurons,
 
   unsigned int m = max_dendrites - min_dendrites + 1;
 
-  for (unsigned int  i = 0; i < n_neurons; i++)
+  for (NeuronVector::size_type i = 0; i < n_neurons; i++)
   {
     unsigned int d = min_dendrites + rand () % m;
 
-    terminals.push_back ((NeuronBase *)new TerminalNeuron (d));
+    create_neuron (factory, d, 0);
   }
 }
-*/
-void NeuralNetwork::generate_random_core_neurons (NeuronFactoryBase & factory, unsigned int n_neurons,
+void NeuralNetwork::generate_random_core_neurons (NeuronFactoryBase & factory, NeuronVector::size_type n_neurons,
                                                   unsigned int min_dendrites, unsigned int max_dendrites,
                                                   unsigned int min_synapses, unsigned int max_synapses)
 {
-  neurons.reserve (n_neurons);
+  neurons.reserve (neurons.size () + n_neurons);
 
   srand (time (NULL));
 
@@ -279,7 +1270,7 @@ void NeuralNetwork::generate_random_core_neurons (NeuronFactoryBase & factory, u
   unsigned int ms = max_synapses - min_synapses + 1;
   unsigned int md = max_dendrites - min_dendrites + 1;
 
-  for (unsigned int  i = 0; i < n_neurons; i++)
+  for (NeuronVector::size_type i = 0; i < n_neurons; i++)
   {
     unsigned int d = min_dendrites + rand () % md;
     unsigned int s = min_synapses + rand () % ms;
@@ -332,7 +1323,7 @@ void NeuralNetwork::make_randomly_connected_network ()
   unsigned int dd = terminals.size ();
   unsigned int ss = sensors.size ();
 */
-  for (unsigned int  i = 0; i < n_neurons; i++)
+  for (NeuronVector::size_type i = 0; i < n_neurons; i++)
   {
     unsigned int d = neurons[i]->n_dendrites ();
     unsigned int s = neurons[i]->n_synapses ();
@@ -346,6 +1337,14 @@ void NeuralNetwork::make_randomly_connected_network ()
     n_synapses += s;
   }
 
+  // Neurons with no dendrites (such as sensory ones) or no synapses can't be picked for connecting.
+
+  for (NeuronVector::size_type i = n_neurons; i-- > 0; )
+  {
+    if (dendrites_pool[i] == 0) dendrites_pool.delete_neuron (i);
+    if (synapses_pool[i] == 0) synapses_pool.delete_neuron (i);
+  }
+
 
   // Equalize the number of dendrites and synapses. Add necessary dendrites or synapses within core network
 /*
@@ -387,8 +1386,8 @@ void NeuralNetwork::make_randomly_connected_network ()
   {
     if (dendrites_pool.n_available == 0 or synapses_pool.n_available == 0) break;
 
-    unsigned int i_d = rand () % dendrites_pool.n_available;
-    unsigned int i_s = rand () % synapses_pool.n_available;
+    neuron_pool::size_type i_d = random_index (dendrites_pool.n_available);
+    neuron_pool::size_type i_s = random_index (synapses_pool.n_available);
 
     connect (synapses_pool[i_s].neuron, --synapses_pool[i_s], dendrites_pool[i_d].neuron, --dendrites_pool[i_d]);
 
@@ -407,4 +1406,4 @@ void NeuralNetwork::report_connections  () const
 }
 
 
-__uint32_t NeuronBase::neuron_counter = 0;
+nn_id_t NeuronBase::neuron_counter = 0;
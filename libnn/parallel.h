@@ -0,0 +1,60 @@
+/* parallel.h
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+// Internal helpers for multithreaded parts of the library. Not installed.
+
+#ifndef PARALLEL_H_
+#define PARALLEL_H_
+
+#include <stddef.h>
+#include <vector>
+#include <thread>
+
+
+// Split the range [0, n) into n_threads contiguous chunks and call f (begin, end) for each of
+// them on a separate thread. With n_threads = 0 the number of hardware threads is used.
+template <class F> inline void parallel_for (size_t n, unsigned int n_threads, F f)
+{
+  if (n_threads == 0) n_threads = std::thread::hardware_concurrency ();
+  if (n_threads == 0) n_threads = 1;
+  if (n_threads > n) n_threads = n ? n : 1;
+
+  if (n_threads == 1)
+  {
+    f (0, n);
+    return;
+  }
+
+  std::vector<std::thread> threads;
+
+  size_t chunk = n / n_threads;
+
+  for (unsigned int t = 0; t < n_threads; t++)
+  {
+    size_t begin = t * chunk;
+    size_t end = t == n_threads - 1 ? n : begin + chunk;
+
+    threads.push_back (std::thread (f, begin, end));
+  }
+
+  for (unsigned int t = 0; t < n_threads; t++) threads[t].join ();
+}
+
+
+#endif /* PARALLEL_H_ */
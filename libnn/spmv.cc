@@ -0,0 +1,320 @@
+/* spmv.cc
+ *
+ * Copyright (C) 2014, Jerry M. Kakol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+
+#include "libnn.h"
+#include "SpmvBackend.h"
+#include "parallel.h"
+#include "blockstore.h"
+#include <algorithm>
+
+
+SpmvBackendBase::SpmvBackendBase (NeuralNetwork & nn, unsigned int n, const SpmvPaging * paging) :
+  network (nn), n_threads (n), valid (true), dendrites_released (false), store (0), block_rows (0), prefetch_blocks (0), weights_written (0), targets_written (0), dense (false)
+{
+  if (paging)
+  {
+    store = new BlockStore (paging->filename, paging->cache_blocks);
+    block_rows = paging->block_rows ? paging->block_rows : 1;
+
+    // Keep a slot for the block being computed, so that the prefetched ones don't evict each other.
+    prefetch_blocks = std::min ((size_t)NN_SPMV_PREFETCH_BLOCKS, paging->cache_blocks > 2 ? paging->cache_blocks - 1 : 1);
+
+    if (not store->is_open ()) valid = false;
+  }
+
+  row_begin.assign (1, 0);
+}
+
+SpmvBackendBase::~SpmvBackendBase ()
+{
+  delete store;
+}
+
+unsigned long int SpmvBackendBase::blocks_read () const
+{
+  return store ? store->reads () : 0;
+}
+
+void SpmvBackendBase::add_row (NeuronBase * n)
+{
+  row_of[n] = rows.size ();
+  rows.push_back (n);
+}
+
+void SpmvBackendBase::begin_weights ()
+{
+  row_begin.assign (1, 0);
+  columns.clear ();
+  weights.clear ();
+
+  target_begin.assign (1, 0);
+  targets.clear ();
+
+  weights_written = 0;
+  targets_written = 0;
+
+  if (store) store->clear ();
+}
+
+void SpmvBackendBase::add_weight (const NeuronBase * source, double weight)
+{
+  std::unordered_map<const NeuronBase *, size_t>::const_iterator i = row_of.find (source);
+
+  if (i == row_of.end ())
+  {
+    valid = false;
+    return;
+  }
+
+  columns.push_back (i->second);
+  weights.push_back (weight);
+}
+
+void SpmvBackendBase::end_row ()
+{
+  size_t r = row_begin.size () - 1;
+  NeuronBase * n = rows[r];
+
+  for (Connector::size_type s = 0; s < n->n_synapses (); s++)
+  {
+    const NeuronBase * t = n->synapse_target (s);
+
+    if (t) targets.push_back (row_of[t]);
+  }
+
+  row_begin.push_back (weights_written + columns.size ());
+  target_begin.push_back (targets_written + targets.size ());
+
+  if (store and (r + 1) % block_rows == 0) flush_block ();
+}
+
+// Write the rows extracted since the previous block to the file as the next block: weights,
+// columns and targets one after another.
+
+void SpmvBackendBase::flush_block ()
+{
+  size_t w = weights.size () * sizeof (double);
+  size_t c = columns.size () * sizeof (size_t);
+  size_t t = targets.size () * sizeof (size_t);
+
+  block_buffer.resize (w + c + t);
+
+  std::copy (weights.begin (), weights.end (), (double *)&block_buffer[0]);
+  std::copy (columns.begin (), columns.end (), (size_t *)&block_buffer[w]);
+  std::copy (targets.begin (), targets.end (), (size_t *)&block_buffer[w + c]);
+
+  if (not store->append (block_buffer.data (), block_buffer.size ())) valid = false;
+
+  weights_written += weights.size ();
+  targets_written += targets.size ();
+
+  weights.clear ();
+  columns.clear ();
+  targets.clear ();
+}
+
+void SpmvBackendBase::build ()
+{
+  if (store and rows.size () % block_rows) flush_block ();
+
+  x.resize (rows.size ());
+  y.assign (rows.size (), 0.0);
+  fired.assign (rows.size (), 0);
+
+  for (size_t r = 0; r < rows.size (); r++) x[r] = signal (r);
+}
+
+// Compute the weighted sums of the listed rows, splitting them between the threads. The
+// weights and columns arrays start at the base-th weight of the matrix.
+
+void SpmvBackendBase::multiply (const size_t * list, size_t n, const double * weights, const size_t * columns, size_t base)
+{
+  const size_t * row_begin = &this->row_begin[0];
+  const double * x = this->x.data ();
+  double * y = this->y.data ();
+
+  parallel_for (n, n_threads, [=] (size_t begin, size_t end)
+  {
+    for (size_t i = begin; i < end; i++)
+    {
+      size_t r = list[i];
+      double sum = 0.0;
+
+      for (size_t k = row_begin[r] - base; k < row_begin[r + 1] - base; k++) sum += weights[k] * x[columns[k]];
+
+      y[r] = sum;
+    }
+  });
+}
+
+// Recompute the neurons of the listed rows from their sums and collect the targets of those
+// which fired. The targets array starts at the base-th target.
+
+void SpmvBackendBase::activate_rows (const size_t * list, size_t n, const size_t * targets, size_t base)
+{
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t r = list[i];
+    NeuronBase & neuron = *rows[r];
+
+    neuron.dirty = 1;
+    neuron.state_version++;
+
+    fired[r] = activate (r, y[r]);
+
+    if (fired[r]) pending.insert (pending.end (), targets + target_begin[r] - base, targets + target_begin[r + 1] - base);
+  }
+}
+
+void SpmvBackendBase::run ()
+{
+  if (not valid) return;
+
+  // The stimuli are taken as begin_iteration () would do it. A neuron given a new state
+  // delivers it from this iteration on.
+
+  injected.clear ();
+  network.take_stimuli (network.stimuli.last (), &injected);
+
+  for (NeuronVector::iterator i = injected.begin (); i != injected.end (); i++) x[row_of[*i]] = signal (row_of[*i]);
+
+  NeuronVector & queue = *network.current_queue;
+
+  active.clear ();
+  pending.clear ();
+
+  for (NeuronVector::iterator i = queue.begin (); i != queue.end (); i++)
+  {
+    (*i)->set_in_update_queue (false);
+    active.push_back (row_of[*i]);
+  }
+
+  if (store)
+  {
+    run_paged ();
+
+    if (not valid) return;
+  }
+  else
+  {
+    // A large frontier is computed in the order of the rows, streaming through the matrix.
+
+    dense = active.size () * NN_SPMV_DENSE_FRACTION >= rows.size ();
+
+    if (dense) std::sort (active.begin (), active.end ());
+
+    multiply (active.data (), active.size (), weights.data (), columns.data (), 0);
+
+    activate_rows (active.data (), active.size (), targets.data (), 0);
+  }
+
+  // The signals are updated only once all the neurons are recomputed, so that all of them
+  // see the previous iteration's ones. The state may change even if the neuron doesn't fire.
+
+  for (std::vector<size_t>::iterator i = active.begin (); i != active.end (); i++) x[*i] = signal (*i);
+
+  for (std::vector<size_t>::iterator i = pending.begin (); i != pending.end (); i++) network.add_to_update_queue (rows[*i]);
+
+  network.swap_update_queues ();
+  network.iteration++;
+
+  if (store) prefetch_frontier ();
+}
+
+// Out-of-core iteration: the frontier is sorted by row, hence by block, and each block
+// holding any of its rows is loaded once, with the next prefetch_blocks ones being
+// read in the background meanwhile.
+
+void SpmvBackendBase::run_paged ()
+{
+  std::sort (active.begin (), active.end ());
+
+  std::vector<size_t> blocks;
+  std::vector<size_t> bounds (1, 0); // rows of blocks[i] are at [bounds[i], bounds[i + 1]) in active
+
+  for (size_t i = 0; i < active.size (); i++)
+  {
+    size_t b = active[i] / block_rows;
+
+    if (blocks.empty () or blocks.back () != b)
+    {
+      if (not blocks.empty ()) bounds.push_back (i);
+      blocks.push_back (b);
+    }
+  }
+
+  bounds.push_back (active.size ());
+
+  dense = blocks.size () == store->n_blocks ();
+
+  for (size_t i = 0; i < blocks.size () and i < prefetch_blocks; i++) store->prefetch (blocks[i]);
+
+  for (size_t i = 0; i < blocks.size (); i++)
+  {
+    if (i + prefetch_blocks < blocks.size ()) store->prefetch (blocks[i + prefetch_blocks]);
+
+    size_t b = blocks[i];
+    const char * data = store->acquire (b);
+
+    if (data == 0)
+    {
+      valid = false;
+      return;
+    }
+
+    size_t first = b * block_rows;
+    size_t last = std::min (first + block_rows, rows.size ());
+    size_t w = row_begin[first];
+    size_t t = target_begin[first];
+
+    const double * block_weights = (const double *)data;
+    const size_t * block_columns = (const size_t *)(block_weights + (row_begin[last] - w));
+    const size_t * block_targets = block_columns + (row_begin[last] - w);
+
+    multiply (&active[bounds[i]], bounds[i + 1] - bounds[i], block_weights, block_columns, w);
+    activate_rows (&active[bounds[i]], bounds[i + 1] - bounds[i], block_targets, t);
+
+    store->release (b);
+  }
+}
+
+// Request the first blocks the next iteration is going to need.
+
+void SpmvBackendBase::prefetch_frontier ()
+{
+  NeuronVector & queue = *network.current_queue;
+  std::vector<size_t> blocks;
+
+  for (NeuronVector::iterator i = queue.begin (); i != queue.end (); i++) blocks.push_back (row_of[*i] / block_rows);
+
+  std::sort (blocks.begin (), blocks.end ());
+  blocks.erase (std::unique (blocks.begin (), blocks.end ()), blocks.end ());
+
+  for (size_t i = 0; i < blocks.size () and i < prefetch_blocks; i++) store->prefetch (blocks[i]);
+}
+
+unsigned long int SpmvBackendBase::run_n (unsigned long int n)
+{
+  unsigned long int i = 0;
+
+  for (; i < n and valid and not (network.current_queue->empty () and network.stimuli.is_empty ()); i++) run ();
+
+  return i;
+}